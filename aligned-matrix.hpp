@@ -0,0 +1,131 @@
+/*******************************************************************//**
+         FILE:  aligned-matrix.hpp
+
+  DESCRIPTION:  Dense row major matrix held in one 64 byte aligned block
+
+         BUGS:  ---
+        NOTES:  Only meant for types which can be copied with memcpy.
+       AUTHOR:  Josh Marshall <jrmarsha@mtu.edu>
+      COMPANY:  Michigan technological University
+      VERSION:  See git log
+      CREATED:  See git log
+     REVISION:  See git log
+     LISCENSE:  GPLv3
+***********************************************************************/
+#ifndef ALIGNED_MATRIX_HPP
+#define ALIGNED_MATRIX_HPP
+
+////////////////////////////////////////////////////////////////////////
+//INCLUDES//////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+
+#include "allocation.hpp"
+
+////////////////////////////////////////////////////////////////////////
+//CLASS DEFINITION//////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************//**
+ *  A numRows() by numCols() matrix stored as one allocation.  Each row
+ * is padded out to getStride() elements so that every row starts on a
+ * 64 byte boundary, and the padding is zero.  Large matrices are
+ * aligned to, and advised as, huge pages.
+ *
+ *  Owns its storage; it can be moved but not copied.  The storage is
+ * accounted to an allocation tag, the correlation matrix's unless
+ * given.
+ **********************************************************************/
+template<typename T> class AlignedMatrix{
+  private:
+  T *data;
+  size_t rows;
+  size_t cols;
+  size_t stride;
+  size_t allocSize;
+  enum allocationTag tag;
+
+  public:
+
+/*******************************************************************//**
+ *  An empty matrix holding no storage.
+ **********************************************************************/
+  AlignedMatrix();
+
+
+/*******************************************************************//**
+ *  A zeroed numRows by numCols matrix.  Check empty() for failure.
+ **********************************************************************/
+  AlignedMatrix(size_t numRows, size_t numCols,
+                        enum allocationTag memoryTag = ALLOC_CORRELATION);
+
+
+  AlignedMatrix(AlignedMatrix &&other);
+  AlignedMatrix &operator=(AlignedMatrix &&other);
+  AlignedMatrix(const AlignedMatrix&) = delete;
+  AlignedMatrix &operator=(const AlignedMatrix&) = delete;
+
+
+/*******************************************************************//**
+ *  Release the storage.
+ **********************************************************************/
+  ~AlignedMatrix();
+
+
+/*******************************************************************//**
+ *  Replace the contents with a zeroed numRows by numCols matrix.
+ *
+ * @return false if the storage could not be allocated, leaving the
+ *         matrix empty.
+ **********************************************************************/
+  bool allocate(size_t numRows, size_t numCols);
+
+
+/*******************************************************************//**
+ *  Free the storage, leaving the matrix empty.
+ **********************************************************************/
+  void release();
+
+
+/*******************************************************************//**
+ *  True if there is no storage, either because nothing was allocated
+ * or the allocation failed.
+ **********************************************************************/
+  bool empty() const { return NULL == data; }
+
+
+/*******************************************************************//**
+ *  View of row i; numCols() meaningful elements followed by padding.
+ **********************************************************************/
+  T *row(size_t i) { return &data[i * stride]; }
+  const T *row(size_t i) const { return &data[i * stride]; }
+
+
+  T &operator()(size_t i, size_t j) { return data[i * stride + j]; }
+  const T &operator()(size_t i, size_t j) const {
+    return data[i * stride + j];
+  }
+
+
+  size_t numRows() const { return rows; }
+  size_t numCols() const { return cols; }
+
+
+/*******************************************************************//**
+ *  Distance in elements between the starts of adjacent rows.
+ **********************************************************************/
+  size_t getStride() const { return stride; }
+
+
+/*******************************************************************//**
+ *  Set every element, padding included, to zero.
+ **********************************************************************/
+  void zeroData();
+};
+
+////////////////////////////////////////////////////////////////////////
+//END///////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+#endif
@@ -0,0 +1,152 @@
+/*******************************************************************//**
+         FILE:  aligned-matrix.t.hpp
+
+  DESCRIPTION:  Definitions for AlignedMatrix
+
+         BUGS:  ---
+        NOTES:  ---
+       AUTHOR:  Josh Marshall <jrmarsha@mtu.edu>
+      COMPANY:  Michigan technological University
+      VERSION:  See git log
+      CREATED:  See git log
+     REVISION:  See git log
+     LISCENSE:  GPLv3
+***********************************************************************/
+#ifndef ALIGNED_MATRIX_T_HPP
+#define ALIGNED_MATRIX_T_HPP
+
+////////////////////////////////////////////////////////////////////////
+//INCLUDES//////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "aligned-matrix.hpp"
+
+////////////////////////////////////////////////////////////////////////
+//CONSTANTS/////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+#define ALIGNED_MATRIX_ALIGNMENT 64
+#define ALIGNED_MATRIX_HUGE_PAGE (2 * 1024 * 1024)
+
+////////////////////////////////////////////////////////////////////////
+//FUNCTION DEFINITIONS//////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+template<typename T> AlignedMatrix<T>::AlignedMatrix(){
+  data = NULL;
+  rows = cols = stride = allocSize = 0;
+  tag = ALLOC_CORRELATION;
+}
+
+
+template<typename T> AlignedMatrix<T>::AlignedMatrix(size_t numRows,
+                          size_t numCols, enum allocationTag memoryTag){
+  data = NULL;
+  rows = cols = stride = allocSize = 0;
+  tag = memoryTag;
+  allocate(numRows, numCols);
+}
+
+
+template<typename T> AlignedMatrix<T>::AlignedMatrix(
+                                              AlignedMatrix &&other){
+  data = other.data;
+  rows = other.rows;
+  cols = other.cols;
+  stride = other.stride;
+  allocSize = other.allocSize;
+  tag = other.tag;
+
+  other.data = NULL;
+  other.rows = other.cols = other.stride = other.allocSize = 0;
+}
+
+
+template<typename T> AlignedMatrix<T> &AlignedMatrix<T>::operator=(
+                                              AlignedMatrix &&other){
+  if(this == &other) return *this;
+
+  release();
+  data = other.data;
+  rows = other.rows;
+  cols = other.cols;
+  stride = other.stride;
+  allocSize = other.allocSize;
+  tag = other.tag;
+
+  other.data = NULL;
+  other.rows = other.cols = other.stride = other.allocSize = 0;
+
+  return *this;
+}
+
+
+template<typename T> AlignedMatrix<T>::~AlignedMatrix(){
+  release();
+}
+
+
+template<typename T> bool AlignedMatrix<T>::allocate(size_t numRows,
+                                                      size_t numCols){
+  void *tmpPtr;
+  size_t alignment = ALIGNED_MATRIX_ALIGNMENT;
+  size_t rowMultiple = 1;
+
+  release();
+
+  //Smallest whole number of elements which fills whole cache lines
+  while((rowMultiple * sizeof(T)) % ALIGNED_MATRIX_ALIGNMENT)
+    rowMultiple++;
+
+  stride = ((numCols + rowMultiple - 1) / rowMultiple) * rowMultiple;
+  allocSize = sizeof(T) * stride * numRows;
+
+  //Round big blocks out to whole huge pages so they can be backed by
+  //them
+  if(allocSize >= ALIGNED_MATRIX_HUGE_PAGE){
+    alignment = ALIGNED_MATRIX_HUGE_PAGE;
+    allocSize = ((allocSize + alignment - 1) / alignment) * alignment;
+  }
+
+  if(0 == allocSize || posix_memalign(&tmpPtr, alignment, allocSize)){
+    stride = allocSize = 0;
+    return false;
+  }
+  data = (T*) tmpPtr;
+  allocationRecord(tag, allocSize);
+
+#ifdef MADV_HUGEPAGE
+  if(ALIGNED_MATRIX_HUGE_PAGE == alignment)
+    madvise(tmpPtr, allocSize, MADV_HUGEPAGE);
+#endif
+
+  rows = numRows;
+  cols = numCols;
+  zeroData();
+
+  return true;
+}
+
+
+template<typename T> void AlignedMatrix<T>::release(){
+  if(NULL != data) allocationRelease(tag, allocSize);
+  free(data);
+  data = NULL;
+  rows = cols = stride = allocSize = 0;
+}
+
+
+template<typename T> void AlignedMatrix<T>::zeroData(){
+  if(NULL != data)
+    memset((void*) data, 0, allocSize);
+}
+
+////////////////////////////////////////////////////////////////////////
+//END///////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+#endif
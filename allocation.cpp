@@ -0,0 +1,142 @@
+/*******************************************************************//**
+         FILE:  allocation.cpp
+
+  DESCRIPTION:  Accounting of the large allocations of TF-cluster by
+                subsystem, and the --max-memory budget checked against
+                it
+
+         BUGS:  ---
+        NOTES:  Counters are atomics so that worker threads can record
+                without a lock; a peak may briefly lag a concurrent
+                allocation but is never lost.
+       AUTHOR:  Josh Marshall <jrmarsha@mtu.edu>
+      COMPANY:  Michigan technological University
+      VERSION:  See git log
+      CREATED:  See git log
+     REVISION:  See git log
+     LISCENSE:  GPLv3
+***********************************************************************/
+
+////////////////////////////////////////////////////////////////////////
+//INCLUDES//////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "allocation.hpp"
+
+////////////////////////////////////////////////////////////////////////
+//NAMESPACE USING///////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+using std::atomic;
+
+////////////////////////////////////////////////////////////////////////
+//PRIVATE STRUCTS///////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+struct allocationCounter{
+  atomic<size_t> current;
+  atomic<size_t> peak;
+  atomic<size_t> count;
+};
+
+////////////////////////////////////////////////////////////////////////
+//PRIVATE FUNCTION DECLARATIONS/////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************//**
+ *  Add bytes to counter and raise its peak to match.
+ **********************************************************************/
+void addToCounter(struct allocationCounter &counter, size_t bytes);
+
+////////////////////////////////////////////////////////////////////////
+//PRIVATE VARIABLES/////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+static struct allocationCounter counters[ALLOC_NUM_TAGS];
+static struct allocationCounter total;
+static size_t budget = 0;
+
+static const char *tagNames[ALLOC_NUM_TAGS] = {
+  "expression", "correlation", "candidates", "sccm", "sccm_sort", "graph"
+};
+
+////////////////////////////////////////////////////////////////////////
+//FUNCTION DEFINITIONS//////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+void addToCounter(struct allocationCounter &counter, size_t bytes){
+  const size_t now = counter.current.fetch_add(bytes) + bytes;
+  size_t peak = counter.peak.load();
+
+  while(now > peak && !counter.peak.compare_exchange_weak(peak, now));
+  counter.count++;
+}
+
+
+void allocationRecord(enum allocationTag tag, size_t bytes){
+  if(0 == bytes) return;
+  addToCounter(counters[tag], bytes);
+  addToCounter(total, bytes);
+}
+
+
+void allocationRelease(enum allocationTag tag, size_t bytes){
+  counters[tag].current -= bytes;
+  total.current -= bytes;
+}
+
+
+void allocationResize(enum allocationTag tag, size_t oldBytes,
+                                                      size_t newBytes){
+  if(newBytes > oldBytes)
+    allocationRecord(tag, newBytes - oldBytes);
+  else
+    allocationRelease(tag, oldBytes - newBytes);
+}
+
+
+const char *allocationTagName(enum allocationTag tag){
+  return tagNames[tag];
+}
+
+
+void allocationUsage(enum allocationTag tag, size_t &current,
+                                          size_t &peak, size_t &count){
+  current = counters[tag].current;
+  peak = counters[tag].peak;
+  count = counters[tag].count;
+}
+
+
+size_t allocationPeak(){
+  return total.peak;
+}
+
+
+void allocationSetBudget(size_t bytes){
+  budget = bytes;
+}
+
+
+void allocationCheckBudget(const char *phase, size_t estimate){
+  const size_t held = total.current;
+  const double MiB = 1024.0 * 1024.0;
+
+  if(0 == budget || held + estimate <= budget) return;
+
+  fprintf(stderr, "Phase %s needs an estimated %.1f MiB on top of the "
+                  "%.1f MiB already held, which is over the --max-memory "
+                  "budget of %.1f MiB; stopping\n", phase,
+                  (double) estimate / MiB, (double) held / MiB,
+                                                  (double) budget / MiB);
+  exit(ENOMEM);
+}
+
+////////////////////////////////////////////////////////////////////////
+//END///////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,110 @@
+/*******************************************************************//**
+         FILE:  allocation.hpp
+
+  DESCRIPTION:  Accounting of the large allocations of TF-cluster by
+                subsystem, and the --max-memory budget checked against
+                it
+
+         BUGS:  ---
+        NOTES:  Only the big buffers are recorded, by the code that
+                allocates them; hash tables and other standard library
+                containers are not, so the tracked total is a lower
+                bound on the process's footprint.
+       AUTHOR:  Josh Marshall <jrmarsha@mtu.edu>
+      COMPANY:  Michigan technological University
+      VERSION:  See git log
+      CREATED:  See git log
+     REVISION:  See git log
+     LISCENSE:  GPLv3
+***********************************************************************/
+#ifndef ALLOCATION_HPP
+#define ALLOCATION_HPP
+
+////////////////////////////////////////////////////////////////////////
+//INCLUDES//////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+
+////////////////////////////////////////////////////////////////////////
+//ENUMS/////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*Subsystems allocations are accounted to.*/
+enum allocationTag{
+  ALLOC_EXPRESSION = 0,
+  ALLOC_CORRELATION,
+  ALLOC_CANDIDATES,
+  ALLOC_SCCM,
+  ALLOC_SCCM_SORT,
+  ALLOC_GRAPH,
+  ALLOC_NUM_TAGS
+};
+
+////////////////////////////////////////////////////////////////////////
+//PUBLIC FUNCTION DECLARATIONS//////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************//**
+ *  Account bytes newly allocated to tag.  Safe to call from several
+ * threads at once.
+ **********************************************************************/
+void allocationRecord(enum allocationTag tag, size_t bytes);
+
+
+/*******************************************************************//**
+ *  Account bytes given back by tag.
+ **********************************************************************/
+void allocationRelease(enum allocationTag tag, size_t bytes);
+
+
+/*******************************************************************//**
+ *  Account a buffer of tag's changing from oldBytes to newBytes, as by
+ * realloc().  Only growth counts as an allocation.
+ **********************************************************************/
+void allocationResize(enum allocationTag tag, size_t oldBytes,
+                                                      size_t newBytes);
+
+
+/*******************************************************************//**
+ *  Name of tag in reports.
+ **********************************************************************/
+const char *allocationTagName(enum allocationTag tag);
+
+
+/*******************************************************************//**
+ *  Bytes tag holds now, the most it has held at once, and how many
+ * allocations it has made.
+ **********************************************************************/
+void allocationUsage(enum allocationTag tag, size_t &current,
+                                          size_t &peak, size_t &count);
+
+
+/*******************************************************************//**
+ *  The most bytes held over all tags at once.
+ **********************************************************************/
+size_t allocationPeak();
+
+
+/*******************************************************************//**
+ *  Limit the tracked total to bytes; 0, the default, is no limit.
+ **********************************************************************/
+void allocationSetBudget(size_t bytes);
+
+
+/*******************************************************************//**
+ *  Called before a phase allocates about estimate more bytes.  If that
+ * on top of what is already held would pass the budget, say so with
+ * the estimate and exit with ENOMEM, rather than be killed for running
+ * out of memory part way through.
+ *
+ * @param[in] phase Name of the phase, as in the --profile report.
+ * @param[in] estimate Bytes the phase is expected to add at its peak.
+ **********************************************************************/
+void allocationCheckBudget(const char *phase, size_t estimate);
+
+////////////////////////////////////////////////////////////////////////
+//END///////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+#endif
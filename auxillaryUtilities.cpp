@@ -21,15 +21,22 @@
 #include <iostream>
 #include <cstring>
 #include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdint>
 #include <queue>
 #include <string>
 #include <thread>
 #include <utility>
 
+#include "allocation.hpp"
 #include "auxillaryUtilities.hpp"
+#include "correlation.hpp"
 #include "diagnostics.hpp"
 #include "edge.t.hpp"
 #include "graph.t.hpp"
+#include "profile.hpp"
+#include "trace.hpp"
 #include "statistics.h"
 #include "vertex.t.hpp"
 
@@ -47,6 +54,14 @@ using std::string;
 using std::thread;
 using std::vector;
 
+////////////////////////////////////////////////////////////////////////
+//PRIVATE CONSTANTS/////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*Rough bytes per entry of an unordered_map of small keys, node and
+buckets, for estimating memory budgets.*/
+static csize_t HASH_ENTRY_BYTES = 48;
+
 ////////////////////////////////////////////////////////////////////////
 //PRIVATE STRUCTS
 ////////////////////////////////////////////////////////////////////////
@@ -58,24 +73,47 @@ struct quickMergeDoubleSizeTPair_recurse_struct{
 };
 
 
-struct multithreadLoad{
-  size_t numerator;
-  size_t denominator;
-  void *specifics;
+template <typename T> struct constructGraphHelperStruct{
+  size_t numRows;
+  size_t numCols;
+  const AlignedMatrix<T> *fullMatrix;
+  AlignedMatrix<pair<T, u32> > *intermediateGraph;
+  const struct sortScratch<T, u32> *scratch;
 };
 
 
-struct constructGraphHelperStruct{
+/*******************************************************************//**
+ *  Candidate genes of every TF in compressed sparse row form; the genes
+ * of TF i are genes[offsets[i]] up to genes[offsets[i + 1]].
+ **********************************************************************/
+struct candidateLists{
   size_t numRows;
+  size_t *offsets;
+  u32 *genes;
+};
+
+
+/*******************************************************************//**
+ *  One slice of an autoThreadLauncher() call, timed for --profile.
+ **********************************************************************/
+struct timedSliceHelperStruct{
+  void* (*func)(void*);
+  void *slice;
+  f64 busy;
+};
+
+
+template <typename T> struct thresholdCandidatesHelperStruct{
+  const AlignedMatrix<T> *fullMatrix;
   size_t numCols;
-  cf64 **fullMatrix;
-  pair<f64, size_t> **intermediateGraph;
+  T minCorrelation;
+  bool fill;
+  struct candidateLists *candidates;
 };
 
 
 struct constructSCCMHelperStruct{
-  u8 numEdges;
-  pair<f64, size_t> **intermediateGraph;
+  const struct candidateLists *candidates;
   unordered_map<size_t, bool> *hashChecks;
   pthread_mutex_t *rowLocks;
   UpperDiagonalSquareMatrix<u8> *coincidenceMatrix;
@@ -98,7 +136,9 @@ struct addTopEdgesHelperStruct{
 struct sortCoindicenceMatrixHelperStruct{
   UpperDiagonalSquareMatrix<u8> *coindicenceMatrix;
   size_t n;
+  size_t numToKeep;
   pair<u8, size_t>** sortedCoincidenceMatrix;
+  const struct sortScratch<u8, size_t> *scratch;
 };
 
 ////////////////////////////////////////////////////////////////////////
@@ -115,11 +155,12 @@ void sortDoubleSizeTPairLowToHighHelper(pair<f64, size_t> *toSort,
 
 
 /*******************************************************************//**
- *  A helper function to sortDoubleSizeTPairHighToLow().
+ *  A helper function to sortPairHighToLow().
  **********************************************************************/
-void sortDoubleSizeTPairHighToLowHelper(pair<f64, size_t> *toSort,
-                csize_t leftIndex, csize_t rightIndex, csize_t endIndex,
-                                          pair<f64, size_t> *sortSpace);
+template <typename T, typename I> void sortPairHighToLowHelper(
+                    pair<T, I> *toSort, csize_t leftIndex,
+                    csize_t rightIndex, csize_t endIndex,
+                                                pair<T, I> *sortSpace);
 
 
 /*******************************************************************//**
@@ -128,25 +169,52 @@ void sortDoubleSizeTPairHighToLowHelper(pair<f64, size_t> *toSort,
 void *constructGraph(void *arg);
 
 
-/*******************************************************************//**
- * Sorts toSort based on the values in toSort[x].first() in linear time.
- **********************************************************************/
-pair<u8, size_t>* countingSortHighToLow(pair<u8, size_t> *toSort, 
-                                                            csize_t n);
-
-
 /***********************************************************************
  * TODO
  * ********************************************************************/
-void *constructPreSCCMHelper(void *arg);
+template <typename T> void *constructPreSCCMHelper(void *arg);
 
 
-/***********************************************************************
- * TODO
- * ********************************************************************/
+/*******************************************************************//**
+ *  A helper function to constructCoincidenceMatrix() counting, or
+ * filling in, the SCCM for a slice of the coincidence matrix.  Counts
+ * stop at 255.
+ **********************************************************************/
 void *constructSCCMHelper(void *arg);
 
 
+/*******************************************************************//**
+ *  Run one timedSliceHelperStruct's slice, noting how long it took.
+ **********************************************************************/
+void *timedSliceHelper(void *arg);
+
+
+/*******************************************************************//**
+ *  A helper function to thresholdCandidates() which, for a slice of
+ * TFs, counts each TF's candidates into offsets[i + 1] or, once offsets
+ * is a prefix sum, writes them out.
+ **********************************************************************/
+template <typename T> void *thresholdCandidatesHelper(void *arg);
+
+
+/*******************************************************************//**
+ *  The keepTopN most correlated genes of every TF, found by sorting
+ * each full row.
+ **********************************************************************/
+template <typename T> void topCandidates(
+          const correlationTable<T> &protoGraph, csize_t keepTopN,
+                                    struct candidateLists &candidates);
+
+
+/*******************************************************************//**
+ *  Every gene correlated with a TF at minCorrelation or more, in gene
+ * order, found in two passes over the matrix and never sorted.
+ **********************************************************************/
+template <typename T> void thresholdCandidates(
+          const correlationTable<T> &protoGraph, const T minCorrelation,
+                                    struct candidateLists &candidates);
+
+
 /***********************************************************************
  * Returns for each TF an array of pairs containing an index to the gene
  * name and its correlation coefficient sorted from highest correlation
@@ -155,17 +223,25 @@ void *constructSCCMHelper(void *arg);
 void *sortCoindicenceMatrixHelper(void *arg);
 
 
-/***********************************************************************
- * 
- * ********************************************************************/
-void autoThreadLauncher(void* (*func)(void*), void *sharedArgs);
-
-
 ////////////////////////////////////////////////////////////////////////
 //FUNCTION DEFINITIONS//////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
 
 
+void *timedSliceHelper(void *arg){
+  struct timedSliceHelperStruct *args =
+                                  (struct timedSliceHelperStruct*) arg;
+
+  struct profileSlice measured;
+
+  profileSliceBegin(measured);
+  args->func(args->slice);
+  args->busy = profileSliceEnd(measured);
+
+  return NULL;
+}
+
+
 void autoThreadLauncher(void* (*func)(void*), void *sharedArgs){
   void *tmpPtr;
   
@@ -180,9 +256,26 @@ void autoThreadLauncher(void* (*func)(void*), void *sharedArgs){
   for(size_t i = 0; i < numCPUs; i++){
     instructions[i] = {i, numCPUs, sharedArgs};
   }
+
+  //When profiling each slice is wrapped so its busy time is known
+  struct timedSliceHelperStruct *timed = NULL;
+  void* (*toRun)(void*) = func;
+  vector<void*> runArgs(numCPUs);
+  for(size_t i = 0; i < numCPUs; i++)
+    runArgs[i] = (void*) &instructions[i];
+  if(profileEnabled()){
+    tmpPtr = malloc(sizeof(*timed) * numCPUs);
+    timed = (struct timedSliceHelperStruct*) tmpPtr;
+    for(size_t i = 0; i < numCPUs; i++){
+      timed[i] = {func, (void*) &instructions[i], 0};
+      runArgs[i] = (void*) &timed[i];
+    }
+    toRun = timedSliceHelper;
+  }
+  cf64 start = profileNow();
   
   if(numCPUs < 2){
-    func((void*) instructions);
+    toRun(runArgs[0]);
   }else{
     int *toIgnore;
     pthread_t *workers;
@@ -191,38 +284,56 @@ void autoThreadLauncher(void* (*func)(void*), void *sharedArgs){
     workers = (pthread_t*) tmpPtr;
   
     for(size_t i = 0; i < numCPUs; i++)
-      pthread_create(&workers[i], NULL, func, (void*) &instructions[i]);
+      pthread_create(&workers[i], NULL, toRun, runArgs[i]);
       
     for(size_t i = 0; i < numCPUs; i++)
       pthread_join(workers[i], (void**) &toIgnore);
     
     free(workers);
   }
+
+  if(NULL != timed){
+    vector<f64> busy(numCPUs);
+    for(size_t i = 0; i < numCPUs; i++)
+      busy[i] = timed[i].busy;
+    profileRecordLaunch(busy.data(), numCPUs, profileNow() - start);
+    free(timed);
+  }
   
   free(instructions);
 }
 
 
-void *constructPreSCCMHelper(void *arg){
+template <typename T> void *constructPreSCCMHelper(void *arg){
+  TRACE_SCOPE("constructPreSCCMHelper");
   struct multithreadLoad *argPrime = (struct multithreadLoad*) arg;
   csize_t numerator = argPrime->numerator;
   csize_t denominator = argPrime->denominator;
   
-  struct constructGraphHelperStruct *args =
-              (struct constructGraphHelperStruct*) argPrime->specifics;
+  struct constructGraphHelperStruct<T> *args =
+            (struct constructGraphHelperStruct<T>*) argPrime->specifics;
   csize_t numRows = args->numRows;
   csize_t numCols = args->numCols;
-  cf64 **fullMatrix = args->fullMatrix;
-  pair<f64, size_t> **intermediateGraph = args->intermediateGraph;
-
+  const AlignedMatrix<T> *fullMatrix = args->fullMatrix;
+  AlignedMatrix<pair<T, u32> > *intermediateGraph =
+                                                args->intermediateGraph;
+  struct sortScratch<T, u32> scratch;
+
+  if(!sortScratchSlice(*args->scratch, numerator, scratch)){
+    fprintf(stderr, "ERROR: No sort space for thread %zu\n", numerator);
+    fflush(stderr);
+    raise(SIGABRT);
+  }
 
   for(size_t i = (numerator * numRows) / denominator;
                     i < ((numerator + 1) * numRows) / denominator; i++){
+    const T *values = fullMatrix->row(i);
+    pair<T, u32> *edges = intermediateGraph->row(i);
 
     for(size_t j = 0; j < numCols; j++)
-      intermediateGraph[i][j] = pair<f64, size_t>(fullMatrix[i][j], j);
+      edges[j] = pair<T, u32>(values[j], (u32) j);
 
-    sortDoubleSizeTPairHighToLow(intermediateGraph[i], numCols);
+    sortPairHighToLow(edges, numCols, scratch);
   }
 
   return NULL;
@@ -230,6 +341,7 @@ void *constructPreSCCMHelper(void *arg){
 
 
 void *constructSCCMHelper(void *arg){
+  TRACE_SCOPE("constructSCCMHelper");
   struct multithreadLoad *argPrime = (struct multithreadLoad*) arg;
   csize_t numerator = argPrime->numerator;
   csize_t denominator = argPrime->denominator;
@@ -237,8 +349,8 @@ void *constructSCCMHelper(void *arg){
   
   struct constructSCCMHelperStruct *args =
                 (struct constructSCCMHelperStruct*) argPrime->specifics;
-  cu8 numEdges = args->numEdges;
-  pair<f64, size_t> **intermediateGraph = args->intermediateGraph;
+  csize_t *offsets = args->candidates->offsets;
+  cu32 *genes = args->candidates->genes;
   unordered_map<size_t, bool> *hashChecks = args->hashChecks;
   pthread_mutex_t *rowLocks = args->rowLocks;
   UpperDiagonalSquareMatrix<u8> *coincidenceMatrix = 
@@ -263,12 +375,12 @@ void *constructSCCMHelper(void *arg){
   size_t j = xStart;
   for(size_t i = yStart; i <= yEnd; i++){
     for(; (j < n && i < yEnd) || j < xEnd; j++){
-      for(size_t k = 0; k < numEdges; k++){
-        csize_t target = intermediateGraph[j][k].second;
+      for(size_t k = offsets[j]; k < offsets[j + 1]; k++){
+        csize_t target = genes[k];
         if(hashChecks[i].count(target)){
-          pthread_mutex_lock(&rowLocks[i]);
+          TRACE_MUTEX_LOCK(&rowLocks[i], "rowLocks wait");
           u8 *ptr = coincidenceMatrix->getReferenceForIndex(i, j);
-          (*ptr)++;
+          if(UINT8_MAX > *ptr) (*ptr)++;
           pthread_mutex_unlock(&rowLocks[i]);
         }
       }
@@ -280,7 +392,152 @@ void *constructSCCMHelper(void *arg){
 }
 
 
+template <typename T> void *thresholdCandidatesHelper(void *arg){
+  TRACE_SCOPE("thresholdCandidatesHelper");
+  struct multithreadLoad *argPrime = (struct multithreadLoad*) arg;
+  csize_t numerator = argPrime->numerator;
+  csize_t denominator = argPrime->denominator;
+
+  struct thresholdCandidatesHelperStruct<T> *args =
+      (struct thresholdCandidatesHelperStruct<T>*) argPrime->specifics;
+  const AlignedMatrix<T> *fullMatrix = args->fullMatrix;
+  csize_t numCols = args->numCols;
+  const T minCorrelation = args->minCorrelation;
+  const bool fill = args->fill;
+  size_t *offsets = args->candidates->offsets;
+  u32 *genes = args->candidates->genes;
+  csize_t numRows = args->candidates->numRows;
+
+  for(size_t i = (numerator * numRows) / denominator;
+                    i < ((numerator + 1) * numRows) / denominator; i++){
+    const T *values = fullMatrix->row(i);
+
+    if(fill){
+      size_t next = offsets[i];
+      for(size_t j = 0; j < numCols; j++)
+        if(values[j] >= minCorrelation) genes[next++] = (u32) j;
+    }else{
+      size_t count = 0;
+      for(size_t j = 0; j < numCols; j++)
+        count += values[j] >= minCorrelation;
+      offsets[i + 1] = count;
+    }
+  }
+
+  return NULL;
+}
+
+
+template <typename T> void topCandidates(
+          const correlationTable<T> &protoGraph, csize_t keepTopN,
+                                    struct candidateLists &candidates){
+  void *tmpPtr;
+  struct sortScratch<T, u32> scratch;
+
+  csize_t n = protoGraph.numRows();
+  csize_t keptEdges = keepTopN < protoGraph.numCols() ?
+                                        keepTopN : protoGraph.numCols();
+  //One slice of scratch for each thread autoThreadLauncher() starts
+  csize_t numCPUs = thread::hardware_concurrency();
+
+  allocationCheckBudget("pre_sccm_sort",
+                sizeof(pair<T, u32>) * n * protoGraph.numCols() +
+                sortScratchBytes<T, u32>(protoGraph.numCols(), numCPUs) +
+                sizeof(*candidates.offsets) * (n + 1) +
+                                sizeof(*candidates.genes) * n * keptEdges);
+  AlignedMatrix<pair<T, u32> > sortedEdges(n, protoGraph.numCols(),
+                                                      ALLOC_CANDIDATES);
+  if(!sortScratchOpen(scratch, protoGraph.numCols(), numCPUs)){
+    cerr << "Could not allocate sort space" << endl;
+    exit(ENOMEM);
+  }
+
+  struct constructGraphHelperStruct<T> preSCCMInstr;
+  preSCCMInstr = {
+      protoGraph.numRows(), 
+      protoGraph.numCols(),
+      &protoGraph.fullMatrix, 
+      &sortedEdges,
+      &scratch
+    };
+
+  autoThreadLauncher(constructPreSCCMHelper<T>, (void*) &preSCCMInstr);
+  sortScratchClose(scratch);
+
+  candidates.numRows = n;
+  tmpPtr = malloc(sizeof(*candidates.offsets) * (n + 1));
+  candidates.offsets = (size_t*) tmpPtr;
+  tmpPtr = malloc(sizeof(*candidates.genes) * n * keptEdges);
+  candidates.genes = (u32*) tmpPtr;
+  if(NULL == candidates.offsets || NULL == candidates.genes){
+    cerr << "Could not allocate the candidate lists" << endl;
+    exit(ENOMEM);
+  }
+  allocationRecord(ALLOC_CANDIDATES, sizeof(*candidates.offsets) *
+                      (n + 1) + sizeof(*candidates.genes) * n * keptEdges);
+
+  for(size_t i = 0; i <= n; i++)
+    candidates.offsets[i] = i * keptEdges;
+  for(size_t i = 0; i < n; i++)
+    for(size_t j = 0; j < keptEdges; j++)
+      candidates.genes[i * keptEdges + j] = sortedEdges(i, j).second;
+}
+
+
+template <typename T> void thresholdCandidates(
+          const correlationTable<T> &protoGraph, const T minCorrelation,
+                                    struct candidateLists &candidates){
+  void *tmpPtr;
+  struct thresholdCandidatesHelperStruct<T> instructions;
+
+  csize_t n = protoGraph.numRows();
+
+  candidates.numRows = n;
+  tmpPtr = malloc(sizeof(*candidates.offsets) * (n + 1));
+  candidates.offsets = (size_t*) tmpPtr;
+  candidates.genes = NULL;
+  if(NULL == candidates.offsets){
+    cerr << "Could not allocate the candidate offsets" << endl;
+    exit(ENOMEM);
+  }
+
+  instructions = {
+      &protoGraph.fullMatrix,
+      protoGraph.numCols(),
+      minCorrelation,
+      false,
+      &candidates
+    };
+
+  //Count, turn the counts into offsets, then fill in place
+  autoThreadLauncher(thresholdCandidatesHelper<T>, (void*) &instructions);
+  candidates.offsets[0] = 0;
+  for(size_t i = 0; i < n; i++)
+    candidates.offsets[i + 1] += candidates.offsets[i];
+
+  allocationCheckBudget("pre_sccm_sort",
+                  sizeof(*candidates.genes) * (candidates.offsets[n] + 1));
+  tmpPtr = malloc(sizeof(*candidates.genes) *
+                                            (candidates.offsets[n] + 1));
+  candidates.genes = (u32*) tmpPtr;
+  if(NULL == candidates.genes){
+    cerr << "Could not allocate " << candidates.offsets[n]
+         << " candidate genes; try a higher --min-correlation" << endl;
+    exit(ENOMEM);
+  }
+  allocationRecord(ALLOC_CANDIDATES, sizeof(*candidates.offsets) *
+              (n + 1) + sizeof(*candidates.genes) * candidates.offsets[n]);
+  instructions.fill = true;
+  autoThreadLauncher(thresholdCandidatesHelper<T>, (void*) &instructions);
+
+  cerr << "Kept " << candidates.offsets[n] << " candidate genes over "
+       << n << " TFs at a correlation of " << (f64) minCorrelation
+       << " or more" << endl;
+}
+
+
 void *sortCoindicenceMatrixHelper(void *arg){  
+  TRACE_SCOPE("sortCoindicenceMatrixHelper");
   struct multithreadLoad *argPrime = (struct multithreadLoad*) arg;
   csize_t numerator = argPrime->numerator;
   csize_t denominator = argPrime->denominator;
@@ -293,21 +550,25 @@ void *sortCoindicenceMatrixHelper(void *arg){
   UpperDiagonalSquareMatrix<u8> *coincidenceMatrix = 
                                                 args->coindicenceMatrix;
   csize_t n = args->n;
+  csize_t numToKeep = args->numToKeep;
   pair<u8, size_t> **sortedCoincidenceMatrix = 
                                           args->sortedCoincidenceMatrix;
   
-  void *tmpPtr;
+  struct sortScratch<u8, size_t> scratch;
   pair<u8, size_t> *sortColumn;
 
   
-  tmpPtr = malloc(sizeof(**sortedCoincidenceMatrix) * (n-1));
-  sortColumn = (pair<u8, size_t>*) tmpPtr;
+  if(!sortScratchSlice(*args->scratch, numerator, scratch)){
+    fprintf(stderr, "ERROR: No sort space for thread %zu\n", numerator);
+    fflush(stderr);
+    raise(SIGABRT);
+  }
+  sortColumn = scratch.sortSpace;
 
 
   for(size_t itr = (numerator * n) / denominator;
                       itr < ((numerator + 1) * n) / denominator; itr++){
     
-    
     for(size_t j = 0; j < itr; j++){
       sortColumn[j] = pair<u8, size_t>(coincidenceMatrix->getValueAtIndex(j, itr), j);
     }
@@ -315,60 +576,42 @@ void *sortCoindicenceMatrixHelper(void *arg){
       sortColumn[j-1] = pair<u8, size_t>(coincidenceMatrix->getValueAtIndex(itr, j), j);
     }
     
-    pair<u8, size_t> *sorted;
-    sorted = countingSortHighToLow(sortColumn, n-1);
-    sortedCoincidenceMatrix[itr] = sorted;
+    //Only the strongest are kept, straight into the shared array
+    countingSortHighToLow(sortColumn, n-1, sortedCoincidenceMatrix[itr],
+                                                              numToKeep);
   }
-  
-  free(sortColumn);
 
   return NULL;
 }
 
 
-UpperDiagonalSquareMatrix<u8>* constructCoincidenceMatrix(const CMF &protoGraph,
-                                                struct config &settings){
+template <typename T> UpperDiagonalSquareMatrix<u8>*
+                  constructCoincidenceMatrix(
+                                      correlationTable<T> &protoGraph,
+                                              struct config &settings){
+  TRACE_SCOPE("constructCoincidenceMatrix");
 
   void *tmpPtr;
-  pair<f64, size_t> **intermediateGraph;
   UpperDiagonalSquareMatrix<u8> *coincidenceMatrix;
+  struct candidateLists candidates;
   
 
   /*This is setting up for a general multithreading job dispatch*/
   csize_t n = protoGraph.numRows();
   
-  cu8 actualNumEdges = settings.keepTopN;
-
-  //Allocating preliminary memory
-  tmpPtr = malloc(sizeof(*intermediateGraph) * n);
-  intermediateGraph = (pair<f64, size_t>**) tmpPtr;
-  for(size_t i = 0; i < n; i++){
-    tmpPtr = malloc(sizeof(**intermediateGraph) * protoGraph.numCols());
-    intermediateGraph[i] = (pair<f64, size_t>*) tmpPtr;
-    memset(intermediateGraph[i], 0, sizeof(**intermediateGraph) * protoGraph.numCols());
-  }
-
-  struct constructGraphHelperStruct preSCCMInstr;
-  preSCCMInstr = {
-      protoGraph.numRows(), 
-      protoGraph.numCols(),
-      (cf64**) protoGraph.fullMatrix, 
-      intermediateGraph
-    };
-
-  autoThreadLauncher(constructPreSCCMHelper, (void*) &preSCCMInstr);
-  
-
-  //Don't need the very large UDMatrix in protoGraph; free it.
-  for(size_t i = 0; i < protoGraph.numRows(); i++)
-    free(protoGraph.fullMatrix[i]);
-  free(protoGraph.fullMatrix);
-
-  for(size_t i = 0; i < n; i++){
-    size_t allocSize = sizeof(**intermediateGraph) * actualNumEdges;
-    tmpPtr = realloc(intermediateGraph[i], allocSize);
-    intermediateGraph[i] = (pair<f64, size_t>*) tmpPtr;
-  }
+  profileBeginPhase("pre_sccm_sort");
+  if(0 < settings.minCorrelation)
+    thresholdCandidates(protoGraph, (T) settings.minCorrelation,
+                                                            candidates);
+  else
+    topCandidates(protoGraph, settings.keepTopN, candidates);
+
+  //Don't need the very large matrix in protoGraph; free it.
+  protoGraph.fullMatrix.release();
+  profileBeginPhase("sccm_build");
+  allocationCheckBudget("sccm_build", n * (n + 1) / 2 +
+              sizeof(pthread_mutex_t) * n +
+              (HASH_ENTRY_BYTES * 2) * candidates.offsets[n]);
 
   //Allocating coincidence matrix
   /*The coincidence matrix logic is best detailed in the paper*/  
@@ -378,9 +621,11 @@ UpperDiagonalSquareMatrix<u8>* constructCoincidenceMatrix(const CMF &protoGraph,
 
   for(size_t i = 0; i < n; i++){
     hashChecks[i].max_load_factor(0.5);
-    hashChecks[i].reserve(actualNumEdges);
-    for(size_t j = 0; j < actualNumEdges; j++){
-      size_t target = intermediateGraph[i][j].second;
+    hashChecks[i].reserve(candidates.offsets[i + 1] -
+                                                  candidates.offsets[i]);
+    for(size_t j = candidates.offsets[i]; j < candidates.offsets[i + 1];
+                                                                    j++){
+      size_t target = candidates.genes[j];
       pair<size_t, bool> toInsert(target, true);
       hashChecks[i].insert(toInsert);
     }
@@ -401,8 +646,7 @@ UpperDiagonalSquareMatrix<u8>* constructCoincidenceMatrix(const CMF &protoGraph,
   
   struct constructSCCMHelperStruct SCCMInstr;
   SCCMInstr = {
-    actualNumEdges,
-    intermediateGraph,
+    &candidates,
     hashChecks,
     rowLocks,
     coincidenceMatrix
@@ -415,29 +659,35 @@ UpperDiagonalSquareMatrix<u8>* constructCoincidenceMatrix(const CMF &protoGraph,
     pthread_mutex_destroy(&rowLocks[i]);
   };
   free(rowLocks);
-  
-  for(size_t i = 0; i < n; i++)
-    free(intermediateGraph[i]);
-  free(intermediateGraph);
+  //Sized from offsets, so released before it is freed
+  allocationRelease(ALLOC_CANDIDATES, sizeof(*candidates.offsets) *
+          (n + 1) + sizeof(*candidates.genes) * candidates.offsets[n]);
+  free(candidates.offsets);
+  free(candidates.genes);
   
   return coincidenceMatrix;
 }
 
 
-graph<geneData, u8>* constructGraph(UpperDiagonalSquareMatrix<u8> *SCCM,
-                        const CMF &protoGraph, struct config &settings){
+template <typename T> graph<geneData, u8>* constructGraph(
+                                    UpperDiagonalSquareMatrix<u8> *SCCM,
+          const correlationTable<T> &protoGraph, struct config &settings){
+  TRACE_SCOPE("constructGraph");
   graph<geneData, u8>* tr;
   void *tmpPtr;
   pthread_t *workers;
   int *toIgnore;
-  pair<u8, size_t> **sortedCoincidenceMatrix;
+  pair<u8, size_t> **sortedCoincidenceMatrix, *sortedSpace;
   f64 sigma;
   size_t clen, sum;
   struct sortCoindicenceMatrixHelperStruct sortInstructions;
+  struct sortScratch<u8, size_t> scratch;
   
   csize_t n = protoGraph.numRows();
   
-  cu8 actualNumEdges = (u8) settings.keepTopN;
+  //A row of the SCCM has only n-1 other genes to keep
+  cu8 actualNumEdges = (u8) (n - 1 < settings.keepTopN ? n - 1 :
+                                                      settings.keepTopN);
   csize_t numCPUs = thread::hardware_concurrency();
   
   
@@ -445,24 +695,41 @@ graph<geneData, u8>* constructGraph(UpperDiagonalSquareMatrix<u8> *SCCM,
   //add the top keepN entries into the graph for consideration.
   
   //Sorting coincidence matrix
+  profileBeginPhase("coincidence_sort");
+  //Each row's kept entries share one array, and each thread sorts
+  //through its slice of one scratch
+  allocationCheckBudget("coincidence_sort",
+                      sizeof(*sortedCoincidenceMatrix) * n +
+                      sizeof(**sortedCoincidenceMatrix) *
+                                                  n * actualNumEdges +
+                      sortScratchBytes<u8, size_t>(n - 1, numCPUs));
   tmpPtr = malloc(sizeof(*sortedCoincidenceMatrix) * n);
   sortedCoincidenceMatrix = (pair<u8, size_t>**) tmpPtr;
+  tmpPtr = malloc(sizeof(**sortedCoincidenceMatrix) * n * actualNumEdges
+                                                                    + 1);
+  sortedSpace = (pair<u8, size_t>*) tmpPtr;
+  if(NULL == sortedCoincidenceMatrix || NULL == sortedSpace ||
+                                  !sortScratchOpen(scratch, n - 1, numCPUs)){
+    cerr << "Could not allocate the sorted SCCM" << endl;
+    exit(ENOMEM);
+  }
+  for(size_t i = 0; i < n; i++)
+    sortedCoincidenceMatrix[i] = sortedSpace + i * actualNumEdges;
+  allocationRecord(ALLOC_SCCM_SORT, n * (sizeof(*sortedCoincidenceMatrix)
+                  + actualNumEdges * sizeof(**sortedCoincidenceMatrix)));
   
   sortInstructions = {
       SCCM, 
       n, 
-      sortedCoincidenceMatrix
+      actualNumEdges,
+      sortedCoincidenceMatrix,
+      &scratch
     };
   
   autoThreadLauncher(sortCoindicenceMatrixHelper, 
                                             (void*) &sortInstructions);
- 
-  
-  for(size_t i = 0; i < n; i++){
-    tmpPtr = realloc(sortedCoincidenceMatrix[i], 
-                    actualNumEdges * sizeof(**sortedCoincidenceMatrix));
-    sortedCoincidenceMatrix[i] = (pair<u8, size_t>*) tmpPtr;
-  }
+  sortScratchClose(scratch);
+  profileBeginPhase("graph_build");
   
   
   //Calculating statistics
@@ -505,7 +772,14 @@ graph<geneData, u8>* constructGraph(UpperDiagonalSquareMatrix<u8> *SCCM,
 
 
   //now prepare the graph for all the data it is about to recieve, else
-  //after the fact memory allocations can take minutes.
+  //after the fact memory allocations can take minutes.  Each edge is
+  //held by the graph and both of its vertexes, which also hold the
+  //vertex at its other end.
+  allocationCheckBudget("graph_build",
+      n * (sizeof(vertex<geneData, u8>) + sizeof(void*) +
+                                                      HASH_ENTRY_BYTES) +
+      n * actualNumEdges * (sizeof(edge<geneData, u8>) +
+                                                    5 * sizeof(void*)));
   tr = new graph<geneData, u8>();
 
   tr->hintNumVertexes(protoGraph.numRows());
@@ -527,10 +801,10 @@ graph<geneData, u8>* constructGraph(UpperDiagonalSquareMatrix<u8> *SCCM,
     }
   }
 
-  for(size_t i = 0; i < n; i++){
-    free(sortedCoincidenceMatrix[i]);
-  }
+  free(sortedSpace);
   free(sortedCoincidenceMatrix);
+  allocationRelease(ALLOC_SCCM_SORT, n * (sizeof(*sortedCoincidenceMatrix)
+                + actualNumEdges * sizeof(**sortedCoincidenceMatrix)));
   
   tr->shrinkToFit();
 
@@ -539,13 +813,77 @@ graph<geneData, u8>* constructGraph(UpperDiagonalSquareMatrix<u8> *SCCM,
 
 
 void sortDoubleSizeTPairHighToLow(pair<f64, size_t> *toSort,
-                                                          csize_t size){
+            csize_t size, struct sortScratch<f64, size_t> &scratch){
+  sortPairHighToLow(toSort, size, scratch);
+}
+
+
+template <typename T, typename I> size_t sortScratchBytes(
+                                  csize_t capacity, csize_t slices){
+  //There are at most capacity + 1 run boundaries
+  return slices * (sizeof(pair<T, I>) * capacity +
+                                    2 * sizeof(size_t) * (capacity + 1));
+}
+
+
+template <typename T, typename I> bool sortScratchOpen(
+                struct sortScratch<T, I> &scratch, csize_t capacity,
+                                                    csize_t slices){
+  void *tmpPtr;
+
+  //Every slice's sort space, then every slice's pair of run arrays
+  tmpPtr = malloc(sortScratchBytes<T, I>(capacity, slices));
+  scratch.sortSpace = (pair<T, I>*) tmpPtr;
+  if(NULL == tmpPtr) return false;
+  scratch.runs = (size_t*) (scratch.sortSpace + slices * capacity);
+  scratch.newRuns = scratch.runs + capacity + 1;
+  scratch.capacity = capacity;
+  scratch.slices = slices;
+
+  return true;
+}
+
+
+template <typename T, typename I> bool sortScratchSlice(
+                  const struct sortScratch<T, I> &scratch, csize_t index,
+                                        struct sortScratch<T, I> &slice){
+  if(index >= scratch.slices){
+    slice = {NULL, NULL, NULL, 0, 0};
+    return false;
+  }
+
+  csize_t capacity = scratch.capacity;
+  slice.sortSpace = scratch.sortSpace + index * capacity;
+  slice.runs = scratch.runs + index * 2 * (capacity + 1);
+  slice.newRuns = slice.runs + capacity + 1;
+  slice.capacity = capacity;
+  slice.slices = 1;
+
+  return true;
+}
+
+
+template <typename T, typename I> void sortScratchClose(
+                                    struct sortScratch<T, I> &scratch){
+  free(scratch.sortSpace);
+  scratch.sortSpace = NULL;
+  scratch.runs = scratch.newRuns = NULL;
+  scratch.capacity = 0;
+  scratch.slices = 0;
+}
+
+
+template <typename T, typename I> void sortPairHighToLow(
+                                  pair<T, I> *toSort, csize_t size,
+                                  struct sortScratch<T, I> &scratch){
   size_t numRising;
   size_t i;
-  void *tmpPtr;
-  size_t *indiciesOfInterest, *newIndiciesOfInterest;
+  size_t *indiciesOfInterest = scratch.runs;
+  size_t *newIndiciesOfInterest = scratch.newRuns;
+  pair<T, I> *sortSpace = scratch.sortSpace;
 
   if(1 >= size) return;
+  if(size > scratch.capacity) raise(SIGABRT);
 
   numRising = 0;
 
@@ -555,7 +893,7 @@ void sortDoubleSizeTPairHighToLow(pair<f64, size_t> *toSort,
 
   if(numRising > (size >> 1)){
     //reverse so that more are in order
-    pair<f64, size_t> tmp;
+    pair<T, I> tmp;
     for(i = 0; i < size/2; i++){
       tmp = toSort[i];
       toSort[i] = toSort[(size-1) - i];
@@ -563,8 +901,6 @@ void sortDoubleSizeTPairHighToLow(pair<f64, size_t> *toSort,
     }
   }
 
-  tmpPtr = malloc(sizeof(*indiciesOfInterest) * size);
-  indiciesOfInterest = (size_t*) tmpPtr;
   indiciesOfInterest[0] = 0;
   size_t IOISize = 1;
 
@@ -574,18 +910,11 @@ void sortDoubleSizeTPairHighToLow(pair<f64, size_t> *toSort,
   }
   indiciesOfInterest[IOISize++] = size;
 
-  pair<f64, size_t> *sortSpace;
-  tmpPtr = malloc(sizeof(*sortSpace) * size);
-  sortSpace = (pair<f64, size_t>*) tmpPtr;
-
-  tmpPtr = malloc(sizeof(*newIndiciesOfInterest) * size);
-  newIndiciesOfInterest = (size_t*) tmpPtr;
-
   while(IOISize > 2){
     size_t NIOISize = 0;
     for(i = 0; i < IOISize-2; i+=2){
 
-      sortDoubleSizeTPairHighToLowHelper(toSort, indiciesOfInterest[i],
+      sortPairHighToLowHelper(toSort, indiciesOfInterest[i],
                       indiciesOfInterest[i+1], indiciesOfInterest[i+2],
                                                             sortSpace);
 
@@ -599,16 +928,13 @@ void sortDoubleSizeTPairHighToLow(pair<f64, size_t> *toSort,
                                 NIOISize * sizeof(*indiciesOfInterest));
     IOISize = NIOISize;
   }
-
-  free(indiciesOfInterest);
-  free(newIndiciesOfInterest);
-  free(sortSpace);
 }
 
 
-void sortDoubleSizeTPairHighToLowHelper(pair<f64, size_t> *toSort,
-                csize_t leftIndex, csize_t rightIndex, csize_t endIndex,
-                                          pair<f64, size_t> *sortSpace){
+template <typename T, typename I> void sortPairHighToLowHelper(
+                    pair<T, I> *toSort, csize_t leftIndex,
+                    csize_t rightIndex, csize_t endIndex,
+                                              pair<T, I> *sortSpace){
   size_t leftParser, rightParser, mergedParser;
 
   leftParser = leftIndex;
@@ -629,12 +955,15 @@ void sortDoubleSizeTPairHighToLowHelper(pair<f64, size_t> *toSort,
 
 
 void sortDoubleSizeTPairLowToHigh(pair<f64, size_t> *toSort,
-                                                          csize_t size){
+            csize_t size, struct sortScratch<f64, size_t> &scratch){
   size_t numFalling;
   size_t i;
-  void *tmpPtr;
+  size_t *indiciesOfInterest = scratch.runs;
+  size_t *newIndiciesOfInterest = scratch.newRuns;
+  pair<f64, size_t> *sortSpace = scratch.sortSpace;
 
   if(1 >= size) return;
+  if(size > scratch.capacity) raise(SIGABRT);
 
   numFalling = 0;
 
@@ -652,7 +981,6 @@ void sortDoubleSizeTPairLowToHigh(pair<f64, size_t> *toSort,
     }
   }
 
-  size_t* indiciesOfInterest = new size_t[size];
   indiciesOfInterest[0] = 0;
   size_t IOISize = 1;
 
@@ -662,11 +990,6 @@ void sortDoubleSizeTPairLowToHigh(pair<f64, size_t> *toSort,
   }
   indiciesOfInterest[IOISize++] = size;
 
-  pair<f64, size_t> *sortSpace;
-  tmpPtr = malloc(sizeof(*sortSpace) * size);
-  sortSpace = (pair<f64, size_t>*) tmpPtr;
-
-  size_t *newIndiciesOfInterest = new size_t[size];
   while(IOISize > 2){
     size_t NIOISize = 0;
     for(i = 0; i < IOISize-2; i+=2){
@@ -685,11 +1008,6 @@ void sortDoubleSizeTPairLowToHigh(pair<f64, size_t> *toSort,
                                 NIOISize * sizeof(*indiciesOfInterest));
     IOISize = NIOISize;
   }
-
-  delete[] indiciesOfInterest;
-  delete[] newIndiciesOfInterest;
-  free(sortSpace);
-
 }
 
 
@@ -722,30 +1040,45 @@ void inPlaceAbsoluteValue(f64 *array, csize_t size){
 }
 
 
-pair<u8, size_t>* countingSortHighToLow(pair<u8, size_t> *toSort, 
-                                                            csize_t n){
+void countingSortHighToLow(const pair<u8, size_t> *toSort, csize_t n,
+                        pair<u8, size_t> *sorted, csize_t numToKeep){
   size_t counts[256];
-  pair<u8, size_t> *sortSpace;
-  void *tmpPtr;
   
   memset(counts, 0, sizeof(counts));
   
-  tmpPtr = malloc(sizeof(*sortSpace) * n);
-  sortSpace = (pair<u8, size_t>*) tmpPtr;
-  
   for(size_t i = 0; i < n; i++)
     counts[toSort[i].first]++;
   for(int i = 255-1; i >= 0; i--)
     counts[i] += counts[i+1];
   
   for(size_t i = n-1; i != ((size_t)0)-1; i--){
-    counts[toSort[i].first]--;
-    sortSpace[counts[toSort[i].first]] = toSort[i];
+    csize_t position = --counts[toSort[i].first];
+    if(position < numToKeep) sorted[position] = toSort[i];
   }
-  
-  return sortSpace;
 }
 
+////////////////////////////////////////////////////////////////////////
+//EXPLICIT INSTANTIATIONS///////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+template UpperDiagonalSquareMatrix<u8>* constructCoincidenceMatrix(
+                  correlationTable<f64>&, struct config&);
+template UpperDiagonalSquareMatrix<u8>* constructCoincidenceMatrix(
+                  correlationTable<f32>&, struct config&);
+
+template graph<geneData, u8>* constructGraph(
+                  UpperDiagonalSquareMatrix<u8>*,
+                  const correlationTable<f64>&, struct config&);
+template graph<geneData, u8>* constructGraph(
+                  UpperDiagonalSquareMatrix<u8>*,
+                  const correlationTable<f32>&, struct config&);
+
+template bool sortScratchOpen(struct sortScratch<f64, size_t>&, csize_t,
+                                                                csize_t);
+template void sortScratchClose(struct sortScratch<f64, size_t>&);
+template void sortPairHighToLow(pair<f64, size_t>*, csize_t,
+                                        struct sortScratch<f64, size_t>&);
+
 ////////////////////////////////////////////////////////////////////////
 //END///////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
@@ -24,6 +24,7 @@
 #include <string>
 #include <utility>
 
+#include "clusters.hpp"
 #include "correlation-matrix.hpp"
 #include "geneData.hpp"
 #include "graph.hpp"
@@ -42,30 +43,95 @@ using std::vector;
 
 typedef unsigned char u8;
 typedef unsigned int  u32;
+typedef unsigned long long u64;
 
+typedef float  f32;
 typedef double f64;
 
 typedef const unsigned char cu8;
 typedef const unsigned int  cu32;
+typedef const unsigned long long cu64;
 typedef const std::size_t csize_t;
+typedef const float  cf32;
 typedef const double cf64;
 
+template <typename T> struct correlationTable;
+
 ////////////////////////////////////////////////////////////////////////
 //STRUCTS///////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
 
+/*******************************************************************//**
+ *  Which genes to keep from an expression file.  Genes whose variance
+ * is below minVariance or whose mean is below minMean are dropped; if
+ * topVariable is not 0 only that many of the most variable remaining
+ * genes are kept.  Listed TFs are always kept.  {0, -HUGE_VAL, 0} keeps
+ * everything.
+ **********************************************************************/
+struct geneFilter{
+  f64 minVariance;
+  f64 minMean;
+  size_t topVariable;
+};
+
+
 /*******************************************************************//**
  *  Describe relevant configuration information for a run of TF-cluster
  **********************************************************************/
 struct config{  
   s8 *tflist;
   s8 *exprData;
-  s8 *corrMethod;
+  cs8 *corrMethod;
+  bool singlePrecision;
   
   double threeSigma, twoSigma, oneSigma;
   u8 threeSigmaAdj, twoSigmaAdj, oneSigmaAdj;
   
   u8 keepTopN;
+
+  struct geneFilter filter;
+
+  /*When above 0, each TF's candidates are every gene correlated with it
+  at least this much rather than its keepTopN best.*/
+  f64 minCorrelation;
+
+  /*Write a phase timing report; to profileFile, or stderr if NULL.*/
+  bool profile;
+  cs8 *profileFile;
+
+  /*Add hardware counters to each phase of the report.*/
+  bool perfCounters;
+
+  /*Write a Chrome trace timeline here unless NULL.*/
+  cs8 *traceFile;
+
+  /*Stop before a phase which would take tracked allocations past this
+  many bytes; 0 for no limit.*/
+  size_t maxMemory;
+
+  /*Layout the clusters are printed in.*/
+  enum clusterFormat outputFormat;
+
+  /*Seeds triple-link expands at once from anywhere in the graph; 1 for
+  one per core, each from a different component, or 0 for one at a
+  time.*/
+  size_t speculativeSeeds;
+
+  /*Run triple-link as first written, one seed at a time, searching the
+  whole graph for each.*/
+  bool serialLink;
+};
+
+
+/*******************************************************************//**
+ *  Work slice handed to each thread by autoThreadLauncher().  A thread
+ * handles the numerator'th of denominator equal parts of the work
+ * described by specifics.
+ **********************************************************************/
+struct multithreadLoad{
+  size_t numerator;
+  size_t denominator;
+  void *specifics;
 };
 
 
@@ -79,9 +145,9 @@ struct config{
  *  Make a mostly usable graph for triple-link clustering given
  * triple-link's related constraints.
  *
- * @param[in,out] protoGraph Holds gene names and an Upper Diagonal
-                             matrix.  During this function, UDMatrix is
-                             free'd.
+ * @param[in,out] protoGraph Holds gene names and the correlation
+                             matrix.  During this function, the matrix
+                             is released.
  * @param[in] threeSigma Value which each row much and an edge greater
                          or equal to.
  * @param[in] oneSigma Value which any edge that is less than is not
@@ -90,13 +156,16 @@ struct config{
                           can have.
  **********************************************************************/
 //TODO: update doc
-UpperDiagonalSquareMatrix<u8>* constructCoincidenceMatrix(const CMF &protoGraph, 
+template <typename T> UpperDiagonalSquareMatrix<u8>*
+                  constructCoincidenceMatrix(
+                                      correlationTable<T> &protoGraph,
                                               struct config &settings);
                                           
 
 //TODO: add doc
-graph<geneData, u8>* constructGraph(UpperDiagonalSquareMatrix<u8> *SCCM,
-                        const CMF &protoGraph, struct config &settings);
+template <typename T> graph<geneData, u8>* constructGraph(
+                                    UpperDiagonalSquareMatrix<u8> *SCCM,
+          const correlationTable<T> &protoGraph, struct config &settings);
 
 
 /*******************************************************************//**
@@ -112,6 +181,57 @@ graph<geneData, u8>* constructGraph(UpperDiagonalSquareMatrix<u8> *SCCM,
 //void pruneGraph(graph<geneData, f64> *corrData, cu8 keepTopN);
 
 
+/*******************************************************************//**
+ *  Scratch space for the quick-merge sorts of up to capacity pairs,
+ * allocated once per phase by sortScratchOpen() so that sorting many
+ * rows makes no heap calls.  One allocation may hold a slice for each
+ * thread, taken with sortScratchSlice().
+ **********************************************************************/
+template <typename T, typename I> struct sortScratch{
+  pair<T, I> *sortSpace;
+  size_t *runs, *newRuns;
+  size_t capacity;
+  size_t slices;
+};
+
+
+/*******************************************************************//**
+ *  Allocate scratch for sorting arrays of up to capacity pairs, in a
+ * single block holding slices independent slices.
+ *
+ * @return false if it could not be allocated.
+ **********************************************************************/
+template <typename T, typename I> bool sortScratchOpen(
+                struct sortScratch<T, I> &scratch, csize_t capacity,
+                                                  csize_t slices = 1);
+
+
+/*******************************************************************//**
+ *  Bytes sortScratchOpen() allocates for the same arguments, for
+ * allocationCheckBudget().
+ **********************************************************************/
+template <typename T, typename I> size_t sortScratchBytes(
+                              csize_t capacity, csize_t slices = 1);
+
+
+/*******************************************************************//**
+ *  Slice index of scratch, which is not to be closed on its own.
+ *
+ * @param[out] slice Scratch for one thread's sorts.
+ * @return false if scratch has no such slice.
+ **********************************************************************/
+template <typename T, typename I> bool sortScratchSlice(
+                  const struct sortScratch<T, I> &scratch, csize_t index,
+                                        struct sortScratch<T, I> &slice);
+
+
+/*******************************************************************//**
+ *  Free scratch allocated by sortScratchOpen().
+ **********************************************************************/
+template <typename T, typename I> void sortScratchClose(
+                                    struct sortScratch<T, I> &scratch);
+
+
 /*******************************************************************//**
  *  Using the quick-merge algorithm, sort an array of pairs by it's
  * first value.  Sorts high to low.
@@ -119,9 +239,24 @@ graph<geneData, u8>* constructGraph(UpperDiagonalSquareMatrix<u8> *SCCM,
  * @param[in,out] toSort Array of pairs to sort, and contains the sorted
                          result.
  * @param[in] size Number of pairs in toSort.
+ * @param[in] scratch Space to sort through, of capacity at least size.
  **********************************************************************/
 void sortDoubleSizeTPairHighToLow(pair<f64, size_t> *toSort,
-                                                          csize_t size);
+            csize_t size, struct sortScratch<f64, size_t> &scratch);
+
+
+/*******************************************************************//**
+ *  sortDoubleSizeTPairHighToLow() for any value and index type, so that
+ * single precision candidates can be sorted as 8 byte pairs.
+ *
+ * @param[in,out] toSort Array of pairs to sort, and contains the sorted
+                         result.
+ * @param[in] size Number of pairs in toSort.
+ * @param[in] scratch Space to sort through, of capacity at least size.
+ **********************************************************************/
+template <typename T, typename I> void sortPairHighToLow(
+                                  pair<T, I> *toSort, csize_t size,
+                                  struct sortScratch<T, I> &scratch);
 
 
 /*******************************************************************//**
@@ -131,9 +266,10 @@ void sortDoubleSizeTPairHighToLow(pair<f64, size_t> *toSort,
  * @param[in,out] toSort Array of pairs to sort, and contains the sorted
                          result.
  * @param[in] size Number of pairs in toSort.
+ * @param[in] scratch Space to sort through, of capacity at least size.
  **********************************************************************/
 void sortDoubleSizeTPairLowToHigh(pair<f64, size_t> *toSort,
-                                                          csize_t size);
+            csize_t size, struct sortScratch<f64, size_t> &scratch);
 
 
 /*******************************************************************//**
@@ -146,9 +282,29 @@ void sortDoubleSizeTPairLowToHigh(pair<f64, size_t> *toSort,
 void inPlaceAbsoluteValue(f64 *array, csize_t size);
 
 
-//TODO add doc
-pair<u8, size_t>* countingSortHighToLow(pair<u8, size_t> *toSort, 
-                                                            csize_t n);
+/*******************************************************************//**
+ *  Run func on one thread per available core, each given its own
+ * struct multithreadLoad with sharedArgs as the specifics, and wait for
+ * all of them to finish.
+ *
+ * @param[in] func Thread entry point.
+ * @param[in] sharedArgs Arguments common to every thread.
+ **********************************************************************/
+void autoThreadLauncher(void* (*func)(void*), void *sharedArgs);
+
+
+/*******************************************************************//**
+ *  Stably sort n pairs by their first value, high to low, in linear
+ * time, writing only the first numToKeep pairs of the result to sorted
+ * so that nothing need be allocated.
+ *
+ * @param[in] toSort Pairs to sort.
+ * @param[in] n Number of pairs in toSort.
+ * @param[out] sorted Space for numToKeep pairs.
+ * @param[in] numToKeep Number of the highest pairs to keep; at most n.
+ **********************************************************************/
+void countingSortHighToLow(const pair<u8, size_t> *toSort, csize_t n,
+                        pair<u8, size_t> *sorted, csize_t numToKeep);
 
 
 ////////////////////////////////////////////////////////////////////////
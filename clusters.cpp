@@ -0,0 +1,231 @@
+/*******************************************************************//**
+         FILE:  clusters.cpp
+
+  DESCRIPTION:  The clusters found by triple-link, and the buffered
+                writer which prints them
+
+         BUGS:  ---
+        NOTES:  Output is built in a 1 MiB buffer and handed to fwrite
+                whenever it fills, or at the end of each cluster when
+                streaming, so clusters are never written a line at a
+                time however the stream is buffered.
+       AUTHOR:  Josh Marshall <jrmarsha@mtu.edu>
+      COMPANY:  Michigan technological University
+      VERSION:  See git log
+      CREATED:  See git log
+     REVISION:  See git log
+     LISCENSE:  GPLv3
+***********************************************************************/
+
+////////////////////////////////////////////////////////////////////////
+//INCLUDES//////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "clusters.hpp"
+
+////////////////////////////////////////////////////////////////////////
+//NAMESPACE USING///////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+using std::string;
+using std::vector;
+
+////////////////////////////////////////////////////////////////////////
+//PRIVATE CONSTANTS/////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+static const size_t OUTPUT_BUFFER_BYTES = 1 << 20;
+
+////////////////////////////////////////////////////////////////////////
+//PRIVATE FUNCTION DECLARATIONS/////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************//**
+ *  Hand everything in writer's buffer to its stream.
+ **********************************************************************/
+void flushBuffer(struct clusterWriter &writer);
+
+
+/*******************************************************************//**
+ *  Append size bytes of text to writer's buffer, flushing it as it
+ * fills.
+ **********************************************************************/
+void putBytes(struct clusterWriter &writer, const char *text, size_t size);
+
+
+/*******************************************************************//**
+ *  Append the decimal digits of value to writer's buffer.
+ **********************************************************************/
+void putNumber(struct clusterWriter &writer, size_t value);
+
+
+/*******************************************************************//**
+ *  Append text to writer's buffer as a quoted JSON string.
+ **********************************************************************/
+void putJSONString(struct clusterWriter &writer, const string &text);
+
+////////////////////////////////////////////////////////////////////////
+//FUNCTION DEFINITIONS//////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+void flushBuffer(struct clusterWriter &writer){
+  if(writer.used && fwrite(writer.buffer, 1, writer.used, writer.out)
+                                                          != writer.used)
+    writer.failed = true;
+  writer.used = 0;
+}
+
+
+void putBytes(struct clusterWriter &writer, const char *text, size_t size){
+  while(size){
+    size_t toCopy = OUTPUT_BUFFER_BYTES - writer.used;
+    if(toCopy > size) toCopy = size;
+    memcpy(writer.buffer + writer.used, text, toCopy);
+    writer.used += toCopy;
+    text += toCopy;
+    size -= toCopy;
+    if(OUTPUT_BUFFER_BYTES == writer.used) flushBuffer(writer);
+  }
+}
+
+
+void putNumber(struct clusterWriter &writer, size_t value){
+  char digits[24];
+  size_t i = sizeof(digits);
+
+  do{
+    digits[--i] = (char) ('0' + value % 10);
+    value /= 10;
+  }while(value);
+  putBytes(writer, digits + i, sizeof(digits) - i);
+}
+
+
+void putJSONString(struct clusterWriter &writer, const string &text){
+  static const char hex[] = "0123456789abcdef";
+  size_t start = 0;
+
+  putBytes(writer, "\"", 1);
+  for(size_t i = 0; i < text.size(); i++){
+    const unsigned char c = (unsigned char) text[i];
+    if('"' != c && '\\' != c && 0x20 <= c) continue;
+
+    putBytes(writer, text.data() + start, i - start);
+    start = i + 1;
+    if('"' == c || '\\' == c){
+      const char escaped[2] = {'\\', (char) c};
+      putBytes(writer, escaped, 2);
+    }else{
+      const char escaped[6] = {'\\', 'u', '0', '0', hex[c >> 4],
+                                                            hex[c & 15]};
+      putBytes(writer, escaped, 6);
+    }
+  }
+  putBytes(writer, text.data() + start, text.size() - start);
+  putBytes(writer, "\"", 1);
+}
+
+
+bool parseClusterFormat(const char *name, enum clusterFormat &format){
+  if(!strcmp("text", name)) format = CLUSTER_FORMAT_TEXT;
+  else if(!strcmp("tsv", name)) format = CLUSTER_FORMAT_TSV;
+  else if(!strcmp("jsonl", name)) format = CLUSTER_FORMAT_JSONL;
+  else return false;
+
+  return true;
+}
+
+
+bool clusterWriterOpen(struct clusterWriter &writer,
+                        const vector<string> &names,
+                        enum clusterFormat format, FILE *out,
+                        bool flushEachCluster){
+  writer = clusterWriter{&names, format, flushEachCluster, 0, out, NULL,
+                                                              0, false};
+  writer.buffer = (char*) malloc(OUTPUT_BUFFER_BYTES);
+  if(NULL == writer.buffer) return false;
+
+  if(CLUSTER_FORMAT_TSV == format)
+    putBytes(writer, "cluster_id\tgene\torder\n", 22);
+
+  return true;
+}
+
+
+void clusterWriterAdd(struct clusterWriter &writer, const size_t *members,
+                                                    size_t numMembers){
+  const vector<string> &names = *writer.names;
+  const size_t id = ++writer.numWritten;
+
+  switch(writer.format){
+    case CLUSTER_FORMAT_TEXT:
+      putBytes(writer, "cluster: ", 9);
+      putNumber(writer, id);
+      putBytes(writer, "\n", 1);
+      for(size_t j = 0; j < numMembers; j++){
+        const string &name = names[members[j]];
+        putBytes(writer, name.data(), name.size());
+        putBytes(writer, "\n", 1);
+      }
+      break;
+    case CLUSTER_FORMAT_TSV:
+      for(size_t j = 0; j < numMembers; j++){
+        const string &name = names[members[j]];
+        putNumber(writer, id);
+        putBytes(writer, "\t", 1);
+        putBytes(writer, name.data(), name.size());
+        putBytes(writer, "\t", 1);
+        putNumber(writer, j + 1);
+        putBytes(writer, "\n", 1);
+      }
+      break;
+    case CLUSTER_FORMAT_JSONL:
+      putBytes(writer, "{\"cluster\": ", 12);
+      putNumber(writer, id);
+      putBytes(writer, ", \"genes\": [", 12);
+      for(size_t j = 0; j < numMembers; j++){
+        if(j) putBytes(writer, ", ", 2);
+        putJSONString(writer, names[members[j]]);
+      }
+      putBytes(writer, "]}\n", 3);
+      break;
+  }
+
+  if(writer.flushEachCluster){
+    flushBuffer(writer);
+    if(fflush(writer.out)) writer.failed = true;
+  }
+}
+
+
+void clusterWriterSink(const size_t *members, size_t numMembers,
+                                                          void *writer){
+  clusterWriterAdd(*(struct clusterWriter*) writer, members, numMembers);
+}
+
+
+bool clusterWriterClose(struct clusterWriter &writer){
+  flushBuffer(writer);
+  free(writer.buffer);
+  writer.buffer = NULL;
+  if(fflush(writer.out)) writer.failed = true;
+
+  return !writer.failed;
+}
+
+
+bool streamIsRegularFile(FILE *stream){
+  struct stat status;
+
+  if(fstat(fileno(stream), &status)) return false;
+
+  return S_ISREG(status.st_mode);
+}
+
+////////////////////////////////////////////////////////////////////////
+//END///////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,172 @@
+/*******************************************************************//**
+         FILE:  clusters.hpp
+
+  DESCRIPTION:  The clusters found by triple-link, and the buffered
+                writer which prints them
+
+         BUGS:  ---
+        NOTES:  Clusters are held flat: the members of cluster i are
+                members[offsets[i]] up to members[offsets[i + 1]], so a
+                run's result is two arrays however many clusters it has.
+                A clusterWriter can instead be fed clusters one at a time
+                as triple-link finds them.
+       AUTHOR:  Josh Marshall <jrmarsha@mtu.edu>
+      COMPANY:  Michigan technological University
+      VERSION:  See git log
+      CREATED:  See git log
+     REVISION:  See git log
+     LISCENSE:  GPLv3
+***********************************************************************/
+#ifndef CLUSTERS_HPP
+#define CLUSTERS_HPP
+
+////////////////////////////////////////////////////////////////////////
+//INCLUDES//////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////
+//ENUMS/////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*Layouts clusters can be written in.*/
+enum clusterFormat{
+  /*"cluster: N" followed by one gene per line; the original output*/
+  CLUSTER_FORMAT_TEXT = 0,
+  /*A cluster_id, gene, order header, then one row per gene*/
+  CLUSTER_FORMAT_TSV,
+  /*One {"cluster": N, "genes": [...]} object per line*/
+  CLUSTER_FORMAT_JSONL
+};
+
+////////////////////////////////////////////////////////////////////////
+//TYPEDEFS//////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*Receives each cluster, as the label indexes of its numMembers members,
+as soon as it is complete.  context is passed through untouched.*/
+typedef void (*clusterSink)(const size_t *members, size_t numMembers,
+                                                        void *context);
+
+////////////////////////////////////////////////////////////////////////
+//STRUCTS///////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************//**
+ *  Clusters of label indexes, in the order they were found.  offsets
+ * always starts with 0 and has one more entry than there are clusters.
+ **********************************************************************/
+struct clusterList{
+  std::vector<size_t> offsets;
+  std::vector<size_t> members;
+
+  clusterList() : offsets(1, 0){}
+
+  /*Number of clusters.*/
+  size_t size() const{ return offsets.size() - 1; }
+
+  /*Number of members of cluster i.*/
+  size_t clusterSize(size_t i) const{
+    return offsets[i + 1] - offsets[i];
+  }
+
+  /*First member of cluster i; the rest follow it.*/
+  const size_t* cluster(size_t i) const{ return &members[offsets[i]]; }
+
+  /*Make the members added since the last cluster ended a cluster.*/
+  void endCluster(){ offsets.push_back(members.size()); }
+
+  /*Drop every cluster, keeping the arrays' capacity.*/
+  void clear(){ offsets.resize(1); members.clear(); }
+};
+
+
+/*******************************************************************//**
+ *  Clusters being written to a stream as they arrive; see
+ * clusterWriterOpen().  Output is built in buffer and handed to out
+ * whenever it fills, or after every cluster if flushEachCluster is set.
+ **********************************************************************/
+struct clusterWriter{
+  const std::vector<std::string> *names;
+  enum clusterFormat format;
+  bool flushEachCluster;
+  size_t numWritten;
+
+  FILE *out;
+  char *buffer;
+  size_t used;
+  bool failed;
+};
+
+////////////////////////////////////////////////////////////////////////
+//PUBLIC FUNCTION DECLARATIONS//////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************//**
+ *  Look up a format by the name --output-format takes: text, tsv or
+ * jsonl.
+ *
+ * @return false if name is not one of them.
+ **********************************************************************/
+bool parseClusterFormat(const char *name, enum clusterFormat &format);
+
+
+/*******************************************************************//**
+ *  Start writing clusters to out.  Clusters are numbered from 1 in the
+ * order they are added.
+ *
+ * @param[out] writer Writer to set up.
+ * @param[in] names Label of each index; must outlive the writer.
+ * @param[in] format Layout to write.
+ * @param[in] out Stream to write to.
+ * @param[in] flushEachCluster Flush out after every cluster, so that a
+ *                             reader sees each as soon as it is found,
+ *                             rather than only when the buffer fills.
+ *
+ * @return false if the buffer could not be allocated.
+ **********************************************************************/
+bool clusterWriterOpen(struct clusterWriter &writer,
+                        const std::vector<std::string> &names,
+                        enum clusterFormat format, FILE *out,
+                        bool flushEachCluster);
+
+
+/*******************************************************************//**
+ *  Write one cluster of numMembers label indexes.  Failures are kept
+ * for clusterWriterClose() to report.
+ **********************************************************************/
+void clusterWriterAdd(struct clusterWriter &writer, const size_t *members,
+                                                    size_t numMembers);
+
+
+/*******************************************************************//**
+ *  clusterWriterAdd() as a clusterSink, with the writer as context.
+ **********************************************************************/
+void clusterWriterSink(const size_t *members, size_t numMembers,
+                                                          void *writer);
+
+
+/*******************************************************************//**
+ *  Write out anything still buffered and free the buffer; out is
+ * flushed but not closed.
+ *
+ * @return false if anything could not be written.
+ **********************************************************************/
+bool clusterWriterClose(struct clusterWriter &writer);
+
+
+/*******************************************************************//**
+ *  Whether stream writes to a regular file, which nothing reads until
+ * it is complete, so that flushing each cluster would only cost time.
+ **********************************************************************/
+bool streamIsRegularFile(FILE *stream);
+
+////////////////////////////////////////////////////////////////////////
+//END///////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+#endif
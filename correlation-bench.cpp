@@ -0,0 +1,529 @@
+/*******************************************************************//**
+         FILE:  correlation-bench.cpp
+
+  DESCRIPTION:  Benchmark and parity check of the blocked correlation
+                kernels against a per-pair reference
+
+         BUGS:  ---
+        NOTES:  Usage: correlation-bench [genes] [samples] [tfs] [reps]
+                       correlation-bench EXPR TFS [k]
+                Exits non-zero if any kernel, the rank transform or
+                Kendall's tau differs from its reference by more than
+                the tolerance, or if the f32 path picks a different top
+                k set of genes for any TF than the f64 path.  Some rows
+                are then given missing values to check the pairwise
+                complete paths.  The
+                second form runs only the top k check, on a real
+                expression file and TF list.  Kendall's speedup is
+                against an O(n^2) pair count.
+       AUTHOR:  Josh Marshall <jrmarsha@mtu.edu>
+      COMPANY:  Michigan technological University
+      VERSION:  See git log
+      CREATED:  See git log
+     REVISION:  See git log
+     LISCENSE:  GPLv3
+***********************************************************************/
+
+////////////////////////////////////////////////////////////////////////
+//INCLUDES//////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "correlation.hpp"
+
+////////////////////////////////////////////////////////////////////////
+//NAMESPACE USING///////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+using std::chrono::duration;
+using std::chrono::steady_clock;
+using std::numeric_limits;
+using std::vector;
+
+////////////////////////////////////////////////////////////////////////
+//PRIVATE CONSTANTS/////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+static cf64 TOLERANCE = 1e-9;
+
+/*Largest difference from the f64 result allowed of the f32 kernels.*/
+static cf64 F32_TOLERANCE = 1e-5;
+
+/*Genes kept per TF when comparing top k sets; the tf-cluster default.*/
+static csize_t DEFAULT_TOP_K = 100;
+
+////////////////////////////////////////////////////////////////////////
+//PRIVATE FUNCTION DECLARATIONS/////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************//**
+ *  Two pass Pearson correlation of a single pair, as computed per pair
+ * by the original implementation.  Samples where either value is NaN
+ * are skipped.
+ **********************************************************************/
+f64 referencePearson(cf64 *x, cf64 *y, csize_t n);
+
+
+/*******************************************************************//**
+ *  Average ranks of one row by comparison sort, as a reference for
+ * rankRows().
+ **********************************************************************/
+void referenceRanks(cf64 *x, csize_t n, f64 *ranks);
+
+
+/*******************************************************************//**
+ *  Kendall's tau-b of a single pair by comparing every pair of samples.
+ * Samples where either value is NaN are skipped.
+ **********************************************************************/
+f64 referenceKendall(cf64 *x, cf64 *y, csize_t n);
+
+
+/*******************************************************************//**
+ *  Number of genes, over all TFs, in the top k of actual but not of
+ * expected.  A gene only counts if its expected value is more than
+ * F32_TOLERANCE below the k'th highest expected value, since genes
+ * within rounding of the cut off may legitimately trade places.
+ **********************************************************************/
+template <typename T> size_t topKMismatches(
+              const AlignedMatrix<f64> &expected,
+              const AlignedMatrix<T> &actual, csize_t numRows,
+                                          csize_t numCols, csize_t k);
+
+
+/*******************************************************************//**
+ *  Compare the top k genes of every TF between the f64 and f32 paths
+ * for one correlation method on real data.  Returns the mismatches, or
+ * SIZE_MAX if either matrix could not be built.
+ **********************************************************************/
+size_t compareFileTopK(cs8 *exprFile, cs8 *tfFile, cs8 *corrMethod,
+                                                            csize_t k);
+
+////////////////////////////////////////////////////////////////////////
+//FUNCTION DEFINITIONS//////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+f64 referencePearson(cf64 *x, cf64 *y, csize_t n){
+  f64 meanX = 0, meanY = 0, sxy = 0, sxx = 0, syy = 0;
+  size_t count = 0;
+
+  for(size_t i = 0; i < n; i++){
+    if(x[i] != x[i] || y[i] != y[i]) continue;
+    meanX += x[i];
+    meanY += y[i];
+    count++;
+  }
+  if(2 > count) return 0;
+  meanX /= (f64) count;
+  meanY /= (f64) count;
+
+  for(size_t i = 0; i < n; i++){
+    if(x[i] != x[i] || y[i] != y[i]) continue;
+    cf64 dx = x[i] - meanX;
+    cf64 dy = y[i] - meanY;
+    sxy += dx * dy;
+    sxx += dx * dx;
+    syy += dy * dy;
+  }
+
+  return 0 < sxx * syy ? sxy / sqrt(sxx * syy) : 0;
+}
+
+
+void referenceRanks(cf64 *x, csize_t n, f64 *ranks){
+  vector<size_t> order(n);
+
+  for(size_t i = 0; i < n; i++)
+    order[i] = i;
+  std::sort(order.begin(), order.end(),
+                        [x](size_t a, size_t b){ return x[a] < x[b]; });
+
+  for(size_t i = 0; i < n;){
+    size_t j = i;
+    while(j + 1 < n && x[order[j + 1]] == x[order[i]]) j++;
+    for(size_t k = i; k <= j; k++)
+      ranks[order[k]] = (f64) (i + j) / 2.0 + 1.0;
+    i = j + 1;
+  }
+}
+
+
+f64 referenceKendall(cf64 *x, cf64 *y, csize_t n){
+  f64 concordant = 0, discordant = 0, tiedX = 0, tiedY = 0;
+
+  for(size_t i = 0; i < n; i++){
+    if(x[i] != x[i] || y[i] != y[i]) continue;
+    for(size_t j = i + 1; j < n; j++){
+      if(x[j] != x[j] || y[j] != y[j]) continue;
+      cf64 dx = x[i] - x[j], dy = y[i] - y[j];
+      if(0 == dx && 0 == dy) continue;
+      if(0 == dx)      tiedX++;
+      else if(0 == dy) tiedY++;
+      else if(0 < dx * dy) concordant++;
+      else discordant++;
+    }
+  }
+
+  cf64 denominator = sqrt((concordant + discordant + tiedX) *
+                                  (concordant + discordant + tiedY));
+  return 0 < denominator ? (concordant - discordant) / denominator : 0;
+}
+
+
+template <typename T> size_t topKMismatches(
+              const AlignedMatrix<f64> &expected,
+              const AlignedMatrix<T> &actual, csize_t numRows,
+                                          csize_t numCols, csize_t k){
+  vector<size_t> expectedOrder(numCols), actualOrder(numCols);
+  vector<bool> inExpected(numCols);
+  size_t tr = 0;
+
+  csize_t keep = k < numCols ? k : numCols;
+  if(0 == keep) return 0;
+
+  for(size_t i = 0; i < numRows; i++){
+    cf64 *e = expected.row(i);
+    const T *a = actual.row(i);
+
+    for(size_t j = 0; j < numCols; j++)
+      expectedOrder[j] = actualOrder[j] = j;
+    std::partial_sort(expectedOrder.begin(), expectedOrder.begin() + keep,
+        expectedOrder.end(), [e](size_t x, size_t y){ return e[x] > e[y]; });
+    std::partial_sort(actualOrder.begin(), actualOrder.begin() + keep,
+        actualOrder.end(), [a](size_t x, size_t y){ return a[x] > a[y]; });
+
+    std::fill(inExpected.begin(), inExpected.end(), false);
+    for(size_t j = 0; j < keep; j++)
+      inExpected[expectedOrder[j]] = true;
+
+    cf64 cutOff = e[expectedOrder[keep - 1]];
+    for(size_t j = 0; j < keep; j++){
+      csize_t gene = actualOrder[j];
+      if(!inExpected[gene] && e[gene] < cutOff - F32_TOLERANCE) tr++;
+    }
+  }
+
+  return tr;
+}
+
+
+size_t compareFileTopK(cs8 *exprFile, cs8 *tfFile, cs8 *corrMethod,
+                                                            csize_t k){
+  correlationTable<f64> expected;
+  correlationTable<f32> actual;
+  const struct geneFilter keepAll = {0.0, -HUGE_VAL, 0};
+  size_t tr = SIZE_MAX;
+
+  expected = generateCorrelationMatrixFromFile<f64>(exprFile, tfFile,
+                                                  corrMethod, keepAll);
+  actual = generateCorrelationMatrixFromFile<f32>(exprFile, tfFile,
+                                                  corrMethod, keepAll);
+
+  if(!expected.fullMatrix.empty() && !actual.fullMatrix.empty())
+    tr = topKMismatches(expected.fullMatrix, actual.fullMatrix,
+                            expected.numRows(), expected.numCols(), k);
+
+  freeCorrelationTable(expected);
+  freeCorrelationTable(actual);
+
+  return tr;
+}
+
+
+int main(int argc, char **argv){
+  //A non-numeric first argument selects the reference dataset check
+  if(1 < argc && !isdigit((unsigned char) argv[1][0])){
+    cs8 *methods[] = {"pearson", "spearman"};
+    int status = 0;
+
+    if(3 > argc){
+      fprintf(stderr, "usage: %s EXPR TFS [k]\n", argv[0]);
+      return EINVAL;
+    }
+    csize_t k = 3 < argc ? strtoul(argv[3], NULL, 10) : DEFAULT_TOP_K;
+
+    for(size_t m = 0; m < sizeof(methods) / sizeof(*methods); m++){
+      csize_t mismatches = compareFileTopK(argv[1], argv[2], methods[m],
+                                                                      k);
+      if(SIZE_MAX == mismatches) return EIO;
+      printf("%-10s top %zu f32 vs f64 mismatches %zu%s\n", methods[m],
+                      k, mismatches, mismatches ? "  FAIL" : "");
+      if(mismatches) status = 1;
+    }
+
+    return status;
+  }
+
+  csize_t numGenes   = 1 < argc ? strtoul(argv[1], NULL, 10) : 4000;
+  csize_t numSamples = 2 < argc ? strtoul(argv[2], NULL, 10) : 500;
+  csize_t numTFs     = 3 < argc ? strtoul(argv[3], NULL, 10) : 400;
+  csize_t reps       = 4 < argc ? strtoul(argv[4], NULL, 10) : 3;
+  cs8 *levelNames[] = {"scalar", "avx2", "avx512"};
+
+  std::mt19937_64 generator(42);
+  std::normal_distribution<f64> noise(0.0, 1.0);
+
+  if(numTFs > numGenes || 2 > numSamples || 0 == reps){
+    fprintf(stderr, "usage: %s [genes] [samples] [tfs] [reps]\n",
+                                                              argv[0]);
+    return EINVAL;
+  }
+
+  csize_t stride = ((numSamples + 7) / 8) * 8;
+  f64 *raw, *geneRows, *tfRows;
+  if(posix_memalign((void**) &geneRows, 64,
+                          sizeof(*geneRows) * numGenes * stride) ||
+     posix_memalign((void**) &tfRows, 64,
+                          sizeof(*tfRows) * numTFs * stride))
+    return ENOMEM;
+  raw = (f64*) malloc(sizeof(*raw) * numGenes * numSamples);
+  memset(geneRows, 0, sizeof(*geneRows) * numGenes * stride);
+
+  //Correlated in blocks of 16 so that the values are not all near 0
+  for(size_t i = 0; i < numGenes; i++)
+    for(size_t k = 0; k < numSamples; k++)
+      raw[i * numSamples + k] = (i % 16 ? raw[(i - i % 16) * numSamples + k]
+                                                      : 0) + noise(generator);
+
+  //Rounded copies give the ranking stage ties to average
+  for(size_t i = 0; i < numGenes; i++)
+    for(size_t k = 0; k < numSamples; k++)
+      geneRows[i * stride + k] = round(raw[i * numSamples + k] * 8.0);
+
+  vector<f64> expectedRanks(numSamples);
+  f64 rankTime = HUGE_VAL, rankDiff = 0;
+  for(size_t r = 0; r < reps; r++){
+    for(size_t i = 0; i < numGenes; i++)
+      for(size_t k = 0; k < numSamples; k++)
+        geneRows[i * stride + k] = round(raw[i * numSamples + k] * 8.0);
+    steady_clock::time_point rankStart = steady_clock::now();
+    rankRows(geneRows, numGenes, numSamples, stride);
+    cf64 elapsed = duration<f64>(steady_clock::now() - rankStart).count();
+    if(elapsed < rankTime) rankTime = elapsed;
+  }
+  for(size_t i = 0; i < numGenes; i++){
+    vector<f64> rounded(numSamples);
+    for(size_t k = 0; k < numSamples; k++)
+      rounded[k] = round(raw[i * numSamples + k] * 8.0);
+    referenceRanks(rounded.data(), numSamples, expectedRanks.data());
+    for(size_t k = 0; k < numSamples; k++)
+      rankDiff = fmax(rankDiff,
+                      fabs(expectedRanks[k] - geneRows[i * stride + k]));
+  }
+
+  //Kendall is run on the same rounded values, so ties are exercised
+  csize_t kendallTFs = numTFs < 4 ? numTFs : 4;
+  f64 kendallTime = HUGE_VAL, kendallDiff = 0, kendallReferenceTime;
+  AlignedMatrix<f64> kendallResult(numTFs, numGenes);
+  for(size_t i = 0; i < numGenes; i++)
+    for(size_t k = 0; k < numSamples; k++)
+      geneRows[i * stride + k] = round(raw[i * numSamples + k] * 8.0);
+  for(size_t r = 0; r < reps; r++){
+    steady_clock::time_point kendallStart = steady_clock::now();
+    kendallCorrelation(geneRows, numTFs, geneRows, numGenes, numSamples,
+                                                stride, kendallResult);
+    cf64 elapsed =
+              duration<f64>(steady_clock::now() - kendallStart).count();
+    if(elapsed < kendallTime) kendallTime = elapsed;
+  }
+  steady_clock::time_point kendallStart = steady_clock::now();
+  for(size_t i = 0; i < kendallTFs; i++)
+    for(size_t j = 0; j < numGenes; j++)
+      kendallDiff = fmax(kendallDiff, fabs(kendallResult(i, j) -
+              referenceKendall(&geneRows[i * stride],
+                                  &geneRows[j * stride], numSamples)));
+  //Reference is only run on a few TFs; scale its time up to all of them
+  kendallReferenceTime = duration<f64>(steady_clock::now() -
+            kendallStart).count() * (f64) numTFs / (f64) kendallTFs;
+
+  for(size_t i = 0; i < numGenes; i++)
+    memcpy(&geneRows[i * stride], &raw[i * numSamples],
+                                        sizeof(*raw) * numSamples);
+  standardizeRows(geneRows, numGenes, numSamples, stride);
+  memcpy(tfRows, geneRows, sizeof(*tfRows) * numTFs * stride);
+
+  AlignedMatrix<f64> expected(numTFs, numGenes);
+  AlignedMatrix<f64> actual(numTFs, numGenes);
+
+  steady_clock::time_point start = steady_clock::now();
+  for(size_t i = 0; i < numTFs; i++)
+    for(size_t j = 0; j < numGenes; j++)
+      expected(i, j) = referencePearson(&raw[i * numSamples],
+                                      &raw[j * numSamples], numSamples);
+  cf64 referenceTime =
+            duration<f64>(steady_clock::now() - start).count();
+
+  printf("genes %zu  samples %zu  tfs %zu  reps %zu\n", numGenes,
+                                            numSamples, numTFs, reps);
+  printf("%-10s %12s %12s %10s %12s\n", "kernel", "best (s)",
+                                  "GFLOP/s", "speedup", "max |diff|");
+  printf("%-10s %12.6f %12s %10s %12s\n", "reference", referenceTime,
+                                                    "-", "1.00", "-");
+
+  printf("%-10s %12.6f %12s %10s %12.3e%s\n", "rank", rankTime, "-",
+                "-", rankDiff, rankDiff > TOLERANCE ? "  FAIL" : "");
+
+  printf("%-10s %12.6f %12s %10.2f %12.3e%s\n", "kendall", kendallTime,
+            "-", kendallReferenceTime / kendallTime, kendallDiff,
+                              kendallDiff > TOLERANCE ? "  FAIL" : "");
+
+  cf64 flops = 2.0 * (f64) numTFs * (f64) numGenes * (f64) numSamples;
+  const enum simdLevel detected = detectSimdLevel();
+  int status = rankDiff > TOLERANCE || kendallDiff > TOLERANCE ? 1 : 0;
+
+  for(int level = SIMD_SCALAR; level <= (int) detected; level++){
+    f64 best = HUGE_VAL, maxDiff = 0;
+
+    forceSimdLevel((enum simdLevel) level);
+    for(size_t r = 0; r < reps; r++){
+      start = steady_clock::now();
+      blockedCorrelation(tfRows, numTFs, geneRows, numGenes, stride,
+                                                                actual);
+      cf64 elapsed = duration<f64>(steady_clock::now() - start).count();
+      if(elapsed < best) best = elapsed;
+    }
+
+    for(size_t i = 0; i < numTFs; i++)
+      for(size_t j = 0; j < numGenes; j++)
+        maxDiff = fmax(maxDiff, fabs(expected(i, j) - actual(i, j)));
+
+    printf("%-10s %12.6f %12.2f %10.2f %12.3e%s\n", levelNames[level],
+              best, flops / best / 1e9, referenceTime / best, maxDiff,
+                                  maxDiff > TOLERANCE ? "  FAIL" : "");
+    if(maxDiff > TOLERANCE) status = 1;
+  }
+
+  //Single precision copies, rounded once from the raw values
+  csize_t stride32 = ((numSamples + 15) / 16) * 16;
+  f32 *geneRows32, *tfRows32;
+  if(posix_memalign((void**) &geneRows32, 64,
+                          sizeof(*geneRows32) * numGenes * stride32) ||
+     posix_memalign((void**) &tfRows32, 64,
+                          sizeof(*tfRows32) * numTFs * stride32))
+    return ENOMEM;
+  memset(geneRows32, 0, sizeof(*geneRows32) * numGenes * stride32);
+  for(size_t i = 0; i < numGenes; i++)
+    for(size_t k = 0; k < numSamples; k++)
+      geneRows32[i * stride32 + k] = (f32) raw[i * numSamples + k];
+  standardizeRows(geneRows32, numGenes, numSamples, stride32);
+  memcpy(tfRows32, geneRows32, sizeof(*tfRows32) * numTFs * stride32);
+
+  AlignedMatrix<f32> actual32(numTFs, numGenes);
+
+  for(int level = SIMD_SCALAR; level <= (int) detected; level++){
+    f64 best = HUGE_VAL, maxDiff = 0;
+    char name[16];
+
+    forceSimdLevel((enum simdLevel) level);
+    for(size_t r = 0; r < reps; r++){
+      start = steady_clock::now();
+      blockedCorrelation(tfRows32, numTFs, geneRows32, numGenes,
+                                                    stride32, actual32);
+      cf64 elapsed = duration<f64>(steady_clock::now() - start).count();
+      if(elapsed < best) best = elapsed;
+    }
+
+    for(size_t i = 0; i < numTFs; i++)
+      for(size_t j = 0; j < numGenes; j++)
+        maxDiff = fmax(maxDiff, fabs(expected(i, j) - actual32(i, j)));
+
+    snprintf(name, sizeof(name), "%s-f32", levelNames[level]);
+    printf("%-10s %12.6f %12.2f %10.2f %12.3e%s\n", name, best,
+                  flops / best / 1e9, referenceTime / best, maxDiff,
+                                maxDiff > F32_TOLERANCE ? "  FAIL" : "");
+    if(maxDiff > F32_TOLERANCE) status = 1;
+  }
+
+  csize_t mismatches = topKMismatches(expected, actual32, numTFs,
+                                                numGenes, DEFAULT_TOP_K);
+  printf("top %zu f32 vs f64 mismatches %zu%s\n", DEFAULT_TOP_K,
+                                mismatches, mismatches ? "  FAIL" : "");
+  if(mismatches) status = 1;
+
+  //Every fifth gene loses a tenth of its samples to exercise the masks
+  struct expressionData<f64> holes;
+  vector<f64> holesRaw(raw, raw + numGenes * numSamples);
+  cf64 missing = numeric_limits<f64>::quiet_NaN();
+  for(size_t i = 0; i < numGenes; i += 5)
+    for(size_t k = 0; k < numSamples; k++)
+      if(0 == (k * 7 + i) % 10) holesRaw[i * numSamples + k] = missing;
+
+  holes.numGenes = numGenes;
+  holes.numSamples = numSamples;
+  holes.stride = stride;
+  holes.ranked = false;
+  holes.validMasks = NULL;
+  holes.GeneLabels.assign(numGenes, string());
+  holes.TFLabels.assign(numTFs, string());
+  for(size_t i = 0; i < numTFs; i++)
+    holes.TFIndexes.push_back(i);
+  if(posix_memalign((void**) &holes.values, 64,
+                            sizeof(*holes.values) * numGenes * stride))
+    return ENOMEM;
+  memset(holes.values, 0, sizeof(*holes.values) * numGenes * stride);
+
+  //Kendall first, on rounded values so that ties meet missing values
+  for(size_t i = 0; i < numGenes; i++)
+    for(size_t k = 0; k < numSamples; k++)
+      holes.values[i * stride + k] = round(holesRaw[i*numSamples + k] * 8.0);
+  kendallResult.allocate(kendallTFs, numGenes);
+  start = steady_clock::now();
+  kendallCorrelation(holes.values, kendallTFs, holes.values, numGenes,
+                                numSamples, stride, kendallResult);
+  cf64 kendallHolesTime =
+            duration<f64>(steady_clock::now() - start).count();
+  f64 kendallHolesDiff = 0;
+  for(size_t i = 0; i < kendallTFs; i++)
+    for(size_t j = 0; j < numGenes; j++)
+      kendallHolesDiff = fmax(kendallHolesDiff, fabs(kendallResult(i, j) -
+              referenceKendall(&holes.values[i * stride],
+                              &holes.values[j * stride], numSamples)));
+
+  for(size_t i = 0; i < numGenes; i++)
+    memcpy(&holes.values[i * stride], &holesRaw[i * numSamples],
+                                    sizeof(*holes.values) * numSamples);
+  if(!markMissingValues(holes)) return ENOMEM;
+
+  start = steady_clock::now();
+  correlationTable<f64> holesResult = pearsonCorrelationMatrix(holes);
+  cf64 holesTime = duration<f64>(steady_clock::now() - start).count();
+
+  f64 holesDiff = 0;
+  for(size_t i = 0; i < numTFs; i++)
+    for(size_t j = 0; j < numGenes; j++)
+      holesDiff = fmax(holesDiff, fabs(holesResult.fullMatrix(i, j) -
+              referencePearson(&holesRaw[i * numSamples],
+                                  &holesRaw[j * numSamples], numSamples)));
+  freeCorrelationTable(holesResult);
+  freeExpressionData(holes);
+
+  printf("%-10s %12.6f %12s %10s %12.3e%s\n", "missing", holesTime, "-",
+                "-", holesDiff, holesDiff > TOLERANCE ? "  FAIL" : "");
+  printf("%-10s %12.6f %12s %10s %12.3e%s\n", "kendall-na",
+          kendallHolesTime, "-", "-", kendallHolesDiff,
+                          kendallHolesDiff > TOLERANCE ? "  FAIL" : "");
+  if(holesDiff > TOLERANCE || kendallHolesDiff > TOLERANCE) status = 1;
+
+  free(raw);
+  free(geneRows);
+  free(tfRows);
+  free(geneRows32);
+  free(tfRows32);
+
+  return status;
+}
+
+////////////////////////////////////////////////////////////////////////
+//END///////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,2124 @@
+/*******************************************************************//**
+         FILE:  correlation.cpp
+
+  DESCRIPTION:  Loading of expression data and blocked correlation
+                kernels used to build the TF by gene correlation matrix
+
+         BUGS:  ---
+        NOTES:  Correlations are computed as dot products of rows which
+                have been standardized once up front, which turns the
+                whole TF by gene matrix into a single matrix product.
+       AUTHOR:  Josh Marshall <jrmarsha@mtu.edu>
+      COMPANY:  Michigan technological University
+      VERSION:  See git log
+      CREATED:  See git log
+     REVISION:  See git log
+     LISCENSE:  GPLv3
+***********************************************************************/
+
+////////////////////////////////////////////////////////////////////////
+//INCLUDES//////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <strings.h>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CORRELATION_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+#include "allocation.hpp"
+#include "auxillaryUtilities.hpp"
+#include "correlation.hpp"
+#include "profile.hpp"
+#include "trace.hpp"
+
+////////////////////////////////////////////////////////////////////////
+//NAMESPACE USING///////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+using std::cerr;
+using std::sort;
+using std::endl;
+using std::ifstream;
+using std::numeric_limits;
+using std::pair;
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+////////////////////////////////////////////////////////////////////////
+//PRIVATE CONSTANTS/////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*Bytes in one cache line; rows are padded out to and aligned on it.*/
+static csize_t ROW_ALIGNMENT = 64;
+
+/*Samples per pass over a block, so a 4 row TF tile stays in L1.*/
+static csize_t SAMPLE_BLOCK = 256;
+
+/*Genes per block, so the gene block stays in L2 across all TF tiles.*/
+static csize_t GENE_BLOCK = 96;
+
+/*TFs and genes per unit of work handed out for Kendall's tau.*/
+static csize_t KENDALL_TF_BLOCK = 8;
+static csize_t KENDALL_GENE_BLOCK = 256;
+
+/*Register tile dimensions of the micro-kernels.*/
+static csize_t TILE_TFS = 4;
+static csize_t TILE_GENES = 3;
+
+////////////////////////////////////////////////////////////////////////
+//PRIVATE STRUCTS///////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+template <typename T> struct blockedCorrelationHelperStruct{
+  const T *tfRows;
+  size_t numTFs;
+  const T *geneRows;
+  size_t numGenes;
+  size_t stride;
+  AlignedMatrix<T> *result;
+  bool failed;
+};
+
+
+template <typename T> struct maskedCorrelationHelperStruct{
+  const T *tfRows;
+  const u64 *tfMasks;
+  cu8 *tfIncomplete;
+  size_t numTFs;
+  const T *geneRows;
+  const u64 *geneMasks;
+  cu8 *geneIncomplete;
+  size_t numGenes;
+  size_t numSamples;
+  size_t stride;
+  size_t maskWords;
+  u32 *tfOrder;
+  u32 *geneOrder;
+  AlignedMatrix<T> *result;
+};
+
+
+template <typename T> struct rankRowsHelperStruct{
+  T *rows;
+  size_t numRows;
+  size_t numSamples;
+  size_t stride;
+  bool failed;
+};
+
+
+template <typename T> struct kendallHelperStruct{
+  const T *tfRows;
+  size_t numTFs;
+  const T *geneRows;
+  size_t numGenes;
+  size_t numSamples;
+  size_t stride;
+  u64 *geneTies;
+  u8 *geneIncomplete;
+  AlignedMatrix<T> *result;
+};
+
+
+/*******************************************************************//**
+ *  Per thread scratch space for radixRankRow(), allocated once for all
+ * rows a thread ranks.
+ **********************************************************************/
+template <typename T> struct rankScratch{
+  u64 *keys, *keysSpare;
+  u32 *order, *orderSpare;
+  T *ranks;
+};
+
+
+/*******************************************************************//**
+ *  The micro-kernels for one value type and instruction set.  tile
+ * computes the 4x3 dot products of TF rows a .. a+3*stride against
+ * gene rows b .. b+2*stride over samples [kBegin, kEnd), storing them
+ * row major in sums.  dot is the dot product of a single pair of rows
+ * over the same samples.  moments sums x, y, x*x, y*y and x*y, in that
+ * order, over the samples set in mask.
+ **********************************************************************/
+template <typename T> struct correlationKernels{
+  void (*tile)(const T *a, const T *b, csize_t stride, csize_t kBegin,
+                                                csize_t kEnd, T *sums);
+  T (*dot)(const T *a, const T *b, csize_t kBegin, csize_t kEnd);
+  void (*moments)(const T *x, const T *y, const u64 *mask,
+                                        csize_t numSamples, f64 *sums);
+};
+
+////////////////////////////////////////////////////////////////////////
+//PRIVATE FUNCTION DECLARATIONS/////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************//**
+ *  Allocate zeroed memory aligned to a cache line.
+ **********************************************************************/
+void *alignedZeroedAlloc(csize_t size);
+
+
+/*******************************************************************//**
+ *  Parse one line of an expression file into name and values.  Returns
+ * false if the line holds something other than a name followed by
+ * numbers.
+ **********************************************************************/
+bool parseExpressionLine(const string &line, string &name,
+                                                  vector<f64> &values);
+
+
+/*******************************************************************//**
+ *  Mean and sample variance of the measured values of one row, in a
+ * single pass.  A row with fewer than two measured values has variance
+ * 0.
+ **********************************************************************/
+void rowMeanAndVariance(const vector<f64> &values, f64 &mean,
+                                                      f64 &variance);
+
+
+/*******************************************************************//**
+ *  Add value to sum, carrying the low order bits lost in compensation
+ * so they are folded back in by the next addition.
+ **********************************************************************/
+template <typename T> inline void kahanAdd(T &sum, T &compensation,
+                                                        const T value);
+
+
+/*******************************************************************//**
+ *  Map a value to an unsigned integer with the same ordering, so that
+ * values can be radix sorted on their bits.
+ **********************************************************************/
+inline u64 sortableBits(cf64 value);
+inline u64 sortableBits(cf32 value);
+
+
+/*******************************************************************//**
+ *  Rank one row in place with an LSD radix sort, giving ties the
+ * average of the ranks they span.
+ **********************************************************************/
+template <typename T> void radixRankRow(T *row, csize_t n,
+                                      struct rankScratch<T> &scratch);
+
+
+/*******************************************************************//**
+ *  A helper function to rankRows() operating on a slice of rows.
+ **********************************************************************/
+template <typename T> void *rankRowsHelper(void *arg);
+
+
+/*******************************************************************//**
+ *  Number of tied pairs, sum of t(t-1)/2 over each run of t equal
+ * values, in an already sorted array.
+ **********************************************************************/
+template <typename T> u64 countTiedPairs(const T *sorted, csize_t n);
+
+
+/*******************************************************************//**
+ *  Sort values low to high with a bottom up merge sort, returning the
+ * number of strictly inverted pairs which had to be exchanged.
+ **********************************************************************/
+template <typename T> u64 mergeSortCountingSwaps(T *values, T *space,
+                                                            csize_t n);
+
+
+/*******************************************************************//**
+ *  A helper function to kendallCorrelation() which counts the tied
+ * pairs within each gene row.
+ **********************************************************************/
+template <typename T> void *kendallTiesHelper(void *arg);
+
+
+/*******************************************************************//**
+ *  A helper function to kendallCorrelation() operating on a slice of
+ * TF by gene blocks.
+ **********************************************************************/
+template <typename T> void *kendallHelper(void *arg);
+
+
+/*******************************************************************//**
+ *  Kendall's tau-b from the pair counts of Knight's algorithm; n0 pairs
+ * in all, n1 tied in x, n2 tied in y, n3 tied in both.
+ **********************************************************************/
+inline f64 kendallTauB(cu64 n0, cu64 n1, cu64 n2, cu64 n3, cu64 swaps);
+
+
+/*******************************************************************//**
+ *  Kendall's tau-b of one pair of rows over the samples measured in
+ * both, for rows with NaNs.  pairs, ys and space are scratch.
+ **********************************************************************/
+template <typename T> f64 kendallPairwiseComplete(const T *x, const T *y,
+                    csize_t n, vector< pair<T, T> > &pairs, T *ys, T *space);
+
+
+/*******************************************************************//**
+ *  True if row holds a NaN in its first n values.
+ **********************************************************************/
+template <typename T> bool hasMissing(const T *row, csize_t n);
+
+
+/*******************************************************************//**
+ *  A helper function to maskedCorrelation() operating on a slice of
+ * TFs.
+ **********************************************************************/
+template <typename T> void *maskedCorrelationHelper(void *arg);
+
+
+/*******************************************************************//**
+ *  A helper function to maskedCorrelation() which sorts the samples of
+ * a slice of the TF and gene rows by value, so that each can be ranked
+ * over any subset of its samples without sorting again.
+ **********************************************************************/
+template <typename T> void *sampleOrderHelper(void *arg);
+
+
+/*******************************************************************//**
+ *  Rank the samples of row set in mask among themselves, ties given the
+ * average of the ranks they span, walking order, the row's samples
+ * sorted by value.  Samples not in mask are left alone in ranks.
+ **********************************************************************/
+template <typename T> void rankOverMask(const T *row, const u32 *order,
+                    const u64 *mask, csize_t numSamples, T *ranks);
+
+
+/*******************************************************************//**
+ *  Copy the TF rows of data into their own aligned buffer, so that
+ * every TF tile is one contiguous run.
+ **********************************************************************/
+template <typename T> T *gatherTFRows(
+                                  const struct expressionData<T> &data);
+
+
+/*******************************************************************//**
+ *  A helper function to blockedCorrelation() operating on a slice of
+ * TF tiles.
+ **********************************************************************/
+template <typename T> void *blockedCorrelationHelper(void *arg);
+
+
+/*******************************************************************//**
+ *  Instruction set the kernels will actually use.
+ **********************************************************************/
+enum simdLevel activeSimdLevel();
+
+
+/*******************************************************************//**
+ *  Micro-kernels for T at the active instruction set.
+ **********************************************************************/
+template <typename T> struct correlationKernels<T> selectKernels();
+
+
+template <typename T> void tileScalar(const T *a, const T *b,
+            csize_t stride, csize_t kBegin, csize_t kEnd, T *sums);
+template <typename T> T dotScalar(const T *a, const T *b,
+                                        csize_t kBegin, csize_t kEnd);
+template <typename T> void momentsScalar(const T *x, const T *y,
+                  const u64 *mask, csize_t numSamples, f64 *sums);
+
+#ifdef CORRELATION_X86_KERNELS
+void tileAVX2(cf64 *a, cf64 *b, csize_t stride, csize_t kBegin,
+                                            csize_t kEnd, f64 *sums);
+f64 dotAVX2(cf64 *a, cf64 *b, csize_t kBegin, csize_t kEnd);
+void tileAVX512(cf64 *a, cf64 *b, csize_t stride, csize_t kBegin,
+                                            csize_t kEnd, f64 *sums);
+f64 dotAVX512(cf64 *a, cf64 *b, csize_t kBegin, csize_t kEnd);
+
+void tileAVX2(cf32 *a, cf32 *b, csize_t stride, csize_t kBegin,
+                                            csize_t kEnd, f32 *sums);
+f32 dotAVX2(cf32 *a, cf32 *b, csize_t kBegin, csize_t kEnd);
+void tileAVX512(cf32 *a, cf32 *b, csize_t stride, csize_t kBegin,
+                                            csize_t kEnd, f32 *sums);
+f32 dotAVX512(cf32 *a, cf32 *b, csize_t kBegin, csize_t kEnd);
+
+void momentsAVX2(cf64 *x, cf64 *y, const u64 *mask, csize_t numSamples,
+                                                            f64 *sums);
+void momentsAVX2(cf32 *x, cf32 *y, const u64 *mask, csize_t numSamples,
+                                                            f64 *sums);
+void momentsAVX512(cf64 *x, cf64 *y, const u64 *mask,
+                                      csize_t numSamples, f64 *sums);
+void momentsAVX512(cf32 *x, cf32 *y, const u64 *mask,
+                                      csize_t numSamples, f64 *sums);
+#endif
+
+////////////////////////////////////////////////////////////////////////
+//PRIVATE GLOBALS///////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+static enum simdLevel simdCeiling = SIMD_AVX512;
+
+////////////////////////////////////////////////////////////////////////
+//FUNCTION DEFINITIONS//////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+void *alignedZeroedAlloc(csize_t size){
+  void *tr;
+
+  if(posix_memalign(&tr, ROW_ALIGNMENT, size))
+    return NULL;
+  memset(tr, 0, size);
+
+  return tr;
+}
+
+
+bool parseExpressionLine(const string &line, string &name,
+                                                  vector<f64> &values){
+  const char *cursor = line.c_str();
+  const char *nameStart;
+  char *parseEnd;
+
+  values.clear();
+
+  while(isspace(*cursor)) cursor++;
+  nameStart = cursor;
+  while(*cursor && !isspace(*cursor)) cursor++;
+  name.assign(nameStart, (size_t) (cursor - nameStart));
+
+  while(true){
+    while(isspace(*cursor)) cursor++;
+    if(!*cursor) break;
+    f64 value = strtod(cursor, &parseEnd);
+    if(parseEnd == cursor){
+      //strtod takes NaN but not R's NA
+      if(strncasecmp(cursor, "NA", 2) || (cursor[2] && !isspace(cursor[2])))
+        return false;
+      parseEnd = (char*) cursor + 2;
+      value = numeric_limits<f64>::quiet_NaN();
+    }
+    //One NaN bit pattern, so missing values always rank last
+    if(value != value) value = numeric_limits<f64>::quiet_NaN();
+    values.push_back(value);
+    cursor = parseEnd;
+  }
+
+  return true;
+}
+
+
+void rowMeanAndVariance(const vector<f64> &values, f64 &mean,
+                                                      f64 &variance){
+  f64 sumSquares = 0;
+  size_t n = 0;
+
+  mean = 0;
+  for(size_t k = 0; k < values.size(); k++){
+    if(values[k] != values[k]) continue;
+    n++;
+    cf64 delta = values[k] - mean;
+    mean += delta / (f64) n;
+    sumSquares += delta * (values[k] - mean);
+  }
+
+  variance = 1 < n ? sumSquares / (f64) (n - 1) : 0;
+}
+
+
+template <typename T> bool loadExpressionData(cs8 *exprFile,
+                cs8 *tfFile, const struct geneFilter &filter,
+                                          struct expressionData<T> &data){
+  ifstream exprStream, tfStream;
+  unordered_map<string, size_t> geneIndexes;
+  unordered_map<string, bool> listedTFs;
+  vector<string> tfNames;
+  vector<f64> parsed, rowValues, variances;
+  vector<u8> isTF;
+  string line, name;
+  size_t lineNumber, numRead, numCandidates;
+  f64 mean, variance;
+
+  data.values = NULL;
+  data.validMasks = NULL;
+  data.numGenes = data.numSamples = data.stride = data.maskWords = 0;
+  data.ranked = false;
+  data.GeneLabels.clear();
+  data.TFLabels.clear();
+  data.TFIndexes.clear();
+
+  if(NULL == exprFile || NULL == tfFile){
+    cerr << "Both an expression file and a TF list are required."
+         << endl;
+    return false;
+  }
+
+  //TFs are read first so the filter can drop genes as they are parsed
+  tfStream.open(tfFile);
+  if(!tfStream.is_open()){
+    cerr << "Could not open TF list \"" << tfFile << "\"" << endl;
+    return false;
+  }
+
+  while(getline(tfStream, line)){
+    parseExpressionLine(line, name, rowValues);
+    if(name.empty()) continue;
+    tfNames.push_back(name);
+    listedTFs.emplace(name, true);
+  }
+
+  exprStream.open(exprFile);
+  if(!exprStream.is_open()){
+    cerr << "Could not open expression file \"" << exprFile << "\""
+         << endl;
+    return false;
+  }
+
+  lineNumber = numRead = numCandidates = 0;
+  while(getline(exprStream, line)){
+    lineNumber++;
+    if(!parseExpressionLine(line, name, rowValues)){
+      cerr << exprFile << ":" << lineNumber << ": non-numeric "
+              "expression value" << endl;
+      return false;
+    }
+    if(name.empty()) continue;
+
+    if(0 == numRead){
+      data.numSamples = rowValues.size();
+    }else if(rowValues.size() != data.numSamples){
+      cerr << exprFile << ":" << lineNumber << ": expected "
+           << data.numSamples << " values but found "
+           << rowValues.size() << endl;
+      return false;
+    }
+    numRead++;
+
+    csize_t listed = listedTFs.count(name);
+    rowMeanAndVariance(rowValues, mean, variance);
+    if(!listed && (variance < filter.minVariance || mean < filter.minMean))
+      continue;
+
+    geneIndexes.emplace(name, data.numGenes);
+    data.GeneLabels.push_back(name);
+    parsed.insert(parsed.end(), rowValues.begin(), rowValues.end());
+    variances.push_back(variance);
+    isTF.push_back((u8) listed);
+    numCandidates += !listed;
+    data.numGenes++;
+  }
+
+  if(0 == data.numGenes || 2 > data.numSamples){
+    cerr << "Expression file \"" << exprFile << "\" needs at least one "
+            "gene with two or more samples" << endl;
+    return false;
+  }
+
+  //Keep the topVariable most variable genes which are not TFs
+  if(filter.topVariable && numCandidates > filter.topVariable){
+    vector<f64> candidateVariances;
+    size_t kept = 0, keptAtCutOff = 0, numKept = 0;
+
+    for(size_t i = 0; i < data.numGenes; i++)
+      if(!isTF[i]) candidateVariances.push_back(variances[i]);
+    std::nth_element(candidateVariances.begin(),
+          candidateVariances.begin() + (long) (filter.topVariable - 1),
+                      candidateVariances.end(), std::greater<f64>());
+    cf64 cutOff = candidateVariances[filter.topVariable - 1];
+    for(size_t i = 0; i < candidateVariances.size(); i++)
+      kept += candidateVariances[i] > cutOff;
+
+    //Ties at the cut off go to the genes listed first
+    geneIndexes.clear();
+    for(size_t i = 0; i < data.numGenes; i++){
+      if(!isTF[i]){
+        if(variances[i] < cutOff) continue;
+        if(variances[i] == cutOff){
+          if(kept + keptAtCutOff >= filter.topVariable) continue;
+          keptAtCutOff++;
+        }
+      }
+      if(numKept != i){
+        data.GeneLabels[numKept].swap(data.GeneLabels[i]);
+        memmove(&parsed[numKept * data.numSamples],
+                    &parsed[i * data.numSamples],
+                                  sizeof(parsed[0]) * data.numSamples);
+      }
+      geneIndexes.emplace(data.GeneLabels[numKept], numKept);
+      numKept++;
+    }
+    data.numGenes = numKept;
+    data.GeneLabels.resize(numKept);
+    parsed.resize(numKept * data.numSamples);
+  }
+
+  if(numRead != data.numGenes)
+    cerr << "Prefilter removed " << numRead - data.numGenes << " of "
+         << numRead << " genes" << endl;
+
+  for(size_t i = 0; i < tfNames.size(); i++){
+    if(!geneIndexes.count(tfNames[i])){
+      cerr << "TF \"" << tfNames[i] << "\" is not in the expression "
+              "file; skipping" << endl;
+      continue;
+    }
+    data.TFLabels.push_back(tfNames[i]);
+    data.TFIndexes.push_back(geneIndexes[tfNames[i]]);
+  }
+
+  csize_t rowAlignment = ROW_ALIGNMENT / sizeof(T);
+  data.stride = ((data.numSamples + rowAlignment - 1) / rowAlignment)
+                                                          * rowAlignment;
+  allocationCheckBudget("load",
+                      sizeof(*data.values) * data.numGenes * data.stride);
+  data.values = (T*) alignedZeroedAlloc(
+                          sizeof(*data.values) * data.numGenes * data.stride);
+  if(NULL == data.values){
+    cerr << "Could not allocate expression data" << endl;
+    return false;
+  }
+  allocationRecord(ALLOC_EXPRESSION,
+                      sizeof(*data.values) * data.numGenes * data.stride);
+
+  //Parsed at full precision and rounded once on the way in
+  for(size_t i = 0; i < data.numGenes; i++)
+    for(size_t k = 0; k < data.numSamples; k++)
+      data.values[i * data.stride + k] = (T) parsed[i*data.numSamples + k];
+
+  if(!markMissingValues(data)){
+    cerr << "Could not allocate missing value masks" << endl;
+    return false;
+  }
+
+  return true;
+}
+
+
+template <typename T> void freeExpressionData(
+                                      struct expressionData<T> &data){
+  if(NULL != data.values)
+    allocationRelease(ALLOC_EXPRESSION,
+                      sizeof(*data.values) * data.numGenes * data.stride);
+  if(NULL != data.validMasks)
+    allocationRelease(ALLOC_EXPRESSION,
+              sizeof(*data.validMasks) * data.numGenes * data.maskWords);
+  free(data.values);
+  free(data.validMasks);
+  data.values = NULL;
+  data.validMasks = NULL;
+}
+
+
+template <typename T> bool markMissingValues(
+                                      struct expressionData<T> &data){
+  bool anyMissing = false;
+
+  if(NULL != data.validMasks)
+    allocationRelease(ALLOC_EXPRESSION,
+              sizeof(*data.validMasks) * data.numGenes * data.maskWords);
+  free(data.validMasks);
+  data.validMasks = NULL;
+  data.maskWords = (data.numSamples + 63) / 64;
+
+  for(size_t i = 0; i < data.numGenes && !anyMissing; i++)
+    anyMissing = hasMissing(&data.values[i * data.stride],
+                                                      data.numSamples);
+  if(!anyMissing) return true;
+
+  data.validMasks = (u64*) alignedZeroedAlloc(
+                  sizeof(*data.validMasks) * data.numGenes * data.maskWords);
+  if(NULL == data.validMasks) return false;
+  allocationRecord(ALLOC_EXPRESSION,
+              sizeof(*data.validMasks) * data.numGenes * data.maskWords);
+
+  for(size_t i = 0; i < data.numGenes; i++){
+    const T *row = &data.values[i * data.stride];
+    u64 *mask = &data.validMasks[i * data.maskWords];
+    for(size_t k = 0; k < data.numSamples; k++)
+      if(row[k] == row[k])
+        mask[k >> 6] |= 1ULL << (k & 63);
+  }
+
+  return true;
+}
+
+
+template <typename T> bool hasMissing(const T *row, csize_t n){
+  for(size_t k = 0; k < n; k++)
+    if(row[k] != row[k]) return true;
+  return false;
+}
+
+
+template <typename T> inline void kahanAdd(T &sum, T &compensation,
+                                                        const T value){
+  const T corrected = value - compensation;
+  const T total = sum + corrected;
+  compensation = (total - sum) - corrected;
+  sum = total;
+}
+
+
+template <typename T> void standardizeRows(T *rows, csize_t numRows,
+                                  csize_t numSamples, csize_t stride){
+  for(size_t i = 0; i < numRows; i++){
+    T *row = &rows[i * stride];
+    T mean, sumSquares, compensation;
+    size_t numValid = 0;
+
+    mean = compensation = 0;
+    for(size_t k = 0; k < numSamples; k++){
+      if(row[k] != row[k]) continue;
+      kahanAdd(mean, compensation, row[k]);
+      numValid++;
+    }
+    mean /= (T) (numValid ? numValid : 1);
+
+    //Missing samples become 0, so they add nothing to any dot product
+    sumSquares = compensation = 0;
+    for(size_t k = 0; k < numSamples; k++){
+      row[k] = row[k] == row[k] ? row[k] - mean : 0;
+      kahanAdd(sumSquares, compensation, row[k] * row[k]);
+    }
+
+    const T scale = 0 < sumSquares ? (T) (1.0 / sqrt((f64) sumSquares))
+                                                                    : 0;
+    for(size_t k = 0; k < numSamples; k++)
+      row[k] *= scale;
+  }
+}
+
+
+inline u64 sortableBits(cf64 value){
+  u64 bits;
+
+  memcpy(&bits, &value, sizeof(bits));
+  //Negative values sort in reverse and below all positive values
+  return (bits >> 63) ? ~bits : bits | (1ULL << 63);
+}
+
+
+inline u64 sortableBits(cf32 value){
+  u32 bits;
+
+  memcpy(&bits, &value, sizeof(bits));
+  return (bits >> 31) ? (u32) ~bits : bits | (1U << 31);
+}
+
+
+template <typename T> void radixRankRow(T *row, csize_t n,
+                                      struct rankScratch<T> &scratch){
+  size_t counts[sizeof(T)][256];
+  u64 *keys = scratch.keys, *keysSpare = scratch.keysSpare;
+  u32 *order = scratch.order, *orderSpare = scratch.orderSpare;
+  T *ranks = scratch.ranks;
+  size_t numValid = 0;
+
+  memset(counts, 0, sizeof(counts));
+  for(size_t i = 0; i < n; i++){
+    numValid += row[i] == row[i];
+    keys[i] = sortableBits(row[i]);
+    order[i] = (u32) i;
+    for(size_t b = 0; b < sizeof(T); b++)
+      counts[b][(keys[i] >> (8 * b)) & 0xFF]++;
+  }
+
+  for(size_t b = 0; b < sizeof(T); b++){
+    csize_t shift = 8 * b;
+
+    //Bytes shared by every key, typically the exponent, need no pass
+    if(n == counts[b][(keys[0] >> shift) & 0xFF]) continue;
+
+    size_t offset = 0;
+    for(size_t d = 0; d < 256; d++){
+      csize_t count = counts[b][d];
+      counts[b][d] = offset;
+      offset += count;
+    }
+
+    for(size_t i = 0; i < n; i++){
+      csize_t target = counts[b][(keys[i] >> shift) & 0xFF]++;
+      keysSpare[target] = keys[i];
+      orderSpare[target] = order[i];
+    }
+
+    u64 *keysTmp = keys; keys = keysSpare; keysSpare = keysTmp;
+    u32 *orderTmp = order; order = orderSpare; orderSpare = orderTmp;
+  }
+
+  //NaNs all share the highest bit pattern, so they are the last keys
+  for(size_t i = 0; i < numValid;){
+    size_t j = i;
+    while(j + 1 < numValid && row[order[j + 1]] == row[order[i]]) j++;
+
+    const T averageRank = (T) ((f64) (i + j) / 2.0 + 1.0);
+    for(size_t k = i; k <= j; k++)
+      ranks[order[k]] = averageRank;
+    i = j + 1;
+  }
+  for(size_t k = numValid; k < n; k++)
+    ranks[order[k]] = row[order[k]];
+
+  memcpy(row, ranks, sizeof(*row) * n);
+}
+
+
+template <typename T> void *rankRowsHelper(void *arg){
+  TRACE_SCOPE("rankRowsHelper");
+  struct multithreadLoad *argPrime = (struct multithreadLoad*) arg;
+  csize_t numerator = argPrime->numerator;
+  csize_t denominator = argPrime->denominator;
+
+  struct rankRowsHelperStruct<T> *args =
+                  (struct rankRowsHelperStruct<T>*) argPrime->specifics;
+  T *rows = args->rows;
+  csize_t numRows = args->numRows;
+  csize_t numSamples = args->numSamples;
+  csize_t stride = args->stride;
+
+  struct rankScratch<T> scratch;
+  void *tmpPtr;
+
+  tmpPtr = malloc(2 * (sizeof(*scratch.keys) + sizeof(*scratch.order))
+                        * numSamples + sizeof(*scratch.ranks) * numSamples);
+  if(NULL == tmpPtr){
+    args->failed = true;
+    return NULL;
+  }
+  scratch.keys = (u64*) tmpPtr;
+  scratch.keysSpare = scratch.keys + numSamples;
+  scratch.order = (u32*) (scratch.keysSpare + numSamples);
+  scratch.orderSpare = scratch.order + numSamples;
+  scratch.ranks = (T*) (scratch.orderSpare + numSamples);
+
+  for(size_t i = (numerator * numRows) / denominator;
+                    i < ((numerator + 1) * numRows) / denominator; i++)
+    radixRankRow(&rows[i * stride], numSamples, scratch);
+
+  free(tmpPtr);
+
+  return NULL;
+}
+
+
+template <typename T> bool rankRows(T *rows, csize_t numRows,
+                                  csize_t numSamples, csize_t stride){
+  struct rankRowsHelperStruct<T> instructions;
+
+  instructions = {
+      rows,
+      numRows,
+      numSamples,
+      stride,
+      false
+    };
+
+  autoThreadLauncher(rankRowsHelper<T>, (void*) &instructions);
+
+  return !instructions.failed;
+}
+
+
+template <typename T> void tileScalar(const T *a, const T *b,
+            csize_t stride, csize_t kBegin, csize_t kEnd, T *sums){
+  T acc[TILE_TFS * TILE_GENES];
+
+  memset(acc, 0, sizeof(acc));
+  for(size_t k = kBegin; k < kEnd; k++)
+    for(size_t i = 0; i < TILE_TFS; i++)
+      for(size_t j = 0; j < TILE_GENES; j++)
+        acc[i * TILE_GENES + j] += a[i * stride + k] * b[j * stride + k];
+
+  memcpy(sums, acc, sizeof(acc));
+}
+
+
+template <typename T> T dotScalar(const T *a, const T *b,
+                                        csize_t kBegin, csize_t kEnd){
+  T tr = 0;
+  for(size_t k = kBegin; k < kEnd; k++)
+    tr += a[k] * b[k];
+  return tr;
+}
+
+
+template <typename T> void momentsScalar(const T *x, const T *y,
+                  const u64 *mask, csize_t numSamples, f64 *sums){
+  f64 sx = 0, sy = 0, sxx = 0, syy = 0, sxy = 0;
+
+  for(size_t k = 0; k < numSamples; k++){
+    if(!((mask[k >> 6] >> (k & 63)) & 1)) continue;
+    cf64 xk = x[k], yk = y[k];
+    sx += xk;
+    sy += yk;
+    sxx += xk * xk;
+    syy += yk * yk;
+    sxy += xk * yk;
+  }
+
+  sums[0] = sx; sums[1] = sy; sums[2] = sxx; sums[3] = syy; sums[4] = sxy;
+}
+
+
+#ifdef CORRELATION_X86_KERNELS
+
+__attribute__((target("avx2,fma")))
+static inline f64 horizontalSumAVX2(__m256d v){
+  __m128d low = _mm256_castpd256_pd128(v);
+  __m128d high = _mm256_extractf128_pd(v, 1);
+  low = _mm_add_pd(low, high);
+  high = _mm_unpackhi_pd(low, low);
+  return _mm_cvtsd_f64(_mm_add_sd(low, high));
+}
+
+
+__attribute__((target("avx2,fma")))
+static inline f32 horizontalSumAVX2(__m256 v){
+  __m128 low = _mm256_castps256_ps128(v);
+  __m128 high = _mm256_extractf128_ps(v, 1);
+  low = _mm_add_ps(low, high);
+  low = _mm_add_ps(low, _mm_movehl_ps(low, low));
+  low = _mm_add_ss(low, _mm_shuffle_ps(low, low, 1));
+  return _mm_cvtss_f32(low);
+}
+
+
+__attribute__((target("avx2,fma")))
+void tileAVX2(cf64 *a, cf64 *b, csize_t stride, csize_t kBegin,
+                                            csize_t kEnd, f64 *sums){
+  cf64 *a0 = a, *a1 = a + stride, *a2 = a + 2*stride, *a3 = a + 3*stride;
+  cf64 *b0 = b, *b1 = b + stride, *b2 = b + 2*stride;
+  __m256d c00, c01, c02, c10, c11, c12, c20, c21, c22, c30, c31, c32;
+
+  c00 = c01 = c02 = c10 = c11 = c12 = _mm256_setzero_pd();
+  c20 = c21 = c22 = c30 = c31 = c32 = _mm256_setzero_pd();
+
+  for(size_t k = kBegin; k < kEnd; k += 4){
+    const __m256d v0 = _mm256_load_pd(&b0[k]);
+    const __m256d v1 = _mm256_load_pd(&b1[k]);
+    const __m256d v2 = _mm256_load_pd(&b2[k]);
+    __m256d u;
+
+    u = _mm256_load_pd(&a0[k]);
+    c00 = _mm256_fmadd_pd(u, v0, c00);
+    c01 = _mm256_fmadd_pd(u, v1, c01);
+    c02 = _mm256_fmadd_pd(u, v2, c02);
+    u = _mm256_load_pd(&a1[k]);
+    c10 = _mm256_fmadd_pd(u, v0, c10);
+    c11 = _mm256_fmadd_pd(u, v1, c11);
+    c12 = _mm256_fmadd_pd(u, v2, c12);
+    u = _mm256_load_pd(&a2[k]);
+    c20 = _mm256_fmadd_pd(u, v0, c20);
+    c21 = _mm256_fmadd_pd(u, v1, c21);
+    c22 = _mm256_fmadd_pd(u, v2, c22);
+    u = _mm256_load_pd(&a3[k]);
+    c30 = _mm256_fmadd_pd(u, v0, c30);
+    c31 = _mm256_fmadd_pd(u, v1, c31);
+    c32 = _mm256_fmadd_pd(u, v2, c32);
+  }
+
+  sums[0]  = horizontalSumAVX2(c00);
+  sums[1]  = horizontalSumAVX2(c01);
+  sums[2]  = horizontalSumAVX2(c02);
+  sums[3]  = horizontalSumAVX2(c10);
+  sums[4]  = horizontalSumAVX2(c11);
+  sums[5]  = horizontalSumAVX2(c12);
+  sums[6]  = horizontalSumAVX2(c20);
+  sums[7]  = horizontalSumAVX2(c21);
+  sums[8]  = horizontalSumAVX2(c22);
+  sums[9]  = horizontalSumAVX2(c30);
+  sums[10] = horizontalSumAVX2(c31);
+  sums[11] = horizontalSumAVX2(c32);
+}
+
+
+__attribute__((target("avx2,fma")))
+f64 dotAVX2(cf64 *a, cf64 *b, csize_t kBegin, csize_t kEnd){
+  __m256d acc = _mm256_setzero_pd();
+  for(size_t k = kBegin; k < kEnd; k += 4)
+    acc = _mm256_fmadd_pd(_mm256_load_pd(&a[k]), _mm256_load_pd(&b[k]),
+                                                                  acc);
+  return horizontalSumAVX2(acc);
+}
+
+
+__attribute__((target("avx2,fma")))
+void tileAVX2(cf32 *a, cf32 *b, csize_t stride, csize_t kBegin,
+                                            csize_t kEnd, f32 *sums){
+  cf32 *a0 = a, *a1 = a + stride, *a2 = a + 2*stride, *a3 = a + 3*stride;
+  cf32 *b0 = b, *b1 = b + stride, *b2 = b + 2*stride;
+  __m256 c00, c01, c02, c10, c11, c12, c20, c21, c22, c30, c31, c32;
+
+  c00 = c01 = c02 = c10 = c11 = c12 = _mm256_setzero_ps();
+  c20 = c21 = c22 = c30 = c31 = c32 = _mm256_setzero_ps();
+
+  for(size_t k = kBegin; k < kEnd; k += 8){
+    const __m256 v0 = _mm256_load_ps(&b0[k]);
+    const __m256 v1 = _mm256_load_ps(&b1[k]);
+    const __m256 v2 = _mm256_load_ps(&b2[k]);
+    __m256 u;
+
+    u = _mm256_load_ps(&a0[k]);
+    c00 = _mm256_fmadd_ps(u, v0, c00);
+    c01 = _mm256_fmadd_ps(u, v1, c01);
+    c02 = _mm256_fmadd_ps(u, v2, c02);
+    u = _mm256_load_ps(&a1[k]);
+    c10 = _mm256_fmadd_ps(u, v0, c10);
+    c11 = _mm256_fmadd_ps(u, v1, c11);
+    c12 = _mm256_fmadd_ps(u, v2, c12);
+    u = _mm256_load_ps(&a2[k]);
+    c20 = _mm256_fmadd_ps(u, v0, c20);
+    c21 = _mm256_fmadd_ps(u, v1, c21);
+    c22 = _mm256_fmadd_ps(u, v2, c22);
+    u = _mm256_load_ps(&a3[k]);
+    c30 = _mm256_fmadd_ps(u, v0, c30);
+    c31 = _mm256_fmadd_ps(u, v1, c31);
+    c32 = _mm256_fmadd_ps(u, v2, c32);
+  }
+
+  sums[0]  = horizontalSumAVX2(c00);
+  sums[1]  = horizontalSumAVX2(c01);
+  sums[2]  = horizontalSumAVX2(c02);
+  sums[3]  = horizontalSumAVX2(c10);
+  sums[4]  = horizontalSumAVX2(c11);
+  sums[5]  = horizontalSumAVX2(c12);
+  sums[6]  = horizontalSumAVX2(c20);
+  sums[7]  = horizontalSumAVX2(c21);
+  sums[8]  = horizontalSumAVX2(c22);
+  sums[9]  = horizontalSumAVX2(c30);
+  sums[10] = horizontalSumAVX2(c31);
+  sums[11] = horizontalSumAVX2(c32);
+}
+
+
+__attribute__((target("avx2,fma")))
+f32 dotAVX2(cf32 *a, cf32 *b, csize_t kBegin, csize_t kEnd){
+  __m256 acc = _mm256_setzero_ps();
+  for(size_t k = kBegin; k < kEnd; k += 8)
+    acc = _mm256_fmadd_ps(_mm256_load_ps(&a[k]), _mm256_load_ps(&b[k]),
+                                                                  acc);
+  return horizontalSumAVX2(acc);
+}
+
+
+//Halves are split off with masked extracts, as the unmasked ones and
+//_mm512_reduce_add_* fill an undefined register GCC warns about; the
+//adds are in the same order as _mm512_reduce_add_*
+__attribute__((target("avx512f")))
+static inline f64 horizontalSumAVX512(__m512d v){
+  __m256d half = _mm256_add_pd(_mm512_maskz_extractf64x4_pd(0xF, v, 0),
+                                _mm512_maskz_extractf64x4_pd(0xF, v, 1));
+  __m128d low = _mm256_castpd256_pd128(half);
+  __m128d high = _mm256_extractf128_pd(half, 1);
+  low = _mm_add_pd(low, high);
+  high = _mm_unpackhi_pd(low, low);
+  return _mm_cvtsd_f64(_mm_add_sd(low, high));
+}
+
+
+__attribute__((target("avx512f")))
+static inline f32 horizontalSumAVX512(__m512 v){
+  const __m512d bits = _mm512_castps_pd(v);
+  __m256 half = _mm256_add_ps(
+            _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, bits, 0)),
+            _mm256_castpd_ps(_mm512_maskz_extractf64x4_pd(0xF, bits, 1)));
+  __m128 low = _mm256_castps256_ps128(half);
+  __m128 high = _mm256_extractf128_ps(half, 1);
+  low = _mm_add_ps(low, high);
+  low = _mm_add_ps(low, _mm_movehl_ps(low, low));
+  low = _mm_add_ss(low, _mm_shuffle_ps(low, low, 1));
+  return _mm_cvtss_f32(low);
+}
+
+
+__attribute__((target("avx512f")))
+void tileAVX512(cf64 *a, cf64 *b, csize_t stride, csize_t kBegin,
+                                            csize_t kEnd, f64 *sums){
+  cf64 *a0 = a, *a1 = a + stride, *a2 = a + 2*stride, *a3 = a + 3*stride;
+  cf64 *b0 = b, *b1 = b + stride, *b2 = b + 2*stride;
+  __m512d c00, c01, c02, c10, c11, c12, c20, c21, c22, c30, c31, c32;
+
+  c00 = c01 = c02 = c10 = c11 = c12 = _mm512_setzero_pd();
+  c20 = c21 = c22 = c30 = c31 = c32 = _mm512_setzero_pd();
+
+  for(size_t k = kBegin; k < kEnd; k += 8){
+    const __m512d v0 = _mm512_load_pd(&b0[k]);
+    const __m512d v1 = _mm512_load_pd(&b1[k]);
+    const __m512d v2 = _mm512_load_pd(&b2[k]);
+    __m512d u;
+
+    u = _mm512_load_pd(&a0[k]);
+    c00 = _mm512_fmadd_pd(u, v0, c00);
+    c01 = _mm512_fmadd_pd(u, v1, c01);
+    c02 = _mm512_fmadd_pd(u, v2, c02);
+    u = _mm512_load_pd(&a1[k]);
+    c10 = _mm512_fmadd_pd(u, v0, c10);
+    c11 = _mm512_fmadd_pd(u, v1, c11);
+    c12 = _mm512_fmadd_pd(u, v2, c12);
+    u = _mm512_load_pd(&a2[k]);
+    c20 = _mm512_fmadd_pd(u, v0, c20);
+    c21 = _mm512_fmadd_pd(u, v1, c21);
+    c22 = _mm512_fmadd_pd(u, v2, c22);
+    u = _mm512_load_pd(&a3[k]);
+    c30 = _mm512_fmadd_pd(u, v0, c30);
+    c31 = _mm512_fmadd_pd(u, v1, c31);
+    c32 = _mm512_fmadd_pd(u, v2, c32);
+  }
+
+  sums[0]  = horizontalSumAVX512(c00);
+  sums[1]  = horizontalSumAVX512(c01);
+  sums[2]  = horizontalSumAVX512(c02);
+  sums[3]  = horizontalSumAVX512(c10);
+  sums[4]  = horizontalSumAVX512(c11);
+  sums[5]  = horizontalSumAVX512(c12);
+  sums[6]  = horizontalSumAVX512(c20);
+  sums[7]  = horizontalSumAVX512(c21);
+  sums[8]  = horizontalSumAVX512(c22);
+  sums[9]  = horizontalSumAVX512(c30);
+  sums[10] = horizontalSumAVX512(c31);
+  sums[11] = horizontalSumAVX512(c32);
+}
+
+
+__attribute__((target("avx512f")))
+f64 dotAVX512(cf64 *a, cf64 *b, csize_t kBegin, csize_t kEnd){
+  __m512d acc = _mm512_setzero_pd();
+  for(size_t k = kBegin; k < kEnd; k += 8)
+    acc = _mm512_fmadd_pd(_mm512_load_pd(&a[k]), _mm512_load_pd(&b[k]),
+                                                                  acc);
+  return horizontalSumAVX512(acc);
+}
+
+
+__attribute__((target("avx512f")))
+void tileAVX512(cf32 *a, cf32 *b, csize_t stride, csize_t kBegin,
+                                            csize_t kEnd, f32 *sums){
+  cf32 *a0 = a, *a1 = a + stride, *a2 = a + 2*stride, *a3 = a + 3*stride;
+  cf32 *b0 = b, *b1 = b + stride, *b2 = b + 2*stride;
+  __m512 c00, c01, c02, c10, c11, c12, c20, c21, c22, c30, c31, c32;
+
+  c00 = c01 = c02 = c10 = c11 = c12 = _mm512_setzero_ps();
+  c20 = c21 = c22 = c30 = c31 = c32 = _mm512_setzero_ps();
+
+  for(size_t k = kBegin; k < kEnd; k += 16){
+    const __m512 v0 = _mm512_load_ps(&b0[k]);
+    const __m512 v1 = _mm512_load_ps(&b1[k]);
+    const __m512 v2 = _mm512_load_ps(&b2[k]);
+    __m512 u;
+
+    u = _mm512_load_ps(&a0[k]);
+    c00 = _mm512_fmadd_ps(u, v0, c00);
+    c01 = _mm512_fmadd_ps(u, v1, c01);
+    c02 = _mm512_fmadd_ps(u, v2, c02);
+    u = _mm512_load_ps(&a1[k]);
+    c10 = _mm512_fmadd_ps(u, v0, c10);
+    c11 = _mm512_fmadd_ps(u, v1, c11);
+    c12 = _mm512_fmadd_ps(u, v2, c12);
+    u = _mm512_load_ps(&a2[k]);
+    c20 = _mm512_fmadd_ps(u, v0, c20);
+    c21 = _mm512_fmadd_ps(u, v1, c21);
+    c22 = _mm512_fmadd_ps(u, v2, c22);
+    u = _mm512_load_ps(&a3[k]);
+    c30 = _mm512_fmadd_ps(u, v0, c30);
+    c31 = _mm512_fmadd_ps(u, v1, c31);
+    c32 = _mm512_fmadd_ps(u, v2, c32);
+  }
+
+  sums[0]  = horizontalSumAVX512(c00);
+  sums[1]  = horizontalSumAVX512(c01);
+  sums[2]  = horizontalSumAVX512(c02);
+  sums[3]  = horizontalSumAVX512(c10);
+  sums[4]  = horizontalSumAVX512(c11);
+  sums[5]  = horizontalSumAVX512(c12);
+  sums[6]  = horizontalSumAVX512(c20);
+  sums[7]  = horizontalSumAVX512(c21);
+  sums[8]  = horizontalSumAVX512(c22);
+  sums[9]  = horizontalSumAVX512(c30);
+  sums[10] = horizontalSumAVX512(c31);
+  sums[11] = horizontalSumAVX512(c32);
+}
+
+
+__attribute__((target("avx512f")))
+f32 dotAVX512(cf32 *a, cf32 *b, csize_t kBegin, csize_t kEnd){
+  __m512 acc = _mm512_setzero_ps();
+  for(size_t k = kBegin; k < kEnd; k += 16)
+    acc = _mm512_fmadd_ps(_mm512_load_ps(&a[k]), _mm512_load_ps(&b[k]),
+                                                                  acc);
+  return horizontalSumAVX512(acc);
+}
+
+
+/*Lane k of a masked load keeps its value if bit k of the mask is set.*/
+
+__attribute__((target("avx2,fma")))
+void momentsAVX2(cf64 *x, cf64 *y, const u64 *mask, csize_t numSamples,
+                                                            f64 *sums){
+  const __m256i laneBits = _mm256_setr_epi64x(1, 2, 4, 8);
+  __m256d sx, sy, sxx, syy, sxy;
+
+  sx = sy = sxx = syy = sxy = _mm256_setzero_pd();
+  for(size_t k = 0; k < numSamples; k += 4){
+    cu64 bits = (mask[k >> 6] >> (k & 63)) & 0xF;
+    if(!bits) continue;
+    const __m256d keep = _mm256_castsi256_pd(_mm256_cmpeq_epi64(
+          _mm256_and_si256(_mm256_set1_epi64x((long long) bits), laneBits),
+                                                            laneBits));
+    const __m256d u = _mm256_and_pd(_mm256_load_pd(&x[k]), keep);
+    const __m256d v = _mm256_and_pd(_mm256_load_pd(&y[k]), keep);
+    sx = _mm256_add_pd(sx, u);
+    sy = _mm256_add_pd(sy, v);
+    sxx = _mm256_fmadd_pd(u, u, sxx);
+    syy = _mm256_fmadd_pd(v, v, syy);
+    sxy = _mm256_fmadd_pd(u, v, sxy);
+  }
+
+  sums[0] = horizontalSumAVX2(sx);
+  sums[1] = horizontalSumAVX2(sy);
+  sums[2] = horizontalSumAVX2(sxx);
+  sums[3] = horizontalSumAVX2(syy);
+  sums[4] = horizontalSumAVX2(sxy);
+}
+
+
+__attribute__((target("avx2,fma")))
+void momentsAVX2(cf32 *x, cf32 *y, const u64 *mask, csize_t numSamples,
+                                                            f64 *sums){
+  const __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+  __m256 sx, sy, sxx, syy, sxy;
+
+  sx = sy = sxx = syy = sxy = _mm256_setzero_ps();
+  for(size_t k = 0; k < numSamples; k += 8){
+    cu64 bits = (mask[k >> 6] >> (k & 63)) & 0xFF;
+    if(!bits) continue;
+    const __m256 keep = _mm256_castsi256_ps(_mm256_cmpeq_epi32(
+              _mm256_and_si256(_mm256_set1_epi32((int) bits), laneBits),
+                                                            laneBits));
+    const __m256 u = _mm256_and_ps(_mm256_load_ps(&x[k]), keep);
+    const __m256 v = _mm256_and_ps(_mm256_load_ps(&y[k]), keep);
+    sx = _mm256_add_ps(sx, u);
+    sy = _mm256_add_ps(sy, v);
+    sxx = _mm256_fmadd_ps(u, u, sxx);
+    syy = _mm256_fmadd_ps(v, v, syy);
+    sxy = _mm256_fmadd_ps(u, v, sxy);
+  }
+
+  sums[0] = horizontalSumAVX2(sx);
+  sums[1] = horizontalSumAVX2(sy);
+  sums[2] = horizontalSumAVX2(sxx);
+  sums[3] = horizontalSumAVX2(syy);
+  sums[4] = horizontalSumAVX2(sxy);
+}
+
+
+__attribute__((target("avx512f")))
+void momentsAVX512(cf64 *x, cf64 *y, const u64 *mask,
+                                      csize_t numSamples, f64 *sums){
+  __m512d sx, sy, sxx, syy, sxy;
+
+  sx = sy = sxx = syy = sxy = _mm512_setzero_pd();
+  for(size_t k = 0; k < numSamples; k += 8){
+    const __mmask8 keep = (__mmask8) (mask[k >> 6] >> (k & 63));
+    if(!keep) continue;
+    const __m512d u = _mm512_maskz_load_pd(keep, &x[k]);
+    const __m512d v = _mm512_maskz_load_pd(keep, &y[k]);
+    sx = _mm512_add_pd(sx, u);
+    sy = _mm512_add_pd(sy, v);
+    sxx = _mm512_fmadd_pd(u, u, sxx);
+    syy = _mm512_fmadd_pd(v, v, syy);
+    sxy = _mm512_fmadd_pd(u, v, sxy);
+  }
+
+  sums[0] = horizontalSumAVX512(sx);
+  sums[1] = horizontalSumAVX512(sy);
+  sums[2] = horizontalSumAVX512(sxx);
+  sums[3] = horizontalSumAVX512(syy);
+  sums[4] = horizontalSumAVX512(sxy);
+}
+
+
+__attribute__((target("avx512f")))
+void momentsAVX512(cf32 *x, cf32 *y, const u64 *mask,
+                                      csize_t numSamples, f64 *sums){
+  __m512 sx, sy, sxx, syy, sxy;
+
+  sx = sy = sxx = syy = sxy = _mm512_setzero_ps();
+  for(size_t k = 0; k < numSamples; k += 16){
+    const __mmask16 keep = (__mmask16) (mask[k >> 6] >> (k & 63));
+    if(!keep) continue;
+    const __m512 u = _mm512_maskz_load_ps(keep, &x[k]);
+    const __m512 v = _mm512_maskz_load_ps(keep, &y[k]);
+    sx = _mm512_add_ps(sx, u);
+    sy = _mm512_add_ps(sy, v);
+    sxx = _mm512_fmadd_ps(u, u, sxx);
+    syy = _mm512_fmadd_ps(v, v, syy);
+    sxy = _mm512_fmadd_ps(u, v, sxy);
+  }
+
+  sums[0] = horizontalSumAVX512(sx);
+  sums[1] = horizontalSumAVX512(sy);
+  sums[2] = horizontalSumAVX512(sxx);
+  sums[3] = horizontalSumAVX512(syy);
+  sums[4] = horizontalSumAVX512(sxy);
+}
+
+#endif
+
+
+enum simdLevel detectSimdLevel(){
+#ifdef CORRELATION_X86_KERNELS
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx512f"))
+    return SIMD_AVX512;
+  if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return SIMD_AVX2;
+#endif
+  return SIMD_SCALAR;
+}
+
+
+void forceSimdLevel(enum simdLevel level){
+  simdCeiling = level;
+}
+
+
+enum simdLevel activeSimdLevel(){
+  const enum simdLevel detected = detectSimdLevel();
+  return detected < simdCeiling ? detected : simdCeiling;
+}
+
+
+template <typename T> struct correlationKernels<T> selectKernels(){
+  struct correlationKernels<T> tr = {tileScalar<T>, dotScalar<T>,
+                                                    momentsScalar<T>};
+
+#ifdef CORRELATION_X86_KERNELS
+  //Overload resolution on T picks the f64 or f32 variant
+  switch(activeSimdLevel()){
+    case SIMD_AVX512:
+      tr = {tileAVX512, dotAVX512, momentsAVX512};
+      break;
+    case SIMD_AVX2:
+      tr = {tileAVX2, dotAVX2, momentsAVX2};
+      break;
+    default:
+      break;
+  }
+#endif
+
+  return tr;
+}
+
+
+template <typename T> void *blockedCorrelationHelper(void *arg){
+  TRACE_SCOPE("blockedCorrelationHelper");
+  struct multithreadLoad *argPrime = (struct multithreadLoad*) arg;
+  csize_t numerator = argPrime->numerator;
+  csize_t denominator = argPrime->denominator;
+
+  struct blockedCorrelationHelperStruct<T> *args =
+        (struct blockedCorrelationHelperStruct<T>*) argPrime->specifics;
+  const T *tfRows = args->tfRows;
+  csize_t numTFs = args->numTFs;
+  const T *geneRows = args->geneRows;
+  csize_t numGenes = args->numGenes;
+  csize_t stride = args->stride;
+  AlignedMatrix<T> &result = *args->result;
+
+  const struct correlationKernels<T> kernels = selectKernels<T>();
+  T sums[TILE_TFS * TILE_GENES];
+  T *compensation;
+
+  //Slice on whole TF tiles so that threads never share an output row
+  csize_t numTiles = (numTFs + TILE_TFS - 1) / TILE_TFS;
+  csize_t tfStart = TILE_TFS * ((numerator * numTiles) / denominator);
+  size_t tfEnd = TILE_TFS * (((numerator + 1) * numTiles) / denominator);
+  if(tfEnd > numTFs) tfEnd = numTFs;
+  if(tfEnd <= tfStart) return NULL;
+
+  //Running error of each output in the current gene block, row major
+  compensation = (T*) malloc(sizeof(*compensation) * (tfEnd - tfStart)
+                                                          * GENE_BLOCK);
+  if(NULL == compensation){
+    args->failed = true;
+    return NULL;
+  }
+
+  for(size_t t = tfStart; t < tfEnd; t++)
+    memset(result.row(t), 0, sizeof(*result.row(t)) * numGenes);
+
+  //Sample blocks are innermost so each output's compensation only has
+  //to be kept for one gene block
+  for(size_t gb = 0; gb < numGenes; gb += GENE_BLOCK){
+    csize_t ge = gb + GENE_BLOCK < numGenes ? gb + GENE_BLOCK : numGenes;
+
+    memset(compensation, 0, sizeof(*compensation) * (tfEnd - tfStart)
+                                                          * GENE_BLOCK);
+
+    for(size_t kb = 0; kb < stride; kb += SAMPLE_BLOCK){
+      csize_t ke = kb + SAMPLE_BLOCK < stride ? kb + SAMPLE_BLOCK : stride;
+
+      size_t t = tfStart;
+      for(; t + TILE_TFS <= tfEnd; t += TILE_TFS){
+        const T *a = &tfRows[t * stride];
+        T *c = &compensation[(t - tfStart) * GENE_BLOCK];
+        size_t g = gb;
+        for(; g + TILE_GENES <= ge; g += TILE_GENES){
+          kernels.tile(a, &geneRows[g * stride], stride, kb, ke, sums);
+          for(size_t i = 0; i < TILE_TFS; i++)
+            for(size_t j = 0; j < TILE_GENES; j++)
+              kahanAdd(result(t + i, g + j),
+                                  c[i * GENE_BLOCK + g + j - gb],
+                                              sums[i * TILE_GENES + j]);
+        }
+        for(; g < ge; g++)
+          for(size_t i = 0; i < TILE_TFS; i++)
+            kahanAdd(result(t + i, g), c[i * GENE_BLOCK + g - gb],
+                kernels.dot(&a[i * stride], &geneRows[g * stride], kb, ke));
+      }
+      for(; t < tfEnd; t++){
+        T *c = &compensation[(t - tfStart) * GENE_BLOCK];
+        for(size_t g = gb; g < ge; g++)
+          kahanAdd(result(t, g), c[g - gb], kernels.dot(
+                    &tfRows[t * stride], &geneRows[g * stride], kb, ke));
+      }
+    }
+  }
+
+  free(compensation);
+
+  return NULL;
+}
+
+
+template <typename T> bool blockedCorrelation(const T *tfRows,
+                  csize_t numTFs, const T *geneRows, csize_t numGenes,
+                              csize_t stride, AlignedMatrix<T> &result){
+  struct blockedCorrelationHelperStruct<T> instructions;
+
+  instructions = {
+      tfRows,
+      numTFs,
+      geneRows,
+      numGenes,
+      stride,
+      &result,
+      false
+    };
+
+  autoThreadLauncher(blockedCorrelationHelper<T>, (void*) &instructions);
+
+  return !instructions.failed;
+}
+
+
+template <typename T> void *maskedCorrelationHelper(void *arg){
+  TRACE_SCOPE("maskedCorrelationHelper");
+  struct multithreadLoad *argPrime = (struct multithreadLoad*) arg;
+  csize_t numerator = argPrime->numerator;
+  csize_t denominator = argPrime->denominator;
+
+  struct maskedCorrelationHelperStruct<T> *args =
+        (struct maskedCorrelationHelperStruct<T>*) argPrime->specifics;
+  const T *tfRows = args->tfRows;
+  const u64 *tfMasks = args->tfMasks;
+  cu8 *tfIncomplete = args->tfIncomplete;
+  csize_t numTFs = args->numTFs;
+  const T *geneRows = args->geneRows;
+  const u64 *geneMasks = args->geneMasks;
+  cu8 *geneIncomplete = args->geneIncomplete;
+  csize_t numGenes = args->numGenes;
+  csize_t numSamples = args->numSamples;
+  csize_t stride = args->stride;
+  csize_t maskWords = args->maskWords;
+  cu32 *tfOrder = args->tfOrder;
+  cu32 *geneOrder = args->geneOrder;
+  AlignedMatrix<T> &result = *args->result;
+
+  const struct correlationKernels<T> kernels = selectKernels<T>();
+  vector<u64> joint(maskWords);
+  f64 sums[5];
+
+  const bool rerank = NULL != tfOrder;
+  vector<T> tfRanks(rerank ? numSamples : 0);
+  vector<T> geneRanks(rerank ? numSamples : 0);
+
+  for(size_t t = (numerator * numTFs) / denominator;
+                    t < ((numerator + 1) * numTFs) / denominator; t++){
+    const u64 *tfMask = &tfMasks[t * maskWords];
+
+    for(size_t g = 0; g < numGenes; g++){
+      if(!tfIncomplete[t] && !geneIncomplete[g]) continue;
+
+      const u64 *geneMask = &geneMasks[g * maskWords];
+      size_t n = 0;
+      for(size_t w = 0; w < maskWords; w++){
+        joint[w] = tfMask[w] & geneMask[w];
+        n += (size_t) __builtin_popcountll(joint[w]);
+      }
+      if(2 > n){
+        result(t, g) = 0;
+        continue;
+      }
+
+      if(rerank){
+        //Spearman over just these samples, so rank both rows again
+        rankOverMask(&tfRows[t * stride], &tfOrder[t * numSamples],
+                                joint.data(), numSamples, tfRanks.data());
+        rankOverMask(&geneRows[g * stride], &geneOrder[g * numSamples],
+                              joint.data(), numSamples, geneRanks.data());
+        momentsScalar(tfRanks.data(), geneRanks.data(), joint.data(),
+                                                      numSamples, sums);
+      }else{
+        kernels.moments(&tfRows[t * stride], &geneRows[g * stride],
+                                          joint.data(), numSamples, sums);
+      }
+      cf64 count = (f64) n;
+      cf64 covariance = count * sums[4] - sums[0] * sums[1];
+      cf64 varianceProduct = (count * sums[2] - sums[0] * sums[0]) *
+                                      (count * sums[3] - sums[1] * sums[1]);
+      result(t, g) = 0 < varianceProduct ?
+                          (T) (covariance / sqrt(varianceProduct)) : 0;
+    }
+  }
+
+  return NULL;
+}
+
+
+template <typename T> bool maskedCorrelation(const T *tfRows,
+              const u64 *tfMasks, csize_t numTFs, const T *geneRows,
+              const u64 *geneMasks, csize_t numGenes, csize_t numSamples,
+              csize_t stride, csize_t maskWords, const bool rerank,
+                                              AlignedMatrix<T> &result){
+  struct maskedCorrelationHelperStruct<T> instructions;
+  vector<u8> tfIncomplete(numTFs), geneIncomplete(numGenes);
+  u32 *tfOrder = NULL, *geneOrder = NULL;
+  void *tmpPtr;
+
+  if(rerank){
+    tmpPtr = malloc(sizeof(*tfOrder) * numTFs * numSamples);
+    tfOrder = (u32*) tmpPtr;
+    tmpPtr = malloc(sizeof(*geneOrder) * numGenes * numSamples);
+    geneOrder = (u32*) tmpPtr;
+    if(NULL == tfOrder || NULL == geneOrder){
+      free(tfOrder);
+      free(geneOrder);
+      return false;
+    }
+  }
+
+  //A row is incomplete if any of its first numSamples bits is clear
+  csize_t fullWords = numSamples / 64;
+  cu64 lastWord = numSamples % 64 ? (1ULL << (numSamples % 64)) - 1 : 0;
+  auto incomplete = [&](const u64 *mask) -> u8 {
+    for(size_t w = 0; w < fullWords; w++)
+      if(~mask[w]) return 1;
+    return lastWord && (mask[fullWords] & lastWord) != lastWord;
+  };
+  for(size_t t = 0; t < numTFs; t++)
+    tfIncomplete[t] = incomplete(&tfMasks[t * maskWords]);
+  for(size_t g = 0; g < numGenes; g++)
+    geneIncomplete[g] = incomplete(&geneMasks[g * maskWords]);
+
+  instructions = {
+      tfRows,
+      tfMasks,
+      tfIncomplete.data(),
+      numTFs,
+      geneRows,
+      geneMasks,
+      geneIncomplete.data(),
+      numGenes,
+      numSamples,
+      stride,
+      maskWords,
+      tfOrder,
+      geneOrder,
+      &result
+    };
+
+  if(rerank)
+    autoThreadLauncher(sampleOrderHelper<T>, (void*) &instructions);
+  autoThreadLauncher(maskedCorrelationHelper<T>, (void*) &instructions);
+
+  free(tfOrder);
+  free(geneOrder);
+
+  return true;
+}
+
+
+template <typename T> void *sampleOrderHelper(void *arg){
+  TRACE_SCOPE("sampleOrderHelper");
+  struct multithreadLoad *argPrime = (struct multithreadLoad*) arg;
+  csize_t numerator = argPrime->numerator;
+  csize_t denominator = argPrime->denominator;
+
+  struct maskedCorrelationHelperStruct<T> *args =
+        (struct maskedCorrelationHelperStruct<T>*) argPrime->specifics;
+  csize_t numTFs = args->numTFs;
+  csize_t numRows = numTFs + args->numGenes;
+  csize_t numSamples = args->numSamples;
+  csize_t stride = args->stride;
+
+  //TF rows, then gene rows
+  for(size_t i = (numerator * numRows) / denominator;
+                    i < ((numerator + 1) * numRows) / denominator; i++){
+    const T *row = i < numTFs ? &args->tfRows[i * stride] :
+                                &args->geneRows[(i - numTFs) * stride];
+    u32 *order = i < numTFs ? &args->tfOrder[i * numSamples] :
+                            &args->geneOrder[(i - numTFs) * numSamples];
+
+    for(size_t k = 0; k < numSamples; k++)
+      order[k] = (u32) k;
+    sort(order, order + numSamples,
+                    [row](cu32 a, cu32 b){ return row[a] < row[b]; });
+  }
+
+  return NULL;
+}
+
+
+template <typename T> void rankOverMask(const T *row, const u32 *order,
+                    const u64 *mask, csize_t numSamples, T *ranks){
+  size_t numRanked = 0;
+
+  //Missing samples are 0 in row, so may sit inside a run of ties
+  for(size_t i = 0; i < numSamples;){
+    size_t j = i, numTied = 0;
+    while(j < numSamples && row[order[j]] == row[order[i]]){
+      numTied += (mask[order[j] >> 6] >> (order[j] & 63)) & 1;
+      j++;
+    }
+
+    const T averageRank = (T) ((f64) numRanked +
+                                              (f64) (numTied + 1) / 2.0);
+    for(size_t k = i; k < j; k++)
+      if((mask[order[k] >> 6] >> (order[k] & 63)) & 1)
+        ranks[order[k]] = averageRank;
+    numRanked += numTied;
+    i = j;
+  }
+}
+
+
+template <typename T> u64 countTiedPairs(const T *sorted, csize_t n){
+  u64 tr = 0;
+
+  for(size_t i = 0; i < n;){
+    size_t j = i + 1;
+    while(j < n && sorted[j] == sorted[i]) j++;
+    tr += (u64) (j - i) * (j - i - 1) / 2;
+    i = j;
+  }
+
+  return tr;
+}
+
+
+template <typename T> u64 mergeSortCountingSwaps(T *values, T *space,
+                                                            csize_t n){
+  u64 swaps = 0;
+  T *from = values, *to = space;
+
+  //Insertion sort short runs first; cheaper than merging single values
+  csize_t RUN = 8;
+  for(size_t runStart = 0; runStart < n; runStart += RUN){
+    csize_t runEnd = runStart + RUN < n ? runStart + RUN : n;
+    for(size_t i = runStart + 1; i < runEnd; i++){
+      const T value = values[i];
+      size_t j = i;
+      while(j > runStart && values[j - 1] > value){
+        values[j] = values[j - 1];
+        j--;
+      }
+      swaps += i - j;
+      values[j] = value;
+    }
+  }
+
+  for(size_t width = RUN; width < n; width <<= 1){
+    for(size_t left = 0; left < n; left += width << 1){
+      csize_t middle = left + width < n ? left + width : n;
+      csize_t right = middle + width < n ? middle + width : n;
+      size_t l = left, r = middle, m = left;
+
+      while(l < middle && r < right){
+        if(from[r] < from[l]){
+          swaps += middle - l;
+          to[m++] = from[r++];
+        }else{
+          to[m++] = from[l++];
+        }
+      }
+      while(l < middle) to[m++] = from[l++];
+      while(r < right)  to[m++] = from[r++];
+    }
+    T *tmp = from; from = to; to = tmp;
+  }
+
+  if(from != values)
+    memcpy(values, from, sizeof(*values) * n);
+
+  return swaps;
+}
+
+
+template <typename T> void *kendallTiesHelper(void *arg){
+  TRACE_SCOPE("kendallTiesHelper");
+  struct multithreadLoad *argPrime = (struct multithreadLoad*) arg;
+  csize_t numerator = argPrime->numerator;
+  csize_t denominator = argPrime->denominator;
+
+  struct kendallHelperStruct<T> *args =
+                  (struct kendallHelperStruct<T>*) argPrime->specifics;
+  const T *geneRows = args->geneRows;
+  csize_t numGenes = args->numGenes;
+  csize_t numSamples = args->numSamples;
+  csize_t stride = args->stride;
+  u64 *geneTies = args->geneTies;
+  u8 *geneIncomplete = args->geneIncomplete;
+
+  vector<T> sorted(numSamples);
+
+  for(size_t i = (numerator * numGenes) / denominator;
+                    i < ((numerator + 1) * numGenes) / denominator; i++){
+    //Ties of incomplete rows depend on the pair; counted there instead
+    geneIncomplete[i] = hasMissing(&geneRows[i * stride], numSamples);
+    if(geneIncomplete[i]) continue;
+    memcpy(sorted.data(), &geneRows[i * stride],
+                                      sizeof(sorted[0]) * numSamples);
+    sort(sorted.begin(), sorted.end());
+    geneTies[i] = countTiedPairs(sorted.data(), numSamples);
+  }
+
+  return NULL;
+}
+
+
+template <typename T> void *kendallHelper(void *arg){
+  TRACE_SCOPE("kendallHelper");
+  struct multithreadLoad *argPrime = (struct multithreadLoad*) arg;
+  csize_t numerator = argPrime->numerator;
+  csize_t denominator = argPrime->denominator;
+
+  struct kendallHelperStruct<T> *args =
+                  (struct kendallHelperStruct<T>*) argPrime->specifics;
+  const T *tfRows = args->tfRows;
+  csize_t numTFs = args->numTFs;
+  const T *geneRows = args->geneRows;
+  csize_t numGenes = args->numGenes;
+  csize_t n = args->numSamples;
+  csize_t stride = args->stride;
+  cu64 *geneTies = args->geneTies;
+  cu8 *geneIncomplete = args->geneIncomplete;
+  AlignedMatrix<T> &result = *args->result;
+
+  csize_t tfBlocks = (numTFs + KENDALL_TF_BLOCK - 1) / KENDALL_TF_BLOCK;
+  csize_t geneBlocks =
+                (numGenes + KENDALL_GENE_BLOCK - 1) / KENDALL_GENE_BLOCK;
+  csize_t numBlocks = tfBlocks * geneBlocks;
+  cu64 n0 = (u64) n * (n - 1) / 2;
+
+  vector<u32> order(n);
+  vector<size_t> groupEnds;
+  vector<T> x(n), y(n), space(n);
+  vector< pair<T, T> > pairs;
+
+  for(size_t block = (numerator * numBlocks) / denominator;
+            block < ((numerator + 1) * numBlocks) / denominator; block++){
+    csize_t tb = (block / geneBlocks) * KENDALL_TF_BLOCK;
+    csize_t gb = (block % geneBlocks) * KENDALL_GENE_BLOCK;
+    csize_t te = tb + KENDALL_TF_BLOCK < numTFs ? tb + KENDALL_TF_BLOCK
+                                                                : numTFs;
+    csize_t ge = gb + KENDALL_GENE_BLOCK < numGenes ?
+                                      gb + KENDALL_GENE_BLOCK : numGenes;
+
+    for(size_t t = tb; t < te; t++){
+      const T *tfRow = &tfRows[t * stride];
+      const bool tfIncomplete = hasMissing(tfRow, n);
+      bool tfHasTies = false;
+      u64 n1 = 0;
+
+      //Order samples by the TF once; every gene is then visited in it
+      if(!tfIncomplete){
+        for(size_t i = 0; i < n; i++)
+          order[i] = (u32) i;
+        sort(order.begin(), order.end(),
+            [tfRow](u32 a, u32 b){ return tfRow[a] < tfRow[b]; });
+
+        groupEnds.clear();
+        for(size_t i = 0; i < n; i++){
+          x[i] = tfRow[order[i]];
+          if(0 < i && x[i] != x[i - 1]) groupEnds.push_back(i);
+        }
+        groupEnds.push_back(n);
+        n1 = countTiedPairs(x.data(), n);
+        tfHasTies = groupEnds.size() < n;
+      }
+
+      for(size_t g = gb; g < ge; g++){
+        const T *geneRow = &geneRows[g * stride];
+        u64 n3 = 0;
+
+        if(tfIncomplete || geneIncomplete[g]){
+          result(t, g) = (T) kendallPairwiseComplete(tfRow, geneRow, n,
+                                          pairs, y.data(), space.data());
+          continue;
+        }
+
+        for(size_t i = 0; i < n; i++)
+          y[i] = geneRow[order[i]];
+
+        //Within a run of tied TF values sort by gene value, so those
+        //pairs are neither counted as swaps nor missed as joint ties
+        if(tfHasTies){
+          size_t groupStart = 0;
+          for(size_t e = 0; e < groupEnds.size(); e++){
+            csize_t groupEnd = groupEnds[e];
+            if(1 < groupEnd - groupStart){
+              sort(&y[groupStart], &y[groupEnd]);
+              n3 += countTiedPairs(&y[groupStart], groupEnd - groupStart);
+            }
+            groupStart = groupEnd;
+          }
+        }
+
+        cu64 swaps = mergeSortCountingSwaps(y.data(), space.data(), n);
+        result(t, g) = (T) kendallTauB(n0, n1, geneTies[g], n3, swaps);
+      }
+    }
+  }
+
+  return NULL;
+}
+
+
+inline f64 kendallTauB(cu64 n0, cu64 n1, cu64 n2, cu64 n3, cu64 swaps){
+  cf64 denominatorSquared = (f64) (n0 - n1) * (f64) (n0 - n2);
+  if(0 >= denominatorSquared) return 0;
+
+  cf64 numeratorValue = (f64) (n0 - n1 - n2 + n3) - 2.0 * (f64) swaps;
+  return numeratorValue / sqrt(denominatorSquared);
+}
+
+
+template <typename T> f64 kendallPairwiseComplete(const T *x, const T *y,
+                  csize_t n, vector< pair<T, T> > &pairs, T *ys, T *space){
+  u64 n1 = 0, n3 = 0;
+
+  pairs.clear();
+  for(size_t k = 0; k < n; k++)
+    if(x[k] == x[k] && y[k] == y[k])
+      pairs.push_back(pair<T, T>(x[k], y[k]));
+
+  csize_t m = pairs.size();
+  if(2 > m) return 0;
+
+  //Sorting on x then y puts tied x runs in y order, as the fast path
+  sort(pairs.begin(), pairs.end());
+  for(size_t i = 0; i < m;){
+    size_t j = i + 1;
+    while(j < m && pairs[j].first == pairs[i].first) j++;
+    n1 += (u64) (j - i) * (j - i - 1) / 2;
+    for(size_t a = i; a < j;){
+      size_t b = a + 1;
+      while(b < j && pairs[b].second == pairs[a].second) b++;
+      n3 += (u64) (b - a) * (b - a - 1) / 2;
+      a = b;
+    }
+    i = j;
+  }
+
+  for(size_t i = 0; i < m; i++)
+    ys[i] = pairs[i].second;
+  cu64 swaps = mergeSortCountingSwaps(ys, space, m);
+
+  return kendallTauB((u64) m * (m - 1) / 2, n1, countTiedPairs(ys, m), n3,
+                                                                  swaps);
+}
+
+
+template <typename T> bool kendallCorrelation(const T *tfRows,
+                  csize_t numTFs, const T *geneRows, csize_t numGenes,
+          csize_t numSamples, csize_t stride, AlignedMatrix<T> &result){
+  struct kendallHelperStruct<T> instructions;
+  u64 *geneTies;
+  u8 *geneIncomplete;
+  void *tmpPtr;
+
+  tmpPtr = malloc(sizeof(*geneTies) * numGenes);
+  geneTies = (u64*) tmpPtr;
+  tmpPtr = malloc(sizeof(*geneIncomplete) * numGenes);
+  geneIncomplete = (u8*) tmpPtr;
+  if(NULL == geneTies || NULL == geneIncomplete){
+    free(geneTies);
+    free(geneIncomplete);
+    return false;
+  }
+
+  instructions = {
+      tfRows,
+      numTFs,
+      geneRows,
+      numGenes,
+      numSamples,
+      stride,
+      geneTies,
+      geneIncomplete,
+      &result
+    };
+
+  autoThreadLauncher(kendallTiesHelper<T>, (void*) &instructions);
+  autoThreadLauncher(kendallHelper<T>, (void*) &instructions);
+
+  free(geneTies);
+  free(geneIncomplete);
+
+  return true;
+}
+
+
+template <typename T> T *gatherTFRows(
+                                  const struct expressionData<T> &data){
+  T *tr;
+
+  csize_t numTFs = data.TFIndexes.size();
+  csize_t stride = data.stride;
+
+  tr = (T*) alignedZeroedAlloc(sizeof(*tr) * numTFs * stride);
+  if(NULL == tr) return tr;
+  for(size_t i = 0; i < numTFs; i++)
+    memcpy(&tr[i * stride], &data.values[data.TFIndexes[i] * stride],
+                                                  sizeof(*tr) * stride);
+
+  return tr;
+}
+
+
+template <typename T> struct correlationTable<T>
+                pearsonCorrelationMatrix(struct expressionData<T> &data){
+  struct correlationTable<T> tr;
+  T *tfRows;
+
+  csize_t numTFs = data.TFIndexes.size();
+
+  if(0 == numTFs){
+    cerr << "None of the listed TFs are in the expression data" << endl;
+    return tr;
+  }
+
+  standardizeRows(data.values, data.numGenes, data.numSamples,
+                                                          data.stride);
+
+  tfRows = gatherTFRows(data);
+  if(NULL == tfRows) return tr;
+
+  if(!tr.fullMatrix.allocate(numTFs, data.numGenes)){
+    free(tfRows);
+    return tr;
+  }
+
+  if(!blockedCorrelation((const T*) tfRows, numTFs,
+        (const T*) data.values, data.numGenes, data.stride, tr.fullMatrix)){
+    cerr << "Could not allocate correlation scratch space" << endl;
+    free(tfRows);
+    tr.fullMatrix.release();
+    return tr;
+  }
+
+  //Only pairs touching a row with missing samples need redoing
+  if(NULL != data.validMasks){
+    vector<u64> tfMasks(numTFs * data.maskWords);
+    for(size_t i = 0; i < numTFs; i++)
+      memcpy(&tfMasks[i * data.maskWords],
+                  &data.validMasks[data.TFIndexes[i] * data.maskWords],
+                                    sizeof(tfMasks[0]) * data.maskWords);
+
+    if(!maskedCorrelation((const T*) tfRows, (const u64*) tfMasks.data(),
+          numTFs, (const T*) data.values, (const u64*) data.validMasks,
+          data.numGenes, data.numSamples, data.stride, data.maskWords,
+                                          data.ranked, tr.fullMatrix)){
+      cerr << "Could not allocate the sample orders" << endl;
+      free(tfRows);
+      tr.fullMatrix.release();
+      return tr;
+    }
+  }
+
+  free(tfRows);
+
+  tr.GeneLabels = data.GeneLabels;
+  tr.TFLabels = data.TFLabels;
+
+  return tr;
+}
+
+
+template <typename T> struct correlationTable<T>
+                spearmanCorrelationMatrix(struct expressionData<T> &data){
+  if(!data.ranked){
+    if(!rankRows(data.values, data.numGenes, data.numSamples,
+                                                          data.stride)){
+      struct correlationTable<T> tr;
+      cerr << "Could not allocate ranking scratch space" << endl;
+      return tr;
+    }
+    data.ranked = true;
+  }
+
+  return pearsonCorrelationMatrix(data);
+}
+
+
+template <typename T> struct correlationTable<T>
+                kendallCorrelationMatrix(struct expressionData<T> &data){
+  struct correlationTable<T> tr;
+  T *tfRows;
+
+  csize_t numTFs = data.TFIndexes.size();
+
+  if(0 == numTFs){
+    cerr << "None of the listed TFs are in the expression data" << endl;
+    return tr;
+  }
+
+  tfRows = gatherTFRows(data);
+  if(NULL == tfRows) return tr;
+
+  if(!tr.fullMatrix.allocate(numTFs, data.numGenes)){
+    free(tfRows);
+    return tr;
+  }
+
+  if(!kendallCorrelation((const T*) tfRows, numTFs,
+                    (const T*) data.values, data.numGenes, data.numSamples,
+                                            data.stride, tr.fullMatrix)){
+    cerr << "Could not allocate Kendall scratch space" << endl;
+    free(tfRows);
+    tr.fullMatrix.release();
+    return tr;
+  }
+
+  free(tfRows);
+
+  tr.GeneLabels = data.GeneLabels;
+  tr.TFLabels = data.TFLabels;
+
+  return tr;
+}
+
+
+template <typename T> struct correlationTable<T>
+                  generateCorrelationMatrixFromFile(cs8 *exprFile,
+                                      cs8 *tfFile, cs8 *corrMethod,
+                                      const struct geneFilter &filter){
+  TRACE_SCOPE("generateCorrelationMatrixFromFile");
+  struct expressionData<T> data;
+  struct correlationTable<T> tr;
+
+  profileBeginPhase("load");
+  if(!loadExpressionData(exprFile, tfFile, filter, data)){
+    freeExpressionData(data);
+    return tr;
+  }
+
+  profileBeginPhase("correlate");
+  //The matrix, padded to whole cache lines, and a copy of the TF rows
+  csize_t paddedGenes = data.numGenes + ROW_ALIGNMENT / sizeof(T);
+  //Spearman sorts each row's samples once when some are missing
+  csize_t sampleOrders = NULL != data.validMasks &&
+            !strcmp("spearman", corrMethod) ? sizeof(u32) *
+              (data.TFIndexes.size() + data.numGenes) * data.numSamples : 0;
+  allocationCheckBudget("correlate", sizeof(T) *
+          data.TFIndexes.size() * (paddedGenes + data.stride) +
+                                                          sampleOrders);
+  if(!strcmp("pearson", corrMethod))
+    tr = pearsonCorrelationMatrix(data);
+  else if(!strcmp("spearman", corrMethod))
+    tr = spearmanCorrelationMatrix(data);
+  else if(!strcmp("kendall", corrMethod))
+    tr = kendallCorrelationMatrix(data);
+  else
+    cerr << "Correlation method \"" << corrMethod << "\" is not "
+            "supported" << endl;
+
+  freeExpressionData(data);
+  profileEndPhase();
+
+  return tr;
+}
+
+
+template <typename T> void freeCorrelationTable(
+                                  struct correlationTable<T> &table){
+  table.fullMatrix.release();
+}
+
+////////////////////////////////////////////////////////////////////////
+//EXPLICIT INSTANTIATIONS///////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+template bool loadExpressionData(cs8*, cs8*, const struct geneFilter&,
+                                          struct expressionData<f64>&);
+template bool loadExpressionData(cs8*, cs8*, const struct geneFilter&,
+                                          struct expressionData<f32>&);
+
+template void freeExpressionData(struct expressionData<f64>&);
+template void freeExpressionData(struct expressionData<f32>&);
+
+template bool markMissingValues(struct expressionData<f64>&);
+template bool markMissingValues(struct expressionData<f32>&);
+
+template void standardizeRows(f64*, csize_t, csize_t, csize_t);
+template void standardizeRows(f32*, csize_t, csize_t, csize_t);
+
+template bool rankRows(f64*, csize_t, csize_t, csize_t);
+template bool rankRows(f32*, csize_t, csize_t, csize_t);
+
+template bool blockedCorrelation(cf64*, csize_t, cf64*, csize_t,
+                                      csize_t, AlignedMatrix<f64>&);
+template bool blockedCorrelation(cf32*, csize_t, cf32*, csize_t,
+                                      csize_t, AlignedMatrix<f32>&);
+
+template bool maskedCorrelation(cf64*, const u64*, csize_t, cf64*,
+              const u64*, csize_t, csize_t, csize_t, csize_t, const bool,
+                                                  AlignedMatrix<f64>&);
+template bool maskedCorrelation(cf32*, const u64*, csize_t, cf32*,
+              const u64*, csize_t, csize_t, csize_t, csize_t, const bool,
+                                                  AlignedMatrix<f32>&);
+
+template bool kendallCorrelation(cf64*, csize_t, cf64*, csize_t,
+                            csize_t, csize_t, AlignedMatrix<f64>&);
+template bool kendallCorrelation(cf32*, csize_t, cf32*, csize_t,
+                            csize_t, csize_t, AlignedMatrix<f32>&);
+
+template struct correlationTable<f64>
+                  pearsonCorrelationMatrix(struct expressionData<f64>&);
+template struct correlationTable<f32>
+                  pearsonCorrelationMatrix(struct expressionData<f32>&);
+
+template struct correlationTable<f64>
+                  spearmanCorrelationMatrix(struct expressionData<f64>&);
+template struct correlationTable<f32>
+                  spearmanCorrelationMatrix(struct expressionData<f32>&);
+
+template struct correlationTable<f64>
+                  kendallCorrelationMatrix(struct expressionData<f64>&);
+template struct correlationTable<f32>
+                  kendallCorrelationMatrix(struct expressionData<f32>&);
+
+template struct correlationTable<f64>
+            generateCorrelationMatrixFromFile<f64>(cs8*, cs8*, cs8*,
+                                              const struct geneFilter&);
+template struct correlationTable<f32>
+            generateCorrelationMatrixFromFile<f32>(cs8*, cs8*, cs8*,
+                                              const struct geneFilter&);
+
+template void freeCorrelationTable(struct correlationTable<f64>&);
+template void freeCorrelationTable(struct correlationTable<f32>&);
+
+////////////////////////////////////////////////////////////////////////
+//END///////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
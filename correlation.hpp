@@ -0,0 +1,329 @@
+/*******************************************************************//**
+         FILE:  correlation.hpp
+
+  DESCRIPTION:  Loading of expression data and blocked correlation
+                kernels used to build the TF by gene correlation matrix
+
+         BUGS:  ---
+        NOTES:  Everything here is instantiated for both f64 and f32;
+                see --precision.
+       AUTHOR:  Josh Marshall <jrmarsha@mtu.edu>
+      COMPANY:  Michigan technological University
+      VERSION:  See git log
+      CREATED:  See git log
+     REVISION:  See git log
+     LISCENSE:  GPLv3
+***********************************************************************/
+#ifndef CORRELATION_HPP
+#define CORRELATION_HPP
+
+////////////////////////////////////////////////////////////////////////
+//INCLUDES//////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+#include <string>
+#include <vector>
+
+#include "aligned-matrix.t.hpp"
+#include "auxillaryUtilities.hpp"
+
+////////////////////////////////////////////////////////////////////////
+//NAMESPACE USING///////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+using std::string;
+using std::vector;
+
+////////////////////////////////////////////////////////////////////////
+//ENUMS/////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************//**
+ *  Instruction set used by the correlation kernels.  Ordered so that a
+ * higher value is a superset of a lower one.
+ **********************************************************************/
+enum simdLevel{
+  SIMD_SCALAR = 0,
+  SIMD_AVX2 = 1,
+  SIMD_AVX512 = 2
+};
+
+////////////////////////////////////////////////////////////////////////
+//STRUCTS///////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************//**
+ *  Expression data as read from an expression file.  Rows are genes in
+ * file order, stored contiguously with each row padded out to stride
+ * values so that every row starts on a 64 byte boundary.  Padding is
+ * always zero.
+ *
+ *  Missing measurements are held as NaN.  validMasks then has
+ * maskWords words per row with bit k of a row set if sample k was
+ * measured; it is NULL when nothing is missing.
+ **********************************************************************/
+template <typename T> struct expressionData{
+  vector<string> GeneLabels;
+  vector<string> TFLabels;
+  vector<size_t> TFIndexes;
+
+  T *values;
+  size_t numGenes;
+  size_t numSamples;
+  size_t stride;
+
+  u64 *validMasks;
+  size_t maskWords;
+
+  bool ranked;
+};
+
+
+/*******************************************************************//**
+ *  TF by gene correlation matrix handed to the SCCM construction.
+ * fullMatrix has one row of numCols() values per TF, all in one aligned
+ * block.
+ **********************************************************************/
+template <typename T> struct correlationTable{
+  AlignedMatrix<T> fullMatrix;
+  vector<string> GeneLabels;
+  vector<string> TFLabels;
+
+  size_t numRows() const { return TFLabels.size(); }
+  size_t numCols() const { return GeneLabels.size(); }
+};
+
+////////////////////////////////////////////////////////////////////////
+//PUBLIC FUNCTION DECLARATIONS//////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************//**
+ *  Read an expression file and a transcription factor list in the
+ * formats described in README.md.  Transcription factors which are not
+ * present in the expression file are reported and skipped.  NA and NaN
+ * are read as missing measurements.  Genes failing filter are dropped
+ * as they are parsed, and the number removed reported.
+ *
+ * @param[in] exprFile Path to the expression file.
+ * @param[in] tfFile Path to the transcription factor list.
+ * @param[in] filter Which genes to keep.
+ * @param[out] data Loaded expression data.  data.values must be
+ *                  released with freeExpressionData().
+ *
+ * @return true on success, false if either file could not be used.
+ **********************************************************************/
+template <typename T> bool loadExpressionData(cs8 *exprFile,
+                cs8 *tfFile, const struct geneFilter &filter,
+                                          struct expressionData<T> &data);
+
+
+/*******************************************************************//**
+ *  Release the memory held by a loaded expressionData.
+ **********************************************************************/
+template <typename T> void freeExpressionData(
+                                      struct expressionData<T> &data);
+
+
+/*******************************************************************//**
+ *  Build data.validMasks from the NaNs in data.values, leaving it NULL
+ * if there are none.  Any previous masks are released.
+ *
+ * @param[in,out] data Expression data with values filled in.
+ *
+ * @return false if the masks could not be allocated.
+ **********************************************************************/
+template <typename T> bool markMissingValues(
+                                      struct expressionData<T> &data);
+
+
+/*******************************************************************//**
+ *  Center each row on its mean and scale it to unit length, so that
+ * the dot product of two standardized rows is their Pearson
+ * correlation.  Rows with no variance are set to all zeros.  Sums are
+ * Kahan compensated so long f32 rows keep their accuracy.  NaNs are
+ * left out of the mean and length and then replaced by zero.
+ *
+ * @param[in,out] rows numRows rows of stride values each.
+ * @param[in] numRows Number of rows.
+ * @param[in] numSamples Number of meaningful values in each row.
+ * @param[in] stride Distance between the starts of adjacent rows.
+ **********************************************************************/
+template <typename T> void standardizeRows(T *rows, csize_t numRows,
+                                  csize_t numSamples, csize_t stride);
+
+
+/*******************************************************************//**
+ *  Replace each row with the ranks of its values, ties given the
+ * average of the ranks they span.  Rows are ranked in parallel, each
+ * with an LSD radix sort on the bit patterns of its values.  NaNs are
+ * not ranked and stay NaN.
+ *
+ * @param[in,out] rows numRows rows of stride values each.
+ * @param[in] numRows Number of rows.
+ * @param[in] numSamples Number of meaningful values in each row.
+ * @param[in] stride Distance between the starts of adjacent rows.
+ *
+ * @return false if scratch space could not be allocated; rows may then
+ *         be partly ranked.
+ **********************************************************************/
+template <typename T> bool rankRows(T *rows, csize_t numRows,
+                                  csize_t numSamples, csize_t stride);
+
+
+/*******************************************************************//**
+ *  Compute result[i][j] = dot(tfRows[i], geneRows[j]) for every pair
+ * with a cache blocked, register tiled kernel.  Work is split across
+ * all available cores.  Partial sums are pairwise within a vector and
+ * Kahan compensated across sample blocks.
+ *
+ * @param[in] tfRows numTFs standardized rows, 64 byte aligned.
+ * @param[in] numTFs Number of rows in tfRows.
+ * @param[in] geneRows numGenes standardized rows, 64 byte aligned.
+ * @param[in] numGenes Number of rows in geneRows.
+ * @param[in] stride Row stride of both inputs; a multiple of 64 bytes.
+ * @param[out] result numTFs by numGenes matrix.
+ *
+ * @return false if scratch space could not be allocated, leaving
+ *         result incomplete.
+ **********************************************************************/
+template <typename T> bool blockedCorrelation(const T *tfRows,
+                  csize_t numTFs, const T *geneRows, csize_t numGenes,
+                              csize_t stride, AlignedMatrix<T> &result);
+
+
+/*******************************************************************//**
+ *  Overwrite result[i][j] with the Pearson correlation over the
+ * samples both rows measured, for every pair where either row has a
+ * missing sample.  Pairs of fully measured rows are left alone, since
+ * blockedCorrelation() already has them right.  Fewer than two shared
+ * samples, or no variance over them, gives 0.  With rerank, both rows
+ * are first ranked again over just those samples, giving Spearman's
+ * rho of the pair rather than Pearson's r of ranks taken over each
+ * row's own samples.
+ *
+ * @param[in] tfRows numTFs standardized rows with zeros where missing.
+ * @param[in] tfMasks numTFs rows of maskWords validity words.
+ * @param[in] numTFs Number of rows in tfRows.
+ * @param[in] geneRows numGenes rows as for tfRows.
+ * @param[in] geneMasks numGenes rows of maskWords validity words.
+ * @param[in] numGenes Number of rows in geneRows.
+ * @param[in] numSamples Number of meaningful values in each row.
+ * @param[in] stride Row stride of both inputs; a multiple of 64 bytes.
+ * @param[in] maskWords Words per row of the masks.
+ * @param[in] rerank Whether the rows hold ranks, to be taken again over
+ *                   each pair's shared samples.
+ * @param[in,out] result numTFs by numGenes matrix.
+ *
+ * @return false if the sample orders for rerank could not be
+ *         allocated, leaving result untouched.
+ **********************************************************************/
+template <typename T> bool maskedCorrelation(const T *tfRows,
+              const u64 *tfMasks, csize_t numTFs, const T *geneRows,
+              const u64 *geneMasks, csize_t numGenes, csize_t numSamples,
+              csize_t stride, csize_t maskWords, const bool rerank,
+                                              AlignedMatrix<T> &result);
+
+
+/*******************************************************************//**
+ *  Compute Kendall's tau-b between every TF row and every gene row
+ * using Knight's O(n log n) algorithm: samples are ordered by the TF
+ * once, and discordant pairs are then counted as the exchanges a merge
+ * sort makes putting the gene's values in order.  Work is split across
+ * all available cores in TF by gene blocks.  Pairs where either row
+ * has NaNs are computed over the samples both rows measured.
+ *
+ * @param[in] tfRows numTFs rows of raw or ranked values.
+ * @param[in] numTFs Number of rows in tfRows.
+ * @param[in] geneRows numGenes rows of raw or ranked values.
+ * @param[in] numGenes Number of rows in geneRows.
+ * @param[in] numSamples Number of meaningful values in each row.
+ * @param[in] stride Row stride of both inputs.
+ * @param[out] result numTFs by numGenes matrix.
+ *
+ * @return false if scratch space could not be allocated, leaving
+ *         result incomplete.
+ **********************************************************************/
+template <typename T> bool kendallCorrelation(const T *tfRows,
+                  csize_t numTFs, const T *geneRows, csize_t numGenes,
+          csize_t numSamples, csize_t stride, AlignedMatrix<T> &result);
+
+
+/*******************************************************************//**
+ *  Build the TF by gene Pearson correlation matrix for loaded
+ * expression data.  data.values is standardized in place.
+ *
+ * @param[in,out] data Loaded expression data.
+ *
+ * @return Correlation matrix, or one with an empty fullMatrix on
+ *         failure.
+ **********************************************************************/
+template <typename T> struct correlationTable<T>
+                pearsonCorrelationMatrix(struct expressionData<T> &data);
+
+
+/*******************************************************************//**
+ *  Build the TF by gene Spearman rank correlation matrix for loaded
+ * expression data.  Every gene row is ranked once, unless data.ranked
+ * says this was already done, and the ranks are then correlated with
+ * the Pearson kernel.  data.values is modified in place.
+ *
+ * @param[in,out] data Loaded expression data.
+ *
+ * @return Correlation matrix, or one with an empty fullMatrix on
+ *         failure.
+ **********************************************************************/
+template <typename T> struct correlationTable<T>
+                spearmanCorrelationMatrix(struct expressionData<T> &data);
+
+
+/*******************************************************************//**
+ *  Build the TF by gene Kendall tau-b correlation matrix for loaded
+ * expression data.
+ *
+ * @param[in] data Loaded expression data.
+ *
+ * @return Correlation matrix, or one with an empty fullMatrix on
+ *         failure.
+ **********************************************************************/
+template <typename T> struct correlationTable<T>
+                kendallCorrelationMatrix(struct expressionData<T> &data);
+
+
+/*******************************************************************//**
+ *  Load the files and build a correlation matrix from them.
+ *
+ * @param[in] exprFile Path to the expression file.
+ * @param[in] tfFile Path to the transcription factor list.
+ * @param[in] corrMethod "pearson", "spearman" or "kendall".
+ * @param[in] filter Which genes to keep.
+ **********************************************************************/
+template <typename T> struct correlationTable<T>
+                  generateCorrelationMatrixFromFile(cs8 *exprFile,
+                                      cs8 *tfFile, cs8 *corrMethod,
+                                      const struct geneFilter &filter);
+
+
+/*******************************************************************//**
+ *  Release the matrix of a correlation table.
+ **********************************************************************/
+template <typename T> void freeCorrelationTable(
+                                  struct correlationTable<T> &table);
+
+
+/*******************************************************************//**
+ *  Best instruction set supported by both the build and the CPU.
+ **********************************************************************/
+enum simdLevel detectSimdLevel();
+
+
+/*******************************************************************//**
+ *  Limit the kernels to at most the given instruction set.  Used by
+ * benchmarks to compare code paths.
+ **********************************************************************/
+void forceSimdLevel(enum simdLevel level);
+
+////////////////////////////////////////////////////////////////////////
+//END///////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+#endif
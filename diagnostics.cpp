@@ -20,6 +20,7 @@
 
 #include <iostream>
 
+#include "correlation.hpp"
 #include "diagnostics.hpp"
 #include "edge.t.hpp"
 #include "graph.t.hpp"
@@ -40,19 +41,6 @@ using std::vector;
 //FUNCTION DEFINITIONS//////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
 
-void printClusters(queue< queue<size_t> > clusters,
-                                            const vector<string> &TFs){
-  for(size_t i = 0; !clusters.empty(); i++){
-    cout << "cluster: " << (i+1) << endl;
-    while(!clusters.front().empty()){
-      cout << TFs[clusters.front().front()] << endl;
-      clusters.front().pop();
-    }
-    clusters.pop();
-  }
-}
-
-
 void printCoincidenceMatrix(UpperDiagonalSquareMatrix<u8> matrix, 
                                 cu8 maxMatch, const vector<string> TFs){
   f64 **mtr;
@@ -81,20 +69,18 @@ void printCoincidenceMatrix(UpperDiagonalSquareMatrix<u8> matrix,
 }
 
 
-void printCorrelationMatrix(const CMF &protoGraph){
-  //vector< pair<size_t, double>* > matrix;
-  //unordered_map<string, size_t> labelLookup;
-  //vector<string> labels;
-  //vector<size_t> colSize;
+template <typename T> void printCorrelationMatrix(
+                                const correlationTable<T> &protoGraph){
   printf("\t");
   for(size_t i = 0; i < protoGraph.GeneLabels.size();i++)
     printf("%s\t", protoGraph.GeneLabels[i].c_str());
 
 
   for(size_t i = 0; i < protoGraph.TFLabels.size(); i++){
+    const T *row = protoGraph.fullMatrix.row(i);
     printf("%s\t", protoGraph.TFLabels[i].c_str());
     for(size_t j = 0; j < protoGraph.GeneLabels.size(); j++){
-      printf("%lf\t", protoGraph.fullMatrix[i][j]);
+      printf("%lf\t", (f64) row[j]);
     }
     printf("\n");
   }
@@ -136,11 +122,13 @@ void printEdgeWeights(graph<geneData, u8> *corrData){
 }
 
 
-void printProtoGraph(const CMF &toPrint){
+template <typename T> void printProtoGraph(
+                                  const correlationTable<T> &toPrint){
   for(size_t i = 0; i < toPrint.numRows(); i++){
+    const T *row = toPrint.fullMatrix.row(i);
     for(size_t j = 0; j < toPrint.numCols(); j++){
       fprintf(stdout, "%s\t%s\t%lf\n", toPrint.TFLabels[i].c_str(), 
-                      toPrint.GeneLabels[j].c_str(), toPrint.fullMatrix[i][j]);
+                      toPrint.GeneLabels[j].c_str(), (f64) row[j]);
     }
   }
 }
@@ -162,6 +150,15 @@ labels[toPrint->getVertexes()[i]->getEdges()[j]->other(toPrint->getVertexes()[i]
   }
 }
 
+////////////////////////////////////////////////////////////////////////
+//EXPLICIT INSTANTIATIONS///////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+template void printCorrelationMatrix(const correlationTable<f64>&);
+template void printCorrelationMatrix(const correlationTable<f32>&);
+
+template void printProtoGraph(const correlationTable<f64>&);
+template void printProtoGraph(const correlationTable<f32>&);
 
 ////////////////////////////////////////////////////////////////////////
 //END///////////////////////////////////////////////////////////////////
@@ -25,16 +25,6 @@ using std::vector;
 //GLOBAL FUNCTION DEFINITIONS///////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
 
-/*******************************************************************//**
- *  Print clusters of (presumably) genes.
- *
- * @param[in] clusters Hold name indexes.
- * @param[in] names Hold the names to be printed.
- **********************************************************************/
-void printClusters(queue< queue<size_t> > clusters,
-                                            const vector<string> &TFs);
-
-
 void printCoincidenceMatrix(const UpperDiagonalSquareMatrix<u8> matrix, 
                                 cu8 maxMatch, const vector<string> TFs);
 
@@ -50,8 +40,12 @@ void printCoincidenceMatrix(const UpperDiagonalSquareMatrix<u8> matrix,
 //void printEdges(graph<geneData, f64> *corrData);
 
 
-//TODO: add doc
-void printCorrelationMatrix(const CMF &protoGraph);
+/*******************************************************************//**
+ *  Print a correlation table to stdout as a tab separated grid, genes
+ * across and TFs down.
+ **********************************************************************/
+template <typename T> void printCorrelationMatrix(
+                                const correlationTable<T> &protoGraph);
 
 
 //TODO: add doc
@@ -66,8 +60,12 @@ void graphvizRepresentation(graph<geneData, f64> *corrData, vector<string> label
 void printEdgeWeights(graph<geneData, u8> *corrData);
 
 
-//TODO: add doc
-void printProtoGraph(const CMF &toPrint);
+/*******************************************************************//**
+ *  Print a correlation table to stdout as one "TF gene value" line per
+ * entry.
+ **********************************************************************/
+template <typename T> void printProtoGraph(
+                                  const correlationTable<T> &toPrint);
 
 
 /*******************************************************************//**
@@ -27,9 +27,6 @@ geneData::geneData(const size_t newNameIndex):nameIndex(newNameIndex){}
 
 
 geneData geneData::operator=(geneData const &other){
-  oneSigmaLink = other.oneSigmaLink;
-  twoSigmaLink = other.twoSigmaLink;
-  threeSigmaLink = other.threeSigmaLink;
   nameIndex = other.nameIndex;
 
   return *this;
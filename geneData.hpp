@@ -4,7 +4,8 @@
   DESCRIPTION:  Container for use with triple-link clustering
 
          BUGS:  ---
-        NOTES:  ---
+        NOTES:  Triple-link keeps its marks for each gene in arrays by
+                nameIndex, in tripleLink.cpp, rather than in here.
        AUTHOR:  Josh Marshall <jrmarsha@mtu.edu>
       COMPANY:  Michigan technological University
       VERSION:  See git log
@@ -34,9 +35,6 @@ class geneData{
 
   public:
   size_t nameIndex;
-  bool threeSigmaLink;
-  bool twoSigmaLink;
-  bool oneSigmaLink;
 
 
 /*******************************************************************//**
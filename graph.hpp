@@ -33,6 +33,28 @@
 
 using std::unordered_map;
 
+////////////////////////////////////////////////////////////////////////
+//TRAITS////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************//**
+ *  Whether a graph of T can find the vertex holding a value by indexing
+ * an array with key(value) rather than hashing the value.  Specialize
+ * with value true for types keyed by small, mostly dense integers.
+ **********************************************************************/
+template <typename T> struct denseGraphKey{
+  static const bool value = false;
+  static size_t key(const T &){ return 0; }
+};
+
+
+/*geneData is keyed by its name index, which runs from 0 to the number of
+TFs.*/
+template <> struct denseGraphKey<geneData>{
+  static const bool value = true;
+  static size_t key(const geneData &toKey){ return toKey.nameIndex; }
+};
+
 ////////////////////////////////////////////////////////////////////////
 //CLASS DEFINITION//////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
@@ -48,6 +70,13 @@ template <typename T, typename U> class graph{
   size_t vertexArraySize, edgeArraySize;
   unordered_map<T, size_t, std::hash<T>> geneNameToNodeID;
 
+  //While keyedByArray, vertexes are found through keyToNodeID instead:
+  //the vertex index holding key k is keyToNodeID[k - keyBase], for
+  //keys from keyBase up to keyBase + keyRange
+  bool keyedByArray;
+  size_t *keyToNodeID;
+  size_t keyBase, keyRange;
+
 /*GRAPH OPERATIONS*****************************************************/
   public:
 
@@ -65,9 +94,18 @@ template <typename T, typename U> class graph{
 
 
 /*******************************************************************//**
- *  Copy the contents of one graph to another.
+ *  Make a copy of other, whose vertexes and edges are at the same
+ * indexes and listed in the same order, so that anything run on the
+ * copy, such as tripleLink(), gives what it would on other.
+ **********************************************************************/
+  graph(const graph<T, U> &other);
+
+
+/*******************************************************************//**
+ *  Replace the contents of this graph with a copy of other's, as the
+ * copy constructor makes.
  **********************************************************************/
-  graph<T, U> operator=(const graph<T, U> &other);
+  graph<T, U>& operator=(const graph<T, U> &other);
 
 
 /*******************************************************************//**
@@ -226,6 +264,61 @@ template <typename T, typename U> class graph{
  **********************************************************************/
   void ensureVertexCapacity(const size_t size);
 
+
+/*******************************************************************//**
+ *  Remove every vertex and edge and free the arrays holding them.
+ **********************************************************************/
+  void clear();
+
+
+/*******************************************************************//**
+ *  Fill this graph, which must be empty, with a copy of other.  Every
+ * vertex's edges are listed in the order other's are, however other
+ * came to have them.
+ **********************************************************************/
+  void copyFrom(const graph<T, U> &other);
+
+
+/*******************************************************************//**
+ *  Index of the vertex holding value, or NO_VERTEX if there is none.
+ * Safe to call from several threads at once.
+ **********************************************************************/
+  size_t findNodeID(const T &value) const;
+
+
+/*******************************************************************//**
+ *  Record that the vertex holding value is at nodeIndex.
+ **********************************************************************/
+  void mapValue(const T &value, const size_t nodeIndex);
+
+
+/*******************************************************************//**
+ *  Forget the vertex holding value.
+ **********************************************************************/
+  void unmapValue(const T &value);
+
+
+/*******************************************************************//**
+ *  Make keyToNodeID cover keys from low up to high, keeping what it
+ * holds.  Fails, changing nothing, if that would make it much larger
+ * than the graph, whose keys are then too sparse for an array.
+ *
+ * @return true if the keys are covered.
+ **********************************************************************/
+  bool coverKeys(const size_t low, const size_t high);
+
+
+/*******************************************************************//**
+ *  Move every mapping into geneNameToNodeID and stop using keyToNodeID.
+ **********************************************************************/
+  void stopKeyingByArray();
+
+
+/*******************************************************************//**
+ *  Forget every mapping, returning to the mode of a new graph.
+ **********************************************************************/
+  void clearMapping();
+
 };
 
 ////////////////////////////////////////////////////////////////////////
@@ -22,8 +22,10 @@
 #include <csignal>
 #include <iostream>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
+#include "allocation.hpp"
 #include "geneData.hpp"
 #include "graph.hpp"
 
@@ -35,6 +37,19 @@ using std::unordered_map;
 using std::cout;
 using std::endl;
 
+////////////////////////////////////////////////////////////////////////
+//CONSTANTS/////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*graph::findNodeID() of a value no vertex holds.*/
+static const size_t NO_VERTEX = (size_t) -1;
+
+/*A graph's keyToNodeID may cover up to DENSE_KEY_SLACK keys per vertex
+it has room for, plus DENSE_KEY_MINIMUM, before it falls back to
+hashing.*/
+static const size_t DENSE_KEY_SLACK = 4;
+static const size_t DENSE_KEY_MINIMUM = 1024;
+
 ////////////////////////////////////////////////////////////////////////
 //FUNCTION DEFINITIONS//////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
@@ -43,16 +58,74 @@ template <typename T, typename U> graph<T, U>::graph(){
   numVertexes = numEdges = vertexArraySize = edgeArraySize = 0;
   vertexArray = (vertex<T, U>**) NULL;
   edgeArray = (edge<T, U>**) NULL;
+  keyedByArray = denseGraphKey<T>::value;
+  keyToNodeID = NULL;
+  keyBase = keyRange = 0;
+}
+
+
+template <typename T, typename U> graph<T, U>::graph(
+                              const graph<T, U> &other) : graph(){
+  copyFrom(other);
 }
 
 
 template <typename T, typename U> graph<T, U>::~graph(){
+  clear();
+}
+
+
+template <typename T, typename U> void graph<T, U>::clear(){
 
   //while(numEdges)  removeEdge(edgeArray[numEdges-1]);
 
   while(numVertexes) removeVertex(vertexArray[numVertexes-1]);
 
-  geneNameToNodeID.clear();
+  //Capacity hinted for but never used
+  allocationRelease(ALLOC_GRAPH, sizeof(*edgeArray) * edgeArraySize +
+                                  sizeof(*vertexArray) * vertexArraySize);
+  free(edgeArray);
+  free(vertexArray);
+  edgeArray = NULL;
+  vertexArray = NULL;
+  numVertexes = numEdges = vertexArraySize = edgeArraySize = 0;
+
+  clearMapping();
+}
+
+
+template <typename T, typename U> void graph<T, U>::copyFrom(
+                                              const graph<T, U> &other){
+  hintNumVertexes(other.numVertexes);
+  hintNumEdges(other.numEdges);
+
+  //Indexes carry over, so vertexIndex and edgeID need no translating
+  for(size_t i = 0; i < other.numVertexes; i++){
+    const vertex<T, U> *source = other.vertexArray[i];
+    mapValue(source->value, i);
+    vertexArray[i] = new vertex<T, U>(i, source->value);
+    vertexArray[i]->hintNumEdges(source->getNumEdges());
+  }
+  numVertexes = other.numVertexes;
+  allocationRecord(ALLOC_GRAPH, sizeof(vertex<T, U>) * numVertexes);
+
+  for(size_t i = 0; i < other.numEdges; i++){
+    const edge<T, U> *source = other.edgeArray[i];
+    edgeArray[i] = new edge<T, U>(vertexArray[source->left->vertexIndex],
+                    vertexArray[source->right->vertexIndex], source->weight,
+                                                                        i);
+  }
+  numEdges = other.numEdges;
+  allocationRecord(ALLOC_GRAPH, sizeof(edge<T, U>) * numEdges);
+
+  //Edges were registered in graph order; put each vertex's back into
+  //the order other has them in, which removals will have shuffled
+  for(size_t i = 0; i < numVertexes; i++)
+    vertexArray[i]->copyEdgeOrder(*other.vertexArray[i], edgeArray);
+  for(size_t i = 0; i < numEdges; i++){
+    edgeArray[i]->leftEdgeIndex = other.edgeArray[i]->leftEdgeIndex;
+    edgeArray[i]->rightEdgeIndex = other.edgeArray[i]->rightEdgeIndex;
+  }
 }
 
 
@@ -77,6 +150,9 @@ template <typename T, typename U> U graph<T, U>::removeEdge(
     free(edgeArray);
     edgeArray = NULL;
   }
+  allocationRelease(ALLOC_GRAPH, sizeof(edge<T, U>) +
+                    sizeof(*edgeArray) * (edgeArraySize - numEdges));
+  edgeArraySize = numEdges;
 
   return tr;
 }
@@ -100,16 +176,19 @@ template <typename T, typename U> T graph<T, U>::removeVertex(
   T tr = vertexArray[nodeIndex]->value;
 
   //Always remember, update THEN remove.
-  geneNameToNodeID[vertexArray[numVertexes-1]->value] = nodeIndex;
+  mapValue(vertexArray[numVertexes-1]->value, nodeIndex);
   vertexArray[numVertexes-1]->vertexIndex = nodeIndex;
   vertexArray[nodeIndex] = vertexArray[numVertexes-1];
 
-  geneNameToNodeID.erase(tr);
+  unmapValue(tr);
   delete target;
 
   --numVertexes;
   memCheck = realloc(vertexArray, sizeof(*vertexArray) * numVertexes);
   vertexArray = (vertex<T, U>**) memCheck;
+  allocationRelease(ALLOC_GRAPH, sizeof(vertex<T, U>) +
+                  sizeof(*vertexArray) * (vertexArraySize - numVertexes));
+  vertexArraySize = numVertexes;
 
   return tr;
 }
@@ -129,8 +208,9 @@ template <typename T, typename U> vertex<T, U>* graph<T, U>::addVertex(
 
   ensureVertexCapacity(numVertexes + 1);
 
-  geneNameToNodeID.emplace(data, numVertexes);
+  mapValue(data, numVertexes);
   vertexArray[numVertexes] = new vertex<T, U>(numVertexes, data);
+  allocationRecord(ALLOC_GRAPH, sizeof(vertex<T, U>));
 
   numVertexes++;
   return vertexArray[numVertexes-1];
@@ -148,6 +228,7 @@ template <typename T, typename U> edge<T, U>* graph<T, U>::addEdge(
 
   edgeArray[numEdges] = new edge<T, U>(left, right, newWeight,
                                                               numEdges);
+  allocationRecord(ALLOC_GRAPH, sizeof(edge<T, U>));
 
   numEdges++;
   return edgeArray[numEdges-1];
@@ -157,9 +238,8 @@ template <typename T, typename U> edge<T, U>* graph<T, U>::addEdge(
 template <typename T, typename U> edge<T, U>* graph<T, U>::addEdge(
                                                     edge<T, U> &toAdd){
 
-  return addEdge(vertexArray[geneNameToNodeID[toAdd.left->value]],
-                      vertexArray[geneNameToNodeID[toAdd.right->value]],
-                                                          toAdd.weight);
+  return addEdge(getVertexForValue(toAdd.left->value),
+                        getVertexForValue(toAdd.right->value), toAdd.weight);
 }
 
 
@@ -197,28 +277,142 @@ template <typename T, typename U> vertex<T, U>*
 }
 
 
-template <typename T, typename U> graph<T, U> graph<T, U>::operator=(
+template <typename T, typename U> graph<T, U>& graph<T, U>::operator=(
                                               const graph<T, U> &other){
+  if(this == &other) return *this;
 
-  raise(SIGABRT);
+  clear();
+  copyFrom(other);
 
-  graph<T, U> toReturn;
+  return *this;
+}
 
-  for(size_t i = 0; i < this->numVertexes; i++)
-    toReturn.addVertex(*this->vertexArray[i]);
 
-  for(size_t i = 0; i < this->numEdges; i++)
-    toReturn.addEdge(*this->edgeArray[i]);
+template <typename T, typename U> vertex<T, U>*
+                    graph<T, U>::getVertexForValue(const T &testValue){
+  csize_t nodeIndex = findNodeID(testValue);
 
-  return toReturn;
+  if(NO_VERTEX == nodeIndex) return NULL;
+  return vertexArray[nodeIndex];
 }
 
 
-template <typename T, typename U> vertex<T, U>*
-                    graph<T, U>::getVertexForValue(const T &testValue){
-  if(geneNameToNodeID.count(testValue))
-    return vertexArray[geneNameToNodeID[testValue]];
-  return NULL;
+template <typename T, typename U> size_t graph<T, U>::findNodeID(
+                                                  const T &value) const{
+  if(keyedByArray){
+    //Keys below keyBase wrap around to beyond keyRange
+    csize_t offset = denseGraphKey<T>::key(value) - keyBase;
+    return offset < keyRange ? keyToNodeID[offset] : NO_VERTEX;
+  }
+
+  //One lookup, and no operator[], so that threads may look up at once
+  auto found = geneNameToNodeID.find(value);
+  if(geneNameToNodeID.end() == found) return NO_VERTEX;
+  return found->second;
+}
+
+
+template <typename T, typename U> void graph<T, U>::mapValue(
+                                  const T &value, csize_t nodeIndex){
+  if(keyedByArray){
+    csize_t key = denseGraphKey<T>::key(value);
+
+    if(key - keyBase >= keyRange){
+      //Grow by at least the current range, so that keys arriving in
+      //order cost O(1) each
+      size_t low = key, high = key + 1;
+      if(0 < keyRange){
+        low = keyBase;
+        high = keyBase + keyRange;
+        if(key >= high){
+          high = key + 1 > high + keyRange ? key + 1 : high + keyRange;
+        }else{
+          csize_t grown = low > keyRange ? low - keyRange : 0;
+          low = key < grown ? key : grown;
+        }
+      }
+      if(!coverKeys(low, high) && !coverKeys(key, key + 1))
+        stopKeyingByArray();
+    }
+
+    if(keyedByArray){
+      keyToNodeID[key - keyBase] = nodeIndex;
+      return;
+    }
+  }
+
+  geneNameToNodeID[value] = nodeIndex;
+}
+
+
+template <typename T, typename U> void graph<T, U>::unmapValue(
+                                                        const T &value){
+  if(keyedByArray){
+    csize_t offset = denseGraphKey<T>::key(value) - keyBase;
+    if(offset < keyRange) keyToNodeID[offset] = NO_VERTEX;
+    return;
+  }
+
+  geneNameToNodeID.erase(value);
+}
+
+
+template <typename T, typename U> bool graph<T, U>::coverKeys(
+                                          size_t low, size_t high){
+  size_t *memCheck;
+
+  if(0 < keyRange){
+    if(keyBase < low) low = keyBase;
+    if(keyBase + keyRange > high) high = keyBase + keyRange;
+    if(keyBase == low && keyBase + keyRange == high) return true;
+  }
+
+  csize_t range = high - low;
+  csize_t room = numVertexes > vertexArraySize ? numVertexes :
+                                                          vertexArraySize;
+  if(range > DENSE_KEY_SLACK * room + DENSE_KEY_MINIMUM) return false;
+
+  memCheck = (size_t*) malloc(sizeof(*keyToNodeID) * range);
+  if(NULL == memCheck) return false;
+  for(size_t i = 0; i < range; i++) memCheck[i] = NO_VERTEX;
+  if(0 < keyRange){
+    memcpy(memCheck + (keyBase - low), keyToNodeID,
+                                          sizeof(*keyToNodeID) * keyRange);
+    free(keyToNodeID);
+  }
+  allocationResize(ALLOC_GRAPH, sizeof(*keyToNodeID) * keyRange,
+                                              sizeof(*keyToNodeID) * range);
+
+  keyToNodeID = memCheck;
+  keyBase = low;
+  keyRange = range;
+  return true;
+}
+
+
+template <typename T, typename U> void graph<T, U>::stopKeyingByArray(){
+  geneNameToNodeID.reserve(numVertexes);
+  for(size_t i = 0; i < keyRange; i++)
+    if(NO_VERTEX != keyToNodeID[i])
+      geneNameToNodeID.emplace(vertexArray[keyToNodeID[i]]->value,
+                                                          keyToNodeID[i]);
+
+  allocationRelease(ALLOC_GRAPH, sizeof(*keyToNodeID) * keyRange);
+  free(keyToNodeID);
+  keyToNodeID = NULL;
+  keyBase = keyRange = 0;
+  keyedByArray = false;
+}
+
+
+template <typename T, typename U> void graph<T, U>::clearMapping(){
+  allocationRelease(ALLOC_GRAPH, sizeof(*keyToNodeID) * keyRange);
+  free(keyToNodeID);
+  keyToNodeID = NULL;
+  keyBase = keyRange = 0;
+  keyedByArray = denseGraphKey<T>::value;
+
+  geneNameToNodeID.clear();
 }
 
 
@@ -233,6 +427,8 @@ template <typename T, typename U> void graph<T, U>::hintNumEdges(
   memCheck = realloc(edgeArray, suggestSize * sizeof(*edgeArray));
   if(NULL != memCheck){
     edgeArray = (edge<T, U>**) memCheck;
+    allocationResize(ALLOC_GRAPH, edgeArraySize * sizeof(*edgeArray),
+                                        suggestSize * sizeof(*edgeArray));
     edgeArraySize = suggestSize;
   }else{
     fprintf(stderr, "ERROR: Could not allocate edges\n"); fflush(stderr);
@@ -249,11 +445,13 @@ template <typename T, typename U> void graph<T, U>::hintNumVertexes(
 
   if(suggestSize == vertexArraySize) return;
 
-  geneNameToNodeID.reserve(suggestSize);
+  if(!keyedByArray) geneNameToNodeID.reserve(suggestSize);
 
   memCheck = realloc(vertexArray, suggestSize * sizeof(*vertexArray));
   if(NULL != memCheck){
     vertexArray = (vertex<T, U>**) memCheck;
+    allocationResize(ALLOC_GRAPH, vertexArraySize * sizeof(*vertexArray),
+                                      suggestSize * sizeof(*vertexArray));
     vertexArraySize = suggestSize;
   }else{
     raise(SIGABRT);
@@ -293,6 +491,8 @@ template <typename T, typename U> void graph<T, U>::ensureEdgeCapacity(
     raise(SIGABRT);
   }
   edgeArray = (edge<T, U>**) memCheck;
+  allocationResize(ALLOC_GRAPH, edgeArraySize * sizeof(*edgeArray),
+                                          nextSize * sizeof(*edgeArray));
   edgeArraySize = nextSize;
 
 }
@@ -311,6 +511,8 @@ template <typename T, typename U> void
     raise(SIGABRT);
   }
   vertexArray = (vertex<T, U>**) memCheck;
+  allocationResize(ALLOC_GRAPH, vertexArraySize * sizeof(*vertexArray),
+                                        nextSize * sizeof(*vertexArray));
   vertexArraySize = nextSize;
 }
 
@@ -0,0 +1,547 @@
+/*******************************************************************//**
+         FILE:  kernel-bench.cpp
+
+  DESCRIPTION:  Microbenchmarks of the sorting, SCCM, graph and
+                triple-link kernels, with an optional comparison against
+                a saved baseline
+
+         BUGS:  ---
+        NOTES:  Every case is timed one repetition at a time after its
+                warmup repetitions, and reported as the median, 95th
+                percentile and best of those.  Setup such as refilling
+                the input or rebuilding a graph is not timed.  With
+                --baseline the exit status is 1 if any case's median is
+                slower than the baseline's by more than the tolerance.
+       AUTHOR:  Josh Marshall <jrmarsha@mtu.edu>
+      COMPANY:  Michigan technological University
+      VERSION:  See git log
+      CREATED:  See git log
+     REVISION:  See git log
+     LISCENSE:  GPLv3
+***********************************************************************/
+
+////////////////////////////////////////////////////////////////////////
+//INCLUDES//////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <argp.h>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "auxillaryUtilities.hpp"
+#include "edge.t.hpp"
+#include "vertex.t.hpp"
+#include "graph.t.hpp"
+#include "tripleLink.hpp"
+
+////////////////////////////////////////////////////////////////////////
+//NAMESPACE USING///////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+using std::chrono::duration;
+using std::chrono::steady_clock;
+using std::cerr;
+using std::endl;
+using std::function;
+using std::string;
+using std::vector;
+
+////////////////////////////////////////////////////////////////////////
+//PRIVATE STRUCTS///////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************//**
+ *  Sizes and repetitions of a run, and where to save or compare
+ * results.
+ **********************************************************************/
+struct benchSettings{
+  size_t sortSize;
+  size_t genes;
+  size_t edgesPerGene;
+  size_t reps;
+  size_t warmup;
+  f64 tolerance;
+  cs8 *saveFile;
+  cs8 *baselineFile;
+};
+
+
+/*******************************************************************//**
+ *  Seconds of each timed repetition of one case.
+ **********************************************************************/
+struct benchResult{
+  string name;
+  size_t size;
+  vector<f64> times;
+  f64 median, p95, best;
+};
+
+
+/*******************************************************************//**
+ *  An edge of a synthetic gene network.
+ **********************************************************************/
+struct syntheticEdge{
+  size_t left, right;
+  u8 weight;
+};
+
+////////////////////////////////////////////////////////////////////////
+//PRIVATE FUNCTION DECLARATIONS/////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************//**
+ *  Time body reps times after warmup untimed runs, calling setup
+ * before and teardown after each run of body outside of the timing.
+ **********************************************************************/
+struct benchResult runCase(const char *name, csize_t size,
+                      const struct benchSettings &settings,
+                      function<void()> setup, function<void()> body,
+                                            function<void()> teardown);
+
+
+/*******************************************************************//**
+ *  Fill in the median, 95th percentile and best of result's times.
+ **********************************************************************/
+void summarize(struct benchResult &result);
+
+
+/*******************************************************************//**
+ *  A gene network of numGenes genes in modules of 20, each module
+ * fully connected by edges strong enough for triple-link, plus
+ * edgesPerGene weaker edges from each gene to random others.
+ **********************************************************************/
+vector<struct syntheticEdge> syntheticNetwork(csize_t numGenes,
+                            csize_t edgesPerGene, std::mt19937_64 &rng);
+
+
+/*******************************************************************//**
+ *  Build a graph from edges the way constructGraph() does.
+ **********************************************************************/
+graph<geneData, u8> *buildGraph(csize_t numGenes,
+                              const vector<struct syntheticEdge> &edges);
+
+
+/*******************************************************************//**
+ *  Write results as a baseline file.
+ *
+ * @return false if path could not be written.
+ **********************************************************************/
+bool saveResults(const char *path,
+                                  const vector<struct benchResult> &results);
+
+
+/*******************************************************************//**
+ *  Print results against those in the baseline file at path.
+ *
+ * @return Number of cases slower than the baseline by more than
+ *         tolerance, or SIZE_MAX if path could not be read.
+ **********************************************************************/
+size_t compareResults(const char *path,
+                    const vector<struct benchResult> &results,
+                                                    cf64 tolerance);
+
+
+/*******************************************************************//**
+ *  Argp option parser.
+ **********************************************************************/
+static error_t parse_opt(int key, char *arg, struct argp_state *state);
+
+////////////////////////////////////////////////////////////////////////
+//PRIVATE VARIABLES/////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+cs8 *doc = "kernel-bench times tf-cluster's sorting, SCCM access, graph "
+"and triple-link kernels on synthetic data.  Save a run with --save and "
+"compare a later build against it with --baseline.";
+
+
+/*Keys for options which only have a long form.*/
+enum longOnlyOptions{
+  OPT_SAVE = 256,
+  OPT_BASELINE,
+  OPT_TOLERANCE
+};
+
+
+static struct argp_option options[] = {
+  {"sort-size", 's', "INT", 0, "Pairs sorted by the sorting cases.  Defaults to 1048576.", 0},
+  {"genes", 'g', "INT", 0, "Genes in the SCCM, graph and triple-link cases.  Defaults to 2000.", 0},
+  {"edges", 'k', "INT", 0, "Random edges from each gene in the graph and triple-link cases.  Defaults to 50.", 0},
+  {"reps", 'r', "INT", 0, "Timed repetitions of each case.  Defaults to 15.", 0},
+  {"warmup", 'w', "INT", 0, "Untimed repetitions before those.  Defaults to 2.", 0},
+  {"save", OPT_SAVE, "FILE", 0, "Write the results to FILE for a later --baseline.", 0},
+  {"baseline", OPT_BASELINE, "FILE", 0, "Compare each case's median with that saved in FILE, exiting 1 if any is slower by more than the tolerance.", 0},
+  {"tolerance", OPT_TOLERANCE, "FLOAT", 0, "Fraction a median may be slower than the baseline's.  Defaults to 0.05.", 0},
+  { 0 , 0, 0, 0, 0, 0}
+};
+
+
+static struct argp interpreter = {options, parse_opt, 0, doc, 0, 0, 0};
+
+////////////////////////////////////////////////////////////////////////
+//FUNCTION DEFINITIONS//////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+struct benchResult runCase(const char *name, csize_t size,
+                      const struct benchSettings &settings,
+                      function<void()> setup, function<void()> body,
+                                            function<void()> teardown){
+  struct benchResult tr;
+
+  tr.name = name;
+  tr.size = size;
+
+  for(size_t r = 0; r < settings.warmup + settings.reps; r++){
+    setup();
+    steady_clock::time_point start = steady_clock::now();
+    body();
+    cf64 elapsed = duration<f64>(steady_clock::now() - start).count();
+    teardown();
+    if(r >= settings.warmup) tr.times.push_back(elapsed);
+  }
+
+  summarize(tr);
+  printf("%-18s %10zu %12.6f %12.6f %12.6f\n", tr.name.c_str(), tr.size,
+                                              tr.median, tr.p95, tr.best);
+  fflush(stdout);
+
+  return tr;
+}
+
+
+void summarize(struct benchResult &result){
+  vector<f64> sorted(result.times);
+  csize_t n = sorted.size();
+
+  std::sort(sorted.begin(), sorted.end());
+  result.best = sorted[0];
+  result.median = n % 2 ? sorted[n / 2] :
+                                  (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+  //Nearest rank
+  result.p95 = sorted[(size_t) ceil(0.95 * (f64) n) - 1];
+}
+
+
+vector<struct syntheticEdge> syntheticNetwork(csize_t numGenes,
+                            csize_t edgesPerGene, std::mt19937_64 &rng){
+  const size_t moduleSize = 20;
+  vector<struct syntheticEdge> tr;
+  std::uniform_int_distribution<size_t> anyGene(0, numGenes - 1);
+  std::uniform_int_distribution<int> strong(30, 60), weak(1, 25);
+
+  for(size_t start = 0; start + moduleSize <= numGenes;
+                                                    start += moduleSize)
+    for(size_t i = start; i < start + moduleSize; i++)
+      for(size_t j = i + 1; j < start + moduleSize; j++)
+        tr.push_back({i, j, (u8) strong(rng)});
+
+  for(size_t i = 0; i < numGenes; i++)
+    for(size_t e = 0; e < edgesPerGene; e++){
+      csize_t j = anyGene(rng);
+      if(i / moduleSize != j / moduleSize)
+        tr.push_back({i, j, (u8) weak(rng)});
+    }
+
+  return tr;
+}
+
+
+graph<geneData, u8> *buildGraph(csize_t numGenes,
+                              const vector<struct syntheticEdge> &edges){
+  graph<geneData, u8> *tr = new graph<geneData, u8>();
+
+  tr->hintNumVertexes(numGenes);
+  tr->hintNumEdges(edges.size());
+  for(size_t i = 0; i < numGenes; i++)
+    tr->addVertex(geneData(i));
+
+  for(size_t i = 0; i < edges.size(); i++){
+    vertex<geneData, u8> *left, *right;
+    left = tr->getVertexForValue(geneData(edges[i].left));
+    right = tr->getVertexForValue(geneData(edges[i].right));
+    if(false == left->areConnected(right))
+      tr->addEdge(left, right, edges[i].weight);
+  }
+
+  return tr;
+}
+
+
+bool saveResults(const char *path,
+                              const vector<struct benchResult> &results){
+  FILE *out = fopen(path, "w");
+  if(NULL == out) return false;
+
+  fprintf(out, "#case\tsize\tmedian\tp95\tbest\n");
+  for(size_t i = 0; i < results.size(); i++)
+    fprintf(out, "%s\t%zu\t%.9f\t%.9f\t%.9f\n", results[i].name.c_str(),
+                results[i].size, results[i].median, results[i].p95,
+                                                      results[i].best);
+
+  return 0 == fclose(out);
+}
+
+
+size_t compareResults(const char *path,
+                    const vector<struct benchResult> &results,
+                                                    cf64 tolerance){
+  FILE *in = fopen(path, "r");
+  char line[512], name[256];
+  size_t size, tr = 0;
+  f64 median, p95, best;
+  vector<struct benchResult> baseline;
+
+  if(NULL == in) return SIZE_MAX;
+  while(NULL != fgets(line, sizeof(line), in)){
+    if('#' == line[0]) continue;
+    if(5 != sscanf(line, "%255s %zu %lf %lf %lf", name, &size, &median,
+                                                          &p95, &best))
+      continue;
+    baseline.push_back({name, size, vector<f64>(), median, p95, best});
+  }
+  fclose(in);
+
+  printf("\n%-18s %10s %12s %12s %8s\n", "case", "size", "baseline",
+                                                  "median", "ratio");
+  for(size_t i = 0; i < results.size(); i++){
+    const struct benchResult *match = NULL;
+    for(size_t j = 0; j < baseline.size() && NULL == match; j++)
+      if(baseline[j].name == results[i].name &&
+                                        baseline[j].size == results[i].size)
+        match = &baseline[j];
+
+    if(NULL == match){
+      printf("%-18s %10zu %12s %12.6f %8s\n", results[i].name.c_str(),
+                          results[i].size, "-", results[i].median, "-");
+      continue;
+    }
+
+    cf64 ratio = results[i].median / match->median;
+    const bool slower = ratio > 1.0 + tolerance;
+    printf("%-18s %10zu %12.6f %12.6f %8.3f%s\n", results[i].name.c_str(),
+              results[i].size, match->median, results[i].median, ratio,
+                                                slower ? "  SLOWER" : "");
+    if(slower) tr++;
+  }
+
+  return tr;
+}
+
+
+static error_t parse_opt(int key, char *arg, struct argp_state *state){
+  struct benchSettings *args = (struct benchSettings*) state->input;
+  char *end;
+  unsigned long test;
+
+  switch(key){
+    case 's':
+    case 'g':
+    case 'k':
+    case 'r':
+    case 'w':
+      test = strtoul(arg, &end, 10);
+      if(end == arg || *end || ('w' != key && 0 == test)){
+        cerr << "-" << (char) key << " must be a positive integer."
+             << endl;
+        exit(EINVAL);
+      }
+      if('s' == key) args->sortSize = test;
+      if('g' == key) args->genes = test;
+      if('k' == key) args->edgesPerGene = test;
+      if('r' == key) args->reps = test;
+      if('w' == key) args->warmup = test;
+      break;
+    case OPT_SAVE:
+      args->saveFile = arg;
+      break;
+    case OPT_BASELINE:
+      args->baselineFile = arg;
+      break;
+    case OPT_TOLERANCE:
+      args->tolerance = strtod(arg, &end);
+      if(end == arg || *end || 0 > args->tolerance){
+        cerr << "tolerance must be a non-negative number." << endl;
+        exit(EINVAL);
+      }
+      break;
+    default:
+      return ARGP_ERR_UNKNOWN;
+  }
+
+  return 0;
+}
+
+
+int main(int argc, char **argv){
+  struct benchSettings settings = {1 << 20, 2000, 50, 15, 2, 0.05, 0, 0};
+  vector<struct benchResult> results;
+  std::mt19937_64 rng(42);
+  int tr = 0;
+
+  argp_parse(&interpreter, argc, argv, 0, 0, &settings);
+
+  csize_t n = settings.sortSize;
+  csize_t genes = settings.genes;
+
+  printf("%-18s %10s %12s %12s %12s\n", "case", "size", "median (s)",
+                                                    "p95 (s)", "best (s)");
+
+  //Sorting, on the same random input every repetition
+  vector< pair<f64, size_t> > doubleSource(n), doubleWork(n);
+  std::uniform_real_distribution<f64> correlation(-1.0, 1.0);
+  for(size_t i = 0; i < n; i++)
+    doubleSource[i] = pair<f64, size_t>(correlation(rng), i);
+  struct sortScratch<f64, size_t> scratch;
+  if(!sortScratchOpen(scratch, n)){
+    cerr << "Could not allocate sort space" << endl;
+    return ENOMEM;
+  }
+  results.push_back(runCase("sortPairHighToLow", n, settings,
+      [&](){ doubleWork = doubleSource; },
+      [&](){ sortDoubleSizeTPairHighToLow(doubleWork.data(), n, scratch); },
+      [](){}));
+
+  //The same pairs as rows of genes pairs, sorted through one scratch as
+  //each thread of constructPreSCCMHelper() sorts its rows
+  results.push_back(runCase("sortRows", n, settings,
+      [&](){ doubleWork = doubleSource; },
+      [&](){
+        for(size_t i = 0; i < n; i += genes)
+          sortPairHighToLow(&doubleWork[i], n - i < genes ? n - i : genes,
+                                                                 scratch);
+      },
+      [](){}));
+  sortScratchClose(scratch);
+
+  vector< pair<u8, size_t> > byteSource(n), byteSorted(n);
+  std::uniform_int_distribution<int> coincidence(0, 255);
+  for(size_t i = 0; i < n; i++)
+    byteSource[i] = pair<u8, size_t>((u8) coincidence(rng), i);
+  results.push_back(runCase("countingSort", n, settings,
+      [](){},
+      [&](){ countingSortHighToLow(byteSource.data(), n, byteSorted.data(),
+                                                                      n); },
+      [](){}));
+
+  //SCCM access in row order, as constructSCCMHelper() fills it, and
+  //gathered down columns, as sortCoindicenceMatrixHelper() reads it
+  UpperDiagonalSquareMatrix<u8> sccm(genes);
+  size_t checksum = 0;
+  for(size_t i = 0; i < genes; i++)
+    for(size_t j = i + 1; j < genes; j++)
+      sccm.setValueAtIndex(i, j, (u8) coincidence(rng));
+  results.push_back(runCase("sccmRowAccess", genes, settings,
+      [](){},
+      [&](){
+        for(size_t i = 0; i < genes; i++)
+          for(size_t j = i + 1; j < genes; j++)
+            (*sccm.getReferenceForIndex(i, j))++;
+      },
+      [](){}));
+  results.push_back(runCase("sccmColumnGather", genes, settings,
+      [](){},
+      [&](){
+        for(size_t itr = 0; itr < genes; itr++){
+          for(size_t j = 0; j < itr; j++)
+            checksum += sccm.getValueAtIndex(j, itr);
+          for(size_t j = itr + 1; j < genes; j++)
+            checksum += sccm.getValueAtIndex(itr, j);
+        }
+      },
+      [](){}));
+
+  //Graph construction and teardown, and triple-link over the result
+  const vector<struct syntheticEdge> edges =
+                  syntheticNetwork(genes, settings.edgesPerGene, rng);
+  graph<geneData, u8> *network = NULL;
+  struct config clusterSettings;
+  memset(&clusterSettings, 0, sizeof(clusterSettings));
+  clusterSettings.threeSigmaAdj = 40;
+  clusterSettings.twoSigmaAdj = 30;
+  clusterSettings.oneSigmaAdj = 1;
+
+  results.push_back(runCase("graphAdd", edges.size(), settings,
+      [](){},
+      [&](){ network = buildGraph(genes, edges); },
+      [&](){ delete network; }));
+  results.push_back(runCase("vertexLookup", genes, settings,
+      [&](){ network = buildGraph(genes, edges); },
+      [&](){
+        for(size_t r = 0; r < 100; r++)
+          for(size_t i = 0; i < genes; i++)
+            checksum += network->getVertexForValue(geneData(i))->
+                                                            getNumEdges();
+      },
+      [&](){ delete network; }));
+  results.push_back(runCase("graphRemove", edges.size(), settings,
+      [&](){ network = buildGraph(genes, edges); },
+      [&](){
+        while(network->getNumVertexes())
+          network->removeVertex(network->getVertexes()[
+                                          network->getNumVertexes() - 1]);
+      },
+      [&](){ delete network; }));
+  graph<geneData, u8> *copied = NULL;
+  results.push_back(runCase("graphCopy", edges.size(), settings,
+      [&](){ network = buildGraph(genes, edges); },
+      [&](){ copied = new graph<geneData, u8>(*network); },
+      [&](){ delete copied; delete network; }));
+  results.push_back(runCase("tripleLink", edges.size(), settings,
+      [&](){ network = buildGraph(genes, edges); },
+      [&](){ checksum += tripleLink(network, clusterSettings).size(); },
+      [&](){ delete network; }));
+
+  //The same through the first written search and through speculation,
+  //which must beat the plain loop above to be worth turning on
+  struct config serialSettings = clusterSettings;
+  serialSettings.serialLink = true;
+  results.push_back(runCase("tripleLinkSerial", edges.size(), settings,
+      [&](){ network = buildGraph(genes, edges); },
+      [&](){ checksum += tripleLink(network, serialSettings).size(); },
+      [&](){ delete network; }));
+  struct config speculateSettings = clusterSettings;
+  speculateSettings.speculativeSeeds = 4;
+  results.push_back(runCase("tripleLinkSpec4", edges.size(), settings,
+      [&](){ network = buildGraph(genes, edges); },
+      [&](){ checksum += tripleLink(network, speculateSettings).size(); },
+      [&](){ delete network; }));
+
+  //Keeps the compiler from dropping the read only loops
+  if(1 == checksum) printf("\n");
+
+  if(NULL != settings.saveFile && !saveResults(settings.saveFile, results)){
+    cerr << "Could not write \"" << settings.saveFile << "\"" << endl;
+    tr = EIO;
+  }
+
+  if(NULL != settings.baselineFile){
+    csize_t slower = compareResults(settings.baselineFile, results,
+                                                    settings.tolerance);
+    if(SIZE_MAX == slower){
+      cerr << "Could not read \"" << settings.baselineFile << "\""
+           << endl;
+      return EIO;
+    }
+    if(slower){
+      printf("%zu case%s slower than baseline by more than %.1f%%\n",
+          slower, 1 == slower ? "" : "s", settings.tolerance * 100);
+      if(!tr) tr = 1;
+    }
+  }
+
+  return tr;
+}
+
+////////////////////////////////////////////////////////////////////////
+//END///////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
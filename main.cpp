@@ -22,16 +22,23 @@ Input: 1 file name or input from stdin.
 ////////////////////////////////////////////////////////////////////////
 
 #include <argp.h>
+#include <ctype.h>
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <vector>
 
 
+#include "allocation.hpp"
 #include "auxillaryUtilities.hpp"
+#include "correlation.hpp"
 #include "correlation-matrix.hpp"
 #include "diagnostics.hpp"
 #include "edge.t.hpp"
 #include "vertex.t.hpp"
 #include "graph.t.hpp"
+#include "profile.hpp"
+#include "trace.hpp"
 #include "tripleLink.hpp"
 #include "upper-diagonal-square-matrix.t.hpp"
 
@@ -60,6 +67,22 @@ cs8 *doc = "tf-cluster is a tool used to predict transcriptional "
 "time.";
 
 
+/*Keys for options which only have a long form.*/
+enum longOnlyOptions{
+  OPT_MIN_VARIANCE = 256,
+  OPT_MIN_MEAN,
+  OPT_TOP_VARIABLE,
+  OPT_MIN_CORRELATION,
+  OPT_PROFILE,
+  OPT_PERF_COUNTERS,
+  OPT_TRACE,
+  OPT_MAX_MEMORY,
+  OPT_OUTPUT_FORMAT,
+  OPT_SPECULATE,
+  OPT_SERIAL_LINK
+};
+
+
 static struct argp_option options[] = {
   {"tf-list", 't', "FILE", 0, "File descriptor for list of transcription factors", 0},
   {"expression-data", 'e', "FILE", 0, "File descriptor for experiemntal data of gene expression", 0},
@@ -67,7 +90,19 @@ static struct argp_option options[] = {
   {"triple-link-1", '1', "FLOAT", 0, "Highest link strength required for triple link.  Must be a positive number of standard deviations.", 0},
   {"triple-link-2", '2', "FLOAT", 0, "Middle link strength required for triple link.  Must be a positive number of standard deviations.", 0},
   {"triple-link-3", '3', "FLOAT", 0, "Lowest link strength required for triple link.  Must be a positive number of standard deviations.", 0},
-  {"correlation", 'c', "STRING", 0, "Name of the statistical correlation to use in generating the correlation matrix.  Currently supports Pearson's correlation (pearson) and Spearman Rank (spearman).", 0},
+  {"correlation", 'c', "STRING", 0, "Name of the statistical correlation to use in generating the correlation matrix.  Currently supports Pearson's correlation (pearson), Spearman Rank (spearman) and Kendall's tau-b (kendall).  Defaults to spearman.", 0},
+  {"precision", 'p', "STRING", 0, "Floating point type the correlation matrix is computed and stored in, either f64 (default) or f32.  f32 halves the memory of the matrix and doubles the SIMD width, at roughly 7 significant digits.", 0},
+  {"min-variance", OPT_MIN_VARIANCE, "FLOAT", 0, "Drop genes whose sample variance is below this before correlating.  Listed TFs are never dropped.", 0},
+  {"min-mean", OPT_MIN_MEAN, "FLOAT", 0, "Drop genes whose mean expression is below this before correlating.  Listed TFs are never dropped.", 0},
+  {"top-variable", OPT_TOP_VARIABLE, "INT", 0, "Keep only this many of the most variable genes, in addition to the listed TFs.", 0},
+  {"min-correlation", OPT_MIN_CORRELATION, "FLOAT", 0, "Give each TF every gene it correlates with at this value or more, in (0, 1], as candidates instead of its keep best.  keep still limits the edges of the final graph.", 0},
+  {"profile", OPT_PROFILE, "FILE", OPTION_ARG_OPTIONAL, "Time each phase of the run and write the report as JSON to FILE, or to stderr if no FILE is given.", 0},
+  {"perf-counters", OPT_PERF_COUNTERS, 0, 0, "Add CPU cycles, instructions, IPC, cache misses, branch misses and last level cache loads to each phase of the profile.  Implies --profile.  Linux only; without access to the counters the profile is written without them.", 0},
+  {"trace", OPT_TRACE, "FILE", 0, "Write a Chrome trace event timeline of the worker threads to FILE, for chrome://tracing or Perfetto.  Needs a build made with TRACE=1.", 0},
+  {"max-memory", OPT_MAX_MEMORY, "SIZE", 0, "Stop with an estimate of what is needed, rather than run out of memory part way, before any phase which would take the tracked allocations past SIZE bytes.  SIZE may end in K, M, G or T.", 0},
+  {"output-format", OPT_OUTPUT_FORMAT, "STRING", 0, "Layout of the printed clusters: text (default), a \"cluster: N\" line followed by one gene per line; tsv, cluster_id, gene and order columns under a header; or jsonl, one JSON object per cluster per line.", 0},
+  {"speculate", OPT_SPECULATE, "INT", 0, "Expand seeds on every core at once, keeping only expansions a single thread would have made, so clusters are unchanged.  1 takes one seed per core, each from a different component; more takes up to INT, several from one component if need be.  By default seeds are expanded one at a time.", 0},
+  {"serial-link", OPT_SERIAL_LINK, 0, 0, "Run triple-link one seed at a time on one core, searching the whole graph for each, as it was first written.  Clusters are the same; this is much slower on large graphs, and is kept to check the parallel decomposition against.", 0},
   { 0 , 0, 0, 0, 0, 0}
 };
 
@@ -75,6 +110,7 @@ static struct argp_option options[] = {
 static error_t parse_opt(int key, char *arg, struct argp_state *state){
   config *args;
   long test;
+  char *end;
   args = (config*) state->input;
   switch(key){
     case 't':
@@ -107,14 +143,103 @@ static error_t parse_opt(int key, char *arg, struct argp_state *state){
         exit(EINVAL);
       break;
     case 'c':
-      args->corrMethod = arg;
-      if(strcmp("pearson", arg)) break;
-      if(strcmp("spearman", arg)) break;
-      else{
+      if(strcmp("pearson", arg) && strcmp("spearman", arg)
+                                            && strcmp("kendall", arg)){
         cerr << "Correlation method \"" << arg << "\" is not supported"
              << endl;
         exit(EINVAL);
       }
+      args->corrMethod = arg;
+      break;
+    case 'p':
+      if(!strcmp("f32", arg)){
+        args->singlePrecision = true;
+      }else if(!strcmp("f64", arg)){
+        args->singlePrecision = false;
+      }else{
+        cerr << "Precision \"" << arg << "\" is not supported; use f32 "
+                "or f64" << endl;
+        exit(EINVAL);
+      }
+      break;
+    case OPT_MIN_VARIANCE:
+      args->filter.minVariance = strtod(arg, &end);
+      if(end == arg || *end || 0 > args->filter.minVariance){
+        cerr << "min-variance must be a non-negative number." << endl;
+        exit(EINVAL);
+      }
+      break;
+    case OPT_MIN_MEAN:
+      args->filter.minMean = strtod(arg, &end);
+      if(end == arg || *end){
+        cerr << "min-mean must be a number." << endl;
+        exit(EINVAL);
+      }
+      break;
+    case OPT_TOP_VARIABLE:
+      test = strtol(arg, &end, 10);
+      if(end == arg || *end || 1 > test){
+        cerr << "top-variable must be a positive integer." << endl;
+        exit(EINVAL);
+      }
+      args->filter.topVariable = (size_t) test;
+      break;
+    case OPT_MIN_CORRELATION:
+      args->minCorrelation = strtod(arg, &end);
+      if(end == arg || *end || 0 >= args->minCorrelation
+                                          || 1 < args->minCorrelation){
+        cerr << "min-correlation must be in (0, 1]." << endl;
+        exit(EINVAL);
+      }
+      break;
+    case OPT_PROFILE:
+      args->profile = true;
+      args->profileFile = arg;
+      break;
+    case OPT_PERF_COUNTERS:
+      args->profile = true;
+      args->perfCounters = true;
+      break;
+    case OPT_TRACE:
+#ifdef TFCLUSTER_TRACE
+      args->traceFile = arg;
+#else
+      cerr << "--trace needs tf-cluster built with make TRACE=1" << endl;
+      exit(EINVAL);
+#endif
+      break;
+    case OPT_MAX_MEMORY:
+      args->maxMemory = strtoull(arg, &end, 10);
+      switch(toupper(*end)){
+        case 'T': args->maxMemory <<= 10; //fall through
+        case 'G': args->maxMemory <<= 10; //fall through
+        case 'M': args->maxMemory <<= 10; //fall through
+        case 'K': args->maxMemory <<= 10; end++;
+      }
+      if(end == arg || *end || 0 == args->maxMemory){
+        cerr << "max-memory must be a positive size such as 512M or 4G."
+             << endl;
+        exit(EINVAL);
+      }
+      break;
+    case OPT_OUTPUT_FORMAT:
+      if(!parseClusterFormat(arg, args->outputFormat)){
+        cerr << "Output format \"" << arg << "\" is not supported; use "
+                "text, tsv or jsonl" << endl;
+        exit(EINVAL);
+      }
+      break;
+    case OPT_SPECULATE:
+      test = strtol(arg, &end, 10);
+      if(end == arg || *end || 1 > test){
+        cerr << "speculate must be a positive integer." << endl;
+        exit(EINVAL);
+      }
+      args->speculativeSeeds = (size_t) test;
+      break;
+    case OPT_SERIAL_LINK:
+      args->serialLink = true;
+      break;
     default:
       return ARGP_ERR_UNKNOWN;
   }
@@ -127,32 +252,29 @@ static struct argp interpreter = {options, parse_opt, 0, doc, 0, 0, 0};
 
 
 ////////////////////////////////////////////////////////////////////////
-//PUBLIC FUNCTION DEFINITIONS///////////////////////////////////////////
+//PRIVATE FUNCTION DEFINITIONS//////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
 
 /*******************************************************************//**
- * Program entry point.
+ *  Everything from the correlation matrix through to the printed
+ * clusters, with the correlation matrix held as T.
  *
- * @param[in] argc number of c-strings in argv
- * @param[in] argv arguments passed to program
+ * @param[in,out] settings Parsed command line.
+ *
+ * @return Exit status for main().
  **********************************************************************/
-int main(int argc, char **argv){
+template <typename T> int runTFCluster(struct config &settings){
   graph<geneData, u8> *corrData;
-  struct config settings;
-  queue< queue<size_t> > result;
-  CMF protoGraph;
+  struct clusterWriter output;
+  correlationTable<T> protoGraph;
   UpperDiagonalSquareMatrix<u8> *sccm;
 
-  //parse input
-  settings = config{0, 0, 0, 0.0, 0.0, 0.0, 0, 0, 0, 100};
-  argp_parse(&interpreter, argc, argv, 0, 0, &settings);
-
-
-  protoGraph = generateMatrixFromFile(settings.exprData, 
-                                          settings.tflist, "spearman");
-  if(NULL == protoGraph.fullMatrix){
+  protoGraph = generateCorrelationMatrixFromFile<T>(settings.exprData,
+                settings.tflist, settings.corrMethod, settings.filter);
+  if(protoGraph.fullMatrix.empty()){
     cerr << "There was a fatal error in generating the correlation "
             "matrix" << endl;
+    return EIO;
   }
 
   if(settings.keepTopN >= protoGraph.GeneLabels.size()){
@@ -164,15 +286,74 @@ int main(int argc, char **argv){
   corrData = constructGraph(sccm, protoGraph, settings);
   delete sccm;
 
-  result = tripleLink(corrData, settings);
+  //Each cluster is printed as soon as triple-link finds it, and flushed
+  //straight away unless only a file will read it, so the phase times
+  //writing as well as linking
+  profileBeginPhase("triple_link_and_write");
+  if(!clusterWriterOpen(output, protoGraph.TFLabels,
+            settings.outputFormat, stdout, !streamIsRegularFile(stdout))){
+    cerr << "Could not allocate the output buffer" << endl;
+    return ENOMEM;
+  }
+  tripleLink(corrData, settings, clusterWriterSink, &output);
 
   delete corrData;
 
-  printClusters(result, protoGraph.TFLabels);
+  profileBeginPhase("output");
+  if(!clusterWriterClose(output)){
+    cerr << "Could not write the clusters" << endl;
+    return EIO;
+  }
+  profileEndPhase();
 
   return 0;
 }
 
+////////////////////////////////////////////////////////////////////////
+//PUBLIC FUNCTION DEFINITIONS///////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************//**
+ * Program entry point.
+ *
+ * @param[in] argc number of c-strings in argv
+ * @param[in] argv arguments passed to program
+ **********************************************************************/
+int main(int argc, char **argv){
+  struct config settings;
+  int tr;
+
+  //parse input
+  settings = config{0, 0, "spearman", false, 0.0, 0.0, 0.0, 0, 0, 0, 100,
+                      {0.0, -HUGE_VAL, 0}, 0.0, false, 0, false, 0, 0,
+                      CLUSTER_FORMAT_TEXT, 0, false};
+  argp_parse(&interpreter, argc, argv, 0, 0, &settings);
+
+  if(settings.perfCounters) profileEnableCounters();
+  else if(settings.profile) profileEnable();
+  if(NULL != settings.traceFile) traceEnable();
+  allocationSetBudget(settings.maxMemory);
+
+  if(settings.singlePrecision)
+    tr = runTFCluster<f32>(settings);
+  else
+    tr = runTFCluster<f64>(settings);
+
+  if(!profileWriteReport(settings.profileFile)){
+    cerr << "Could not write profile to \"" << settings.profileFile
+         << "\"" << endl;
+    if(!tr) tr = EIO;
+  }
+
+  if(NULL != settings.traceFile && !traceWrite(settings.traceFile)){
+    cerr << "Could not write trace to \"" << settings.traceFile << "\""
+         << endl;
+    if(!tr) tr = EIO;
+  }
+
+  return tr;
+}
+
 ////////////////////////////////////////////////////////////////////////
 //END///////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
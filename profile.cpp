@@ -0,0 +1,410 @@
+/*******************************************************************//**
+         FILE:  profile.cpp
+
+  DESCRIPTION:  Per phase timing of a run of TF-cluster, reported as
+                JSON with --profile
+
+         BUGS:  ---
+        NOTES:  Peak RSS is the process high water mark, so a phase's
+                delta is how much it raised that mark, not how much it
+                allocated.
+       AUTHOR:  Josh Marshall <jrmarsha@mtu.edu>
+      COMPANY:  Michigan technological University
+      VERSION:  See git log
+      CREATED:  See git log
+     REVISION:  See git log
+     LISCENSE:  GPLv3
+***********************************************************************/
+
+////////////////////////////////////////////////////////////////////////
+//INCLUDES//////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "allocation.hpp"
+#include "profile.hpp"
+
+////////////////////////////////////////////////////////////////////////
+//NAMESPACE USING///////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+using std::vector;
+
+////////////////////////////////////////////////////////////////////////
+//PRIVATE STRUCTS///////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************//**
+ *  Everything recorded for one phase.  Thread times are indexed by
+ * slice number, so slice i of every launch in the phase adds to entry
+ * i.
+ **********************************************************************/
+struct phaseRecord{
+  const char *name;
+  double wallStart, wallSeconds;
+  double cpuStart, cpuSeconds;
+  long peakRSSStart, peakRSSDelta;
+
+  size_t launches;
+  vector<double> threadBusy;
+  vector<double> threadIdle;
+
+  struct profileSlice mainCounters;
+  double counts[PROFILE_NUM_COUNTERS];
+  bool counted[PROFILE_NUM_COUNTERS];
+};
+
+////////////////////////////////////////////////////////////////////////
+//PRIVATE FUNCTION DECLARATIONS/////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************//**
+ *  User plus system CPU seconds of every thread in the process so far,
+ * and its peak resident set in KiB.
+ **********************************************************************/
+void processUsage(double &cpuSeconds, long &peakRSS);
+
+
+/*******************************************************************//**
+ *  Write values as a JSON array of seconds.
+ **********************************************************************/
+void writeSecondsArray(FILE *out, const vector<double> &values);
+
+
+/*******************************************************************//**
+ *  Open and start a counter group on the calling thread, leaving every
+ * fd -1 if counters are off or unavailable.  The first failure to open
+ * the group leader turns counters off for the rest of the run.  Other
+ * counters, such as LLC loads under many hypervisors, may fail on their
+ * own, leaving just their fd -1.
+ **********************************************************************/
+void openCounters(int *fds);
+
+
+/*******************************************************************//**
+ *  Stop and close a counter group, adding what it counted, scaled up
+ * for any time it was multiplexed off, to counts, and marking in
+ * counted each counter which was read.
+ **********************************************************************/
+void closeCounters(int *fds, double *counts, bool *counted);
+
+////////////////////////////////////////////////////////////////////////
+//PRIVATE VARIABLES/////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+static bool profiling = false;
+static bool phaseOpen = false;
+static vector<struct phaseRecord> phases;
+
+static bool counting = false;
+static pthread_t phaseThread;
+static pthread_mutex_t countsLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*Names in the report of the counters in a group, in group order.*/
+static const char *counterNames[PROFILE_NUM_COUNTERS] = {
+  "cycles", "instructions", "cache_misses", "branch_misses", "llc_loads"
+};
+
+////////////////////////////////////////////////////////////////////////
+//FUNCTION DEFINITIONS//////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+void processUsage(double &cpuSeconds, long &peakRSS){
+  struct rusage usage;
+
+  getrusage(RUSAGE_SELF, &usage);
+  cpuSeconds = (double) usage.ru_utime.tv_sec +
+               (double) usage.ru_utime.tv_usec / 1e6 +
+               (double) usage.ru_stime.tv_sec +
+               (double) usage.ru_stime.tv_usec / 1e6;
+  peakRSS = usage.ru_maxrss;
+}
+
+
+void writeSecondsArray(FILE *out, const vector<double> &values){
+  fprintf(out, "[");
+  for(size_t i = 0; i < values.size(); i++)
+    fprintf(out, "%s%.6f", i ? ", " : "", values[i]);
+  fprintf(out, "]");
+}
+
+
+void openCounters(int *fds){
+  for(size_t i = 0; i < PROFILE_NUM_COUNTERS; i++)
+    fds[i] = -1;
+  if(!counting) return;
+
+#ifdef __linux__
+  const unsigned int types[PROFILE_NUM_COUNTERS] = {
+    PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+    PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE
+  };
+  const unsigned long long configs[PROFILE_NUM_COUNTERS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+    PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                            (PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16)
+  };
+  struct perf_event_attr attr;
+
+  for(size_t i = 0; i < PROFILE_NUM_COUNTERS; i++){
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = types[i];
+    attr.config = configs[i];
+    attr.disabled = 0 == i;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                                        PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    fds[i] = (int) syscall(__NR_perf_event_open, &attr, 0, -1,
+                                                0 == i ? -1 : fds[0], 0);
+    if(0 == i && 0 > fds[0]){
+      //Only the first thread to get here reports it
+      pthread_mutex_lock(&countsLock);
+      if(counting)
+        fprintf(stderr, "Hardware counters unavailable (%s); profiling "
+                        "without them\n", strerror(errno));
+      counting = false;
+      pthread_mutex_unlock(&countsLock);
+      return;
+    }
+  }
+
+  ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+  counting = false;
+#endif
+}
+
+
+void closeCounters(int *fds, double *counts, bool *counted){
+  unsigned long long values[3];
+
+  if(0 > fds[0]) return;
+
+#ifdef __linux__
+  ioctl(fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+#endif
+
+  for(size_t i = 0; i < PROFILE_NUM_COUNTERS; i++){
+    if(0 > fds[i]) continue;
+    if(sizeof(values) == read(fds[i], values, sizeof(values)) &&
+                                                        0 < values[2]){
+      counts[i] += (double) values[0] *
+                            ((double) values[1] / (double) values[2]);
+      counted[i] = true;
+    }
+    close(fds[i]);
+    fds[i] = -1;
+  }
+}
+
+
+void profileEnable(){
+  profiling = true;
+}
+
+
+void profileEnableCounters(){
+  profiling = true;
+  counting = true;
+}
+
+
+bool profileEnabled(){
+  return profiling;
+}
+
+
+double profileNow(){
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double) now.tv_sec + (double) now.tv_nsec / 1e9;
+}
+
+
+void profileBeginPhase(const char *name){
+  //Value initialized so that no field is copied uninitialized
+  struct phaseRecord toAdd = phaseRecord();
+
+  if(!profiling) return;
+  profileEndPhase();
+
+  toAdd.name = name;
+
+  phaseThread = pthread_self();
+  phases.push_back(toAdd);
+  phaseOpen = true;
+
+  struct phaseRecord &current = phases.back();
+  openCounters(current.mainCounters.counterFds);
+  processUsage(current.cpuStart, current.peakRSSStart);
+  current.wallStart = profileNow();
+}
+
+
+void profileEndPhase(){
+  double cpuSeconds;
+  long peakRSS;
+
+  if(!profiling || !phaseOpen) return;
+
+  struct phaseRecord &current = phases.back();
+  current.wallSeconds = profileNow() - current.wallStart;
+  processUsage(cpuSeconds, peakRSS);
+  current.cpuSeconds = cpuSeconds - current.cpuStart;
+  current.peakRSSDelta = peakRSS - current.peakRSSStart;
+
+  pthread_mutex_lock(&countsLock);
+  closeCounters(current.mainCounters.counterFds, current.counts,
+                                                        current.counted);
+  pthread_mutex_unlock(&countsLock);
+
+  phaseOpen = false;
+}
+
+
+void profileSliceBegin(struct profileSlice &slice){
+  bool onPhaseThread = phaseOpen &&
+                              pthread_equal(phaseThread, pthread_self());
+
+  if(onPhaseThread){
+    for(size_t i = 0; i < PROFILE_NUM_COUNTERS; i++)
+      slice.counterFds[i] = -1;
+  }else{
+    openCounters(slice.counterFds);
+  }
+  slice.start = profileNow();
+}
+
+
+double profileSliceEnd(struct profileSlice &slice){
+  const double tr = profileNow() - slice.start;
+
+  if(0 <= slice.counterFds[0]){
+    pthread_mutex_lock(&countsLock);
+    if(phaseOpen)
+      closeCounters(slice.counterFds, phases.back().counts,
+                                                  phases.back().counted);
+    pthread_mutex_unlock(&countsLock);
+  }
+
+  return tr;
+}
+
+
+void profileRecordLaunch(const double *busy, size_t numThreads,
+                                                        double span){
+  if(!profiling || !phaseOpen) return;
+
+  struct phaseRecord &current = phases.back();
+  if(current.threadBusy.size() < numThreads){
+    current.threadBusy.resize(numThreads, 0);
+    current.threadIdle.resize(numThreads, 0);
+  }
+
+  current.launches++;
+  for(size_t i = 0; i < numThreads; i++){
+    current.threadBusy[i] += busy[i];
+    current.threadIdle[i] += span > busy[i] ? span - busy[i] : 0;
+  }
+}
+
+
+bool profileWriteReport(const char *path){
+  FILE *out = stderr;
+  double totalWall = 0, totalCPU = 0, cpuSeconds;
+  long peakRSS;
+
+  if(!profiling) return true;
+  profileEndPhase();
+
+  if(NULL != path){
+    out = fopen(path, "w");
+    if(NULL == out) return false;
+  }
+
+  processUsage(cpuSeconds, peakRSS);
+
+  fprintf(out, "{\n  \"counters_available\": %s,\n",
+                                            counting ? "true" : "false");
+  fprintf(out, "  \"phases\": [\n");
+  for(size_t i = 0; i < phases.size(); i++){
+    const struct phaseRecord &phase = phases[i];
+    totalWall += phase.wallSeconds;
+    totalCPU += phase.cpuSeconds;
+
+    fprintf(out, "    {\n");
+    fprintf(out, "      \"name\": \"%s\",\n", phase.name);
+    fprintf(out, "      \"wall_seconds\": %.6f,\n", phase.wallSeconds);
+    fprintf(out, "      \"cpu_seconds\": %.6f,\n", phase.cpuSeconds);
+    fprintf(out, "      \"peak_rss_delta_kib\": %ld,\n",
+                                                    phase.peakRSSDelta);
+    fprintf(out, "      \"thread_launches\": %zu,\n", phase.launches);
+    fprintf(out, "      \"thread_busy_seconds\": ");
+    writeSecondsArray(out, phase.threadBusy);
+    fprintf(out, ",\n      \"thread_idle_seconds\": ");
+    writeSecondsArray(out, phase.threadIdle);
+    //A counter which never opened is null rather than a false 0
+    if(counting){
+      fprintf(out, ",\n      \"counters\": {");
+      for(size_t c = 0; c < PROFILE_NUM_COUNTERS; c++){
+        fprintf(out, "%s\"%s\": ", c ? ", " : "", counterNames[c]);
+        if(phase.counted[c]) fprintf(out, "%.0f", phase.counts[c]);
+        else fprintf(out, "null");
+      }
+      if(phase.counted[0] && phase.counted[1] && 0 < phase.counts[0])
+        fprintf(out, ", \"ipc\": %.3f}",
+                                      phase.counts[1] / phase.counts[0]);
+      else
+        fprintf(out, ", \"ipc\": null}");
+    }
+    fprintf(out, "\n    }%s\n", i + 1 < phases.size() ? "," : "");
+  }
+  fprintf(out, "  ],\n");
+
+  fprintf(out, "  \"memory\": {\n");
+  for(int tag = 0; tag < ALLOC_NUM_TAGS; tag++){
+    size_t current, peak, count;
+    allocationUsage((enum allocationTag) tag, current, peak, count);
+    fprintf(out, "    \"%s\": {\"current_bytes\": %zu, \"peak_bytes\": "
+                 "%zu, \"allocations\": %zu},\n",
+                 allocationTagName((enum allocationTag) tag), current, peak,
+                                                                  count);
+  }
+  fprintf(out, "    \"tracked_peak_bytes\": %zu\n", allocationPeak());
+  fprintf(out, "  },\n");
+
+  fprintf(out, "  \"total\": {\n");
+  fprintf(out, "    \"wall_seconds\": %.6f,\n", totalWall);
+  fprintf(out, "    \"cpu_seconds\": %.6f,\n", totalCPU);
+  fprintf(out, "    \"peak_rss_kib\": %ld\n", peakRSS);
+  fprintf(out, "  }\n}\n");
+
+  if(stderr != out) return 0 == fclose(out);
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////
+//END///////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,136 @@
+/*******************************************************************//**
+         FILE:  profile.hpp
+
+  DESCRIPTION:  Per phase timing of a run of TF-cluster, reported as
+                JSON with --profile
+
+         BUGS:  ---
+        NOTES:  Phases are begun and ended from the main thread only.
+                Everything here is a no-op until profileEnable() is
+                called.
+       AUTHOR:  Josh Marshall <jrmarsha@mtu.edu>
+      COMPANY:  Michigan technological University
+      VERSION:  See git log
+      CREATED:  See git log
+     REVISION:  See git log
+     LISCENSE:  GPLv3
+***********************************************************************/
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+////////////////////////////////////////////////////////////////////////
+//INCLUDES//////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+#include <stddef.h>
+
+////////////////////////////////////////////////////////////////////////
+//CONSTANTS/////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*Hardware counters in a group: cycles, instructions, cache misses,
+branch misses and last level cache loads.*/
+#define PROFILE_NUM_COUNTERS 5
+
+////////////////////////////////////////////////////////////////////////
+//STRUCTS///////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************//**
+ *  One thread's measurement of a piece of work, between
+ * profileSliceBegin() and profileSliceEnd().  counterFds[0] leads its
+ * hardware counter group; a counter which could not be opened is -1.
+ **********************************************************************/
+struct profileSlice{
+  double start;
+  int counterFds[PROFILE_NUM_COUNTERS];
+};
+
+////////////////////////////////////////////////////////////////////////
+//PUBLIC FUNCTION DECLARATIONS//////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************//**
+ *  Start recording phases.
+ **********************************************************************/
+void profileEnable();
+
+
+/*******************************************************************//**
+ *  Also count cycles, instructions, cache misses, branch misses and
+ * last level cache loads per phase with perf_event_open.  If the
+ * counters cannot be opened, for instance in a container without
+ * access to them, this says so once on stderr and phases are timed
+ * without them.  Implies profileEnable().
+ **********************************************************************/
+void profileEnableCounters();
+
+
+/*******************************************************************//**
+ *  True once profileEnable() has been called.
+ **********************************************************************/
+bool profileEnabled();
+
+
+/*******************************************************************//**
+ *  Start timing a phase, ending any phase still open.  name must
+ * outlive the report.
+ **********************************************************************/
+void profileBeginPhase(const char *name);
+
+
+/*******************************************************************//**
+ *  Stop timing the current phase, if any.
+ **********************************************************************/
+void profileEndPhase();
+
+
+/*******************************************************************//**
+ *  Seconds since an arbitrary fixed point, for timing thread slices.
+ **********************************************************************/
+double profileNow();
+
+
+/*******************************************************************//**
+ *  Start measuring a slice of work on the calling thread.  Counters
+ * are only opened for threads other than the one phases are begun on,
+ * whose own counters already cover the whole phase.
+ **********************************************************************/
+void profileSliceBegin(struct profileSlice &slice);
+
+
+/*******************************************************************//**
+ *  Stop measuring a slice, adding its counters to the current phase.
+ * Safe to call from several threads at once.
+ *
+ * @return Seconds the slice ran for.
+ **********************************************************************/
+double profileSliceEnd(struct profileSlice &slice);
+
+
+/*******************************************************************//**
+ *  Account one autoThreadLauncher() call to the current phase.
+ *
+ * @param[in] busy Seconds each of the numThreads slices ran for.
+ * @param[in] numThreads Number of slices.
+ * @param[in] span Seconds from the first slice starting to the last
+ *                 one being joined; each slice was idle for the rest.
+ **********************************************************************/
+void profileRecordLaunch(const double *busy, size_t numThreads,
+                                                        double span);
+
+
+/*******************************************************************//**
+ *  Write every recorded phase, and the current and peak bytes of each
+ * allocation tag, as a JSON document to path, or to stderr if path is
+ * NULL.
+ *
+ * @return false if path could not be written.
+ **********************************************************************/
+bool profileWriteReport(const char *path);
+
+////////////////////////////////////////////////////////////////////////
+//END///////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+#endif
@@ -0,0 +1,233 @@
+#!/bin/bash
+########################################################################
+#         FILE:  regression.sh
+#
+#  DESCRIPTION:  Golden output and timing regression harness for
+#                tf-cluster
+#
+#        NOTES:  regression.sh record DIR
+#                    Runs every case and saves its clusters, wall time
+#                    and peak RSS under DIR as the golden results.
+#                regression.sh check DIR
+#                    Runs every case again and fails if any case's
+#                    clusters differ from the golden ones, or its median
+#                    wall time is more than TOLERANCE slower and at
+#                    least SLACK seconds slower.
+#
+#                Clusters are compared as a set of sets of genes, so the
+#                order of clusters and of genes within them is ignored.
+#                Either way, each case is also run once with each of
+#                VARIANTS, whose output must be byte for byte that of
+#                the plain run: --serial-link is the single threaded
+#                triple-link the parallel one must reproduce exactly.
+#                Data sets are made by synthetic-expression with fixed
+#                seeds; DATASETS may add "name:expression:tfs" entries
+#                of real data.  Peak RSS comes from tf-cluster's own
+#                --profile report.
+#
+#                Environment: TFCLUSTER (./tf-cluster), GENERATOR
+#                (./synthetic-expression), REPS (3), TOLERANCE (0.05),
+#                SLACK (0.02), DATASETS.
+#       AUTHOR:  Josh Marshall <jrmarsha@mtu.edu>
+#      COMPANY:  Michigan technological University
+#      VERSION:  See git log
+#      CREATED:  See git log
+#     REVISION:  See git log
+#     LISCENSE:  GPLv3
+########################################################################
+
+TFCLUSTER=${TFCLUSTER:-./tf-cluster}
+GENERATOR=${GENERATOR:-./synthetic-expression}
+REPS=${REPS:-3}
+TOLERANCE=${TOLERANCE:-0.05}
+SLACK=${SLACK:-0.02}
+
+#Parameters each data set is run with
+PARAMETERS=(
+  "-c spearman -k 100"
+  "-c pearson -k 50"
+  "-c kendall -k 100"
+  "-c spearman -k 100 -p f32"
+  "-c spearman -k 100 --min-correlation 0.5"
+  "-c pearson -k 100 --top-variable 2000"
+)
+
+#Options which must not change a byte of the output
+VARIANTS=(
+  "--serial-link"
+  "--speculate 1"
+  "--speculate 4"
+)
+
+#Synthetic data sets: name and synthetic-expression arguments
+SYNTHETIC=(
+  "small:-g 2000 -s 40 -t 200 -m 8 -z 30 --module-tfs 6 --seed 1"
+  "medium:-g 10000 -s 100 -t 500 -m 20 -z 50 --seed 2"
+  "noisy:-g 10000 -s 60 -t 400 -m 20 -z 40 -n 2 --seed 3"
+)
+
+########################################################################
+
+usage(){
+  echo "usage: $0 record|check DIR" >&2
+  exit 22
+}
+
+
+#Clusters on stdin as one sorted line of sorted genes per cluster
+canonicalClusters(){
+  awk '/^cluster/{c++; next} NF{print c "\t" $1}' |
+    LC_ALL=C sort -t "$(printf '\t')" -k1,1n -k2,2 |
+    awk -F '\t' '$1 != last{if(NR > 1) print line; line = $2; last = $1;
+                            next}
+                 {line = line " " $2}
+                 END{if(NR) print line}' |
+    LC_ALL=C sort
+}
+
+
+#Every data set as "name:expression:tfs", generating missing ones
+dataSets(){
+  local entry name
+  mkdir -p "$DIR/data"
+  for entry in "${SYNTHETIC[@]}"; do
+    name=${entry%%:*}
+    if [ ! -f "$DIR/data/$name-expression.txt" ]; then
+      $GENERATOR -o "$DIR/data/$name" ${entry#*:} 2>/dev/null || {
+        echo "Could not generate $name with $GENERATOR" >&2
+        exit 5
+      }
+    fi
+    echo "$name:$DIR/data/$name-expression.txt:$DIR/data/$name-tfs.txt"
+  done
+  for entry in $DATASETS; do
+    echo "$entry"
+  done
+}
+
+
+#Run one case REPS times; writes clusters to $1 and prints
+#"median wall seconds" "peak RSS KiB"
+runCase(){
+  local clusters=$1 expression=$2 tfs=$3 parameters=$4
+  local times=() peak=0 start end rss rep
+
+  for ((rep = 0; rep < REPS; rep++)); do
+    start=$(date +%s%N)
+    $TFCLUSTER -e "$expression" -t "$tfs" -1 1.5 -2 1.2 -3 0.8 \
+        $parameters --profile="$DIR/profile.json" 2>/dev/null \
+        > "$clusters" || return 1
+    end=$(date +%s%N)
+    times+=($(((end - start) / 1000)))
+    rss=$(sed -n 's/.*"peak_rss_kib": \([0-9]*\).*/\1/p' \
+                                                    "$DIR/profile.json")
+    [ "${rss:-0}" -gt "$peak" ] && peak=$rss
+  done
+
+  printf "%s\n" "${times[@]}" | sort -n |
+    awk -v peak="$peak" '{t[NR] = $1}
+        END{m = NR % 2 ? t[(NR + 1) / 2] : (t[NR / 2] + t[NR / 2 + 1]) / 2;
+            printf "%.6f %d\n", m / 1e6, peak}'
+}
+
+
+#Run one case once more with variant added; fails unless its clusters
+#are byte for byte those in $1
+sameOutput(){
+  local reference=$1 expression=$2 tfs=$3 parameters=$4 variant=$5
+
+  $TFCLUSTER -e "$expression" -t "$tfs" -1 1.5 -2 1.2 -3 0.8 \
+      $parameters $variant 2>/dev/null | cmp -s - "$reference"
+}
+
+########################################################################
+
+[ 2 -eq $# ] || usage
+MODE=$1
+DIR=$2
+[ "record" = "$MODE" ] || [ "check" = "$MODE" ] || usage
+[ -x "$TFCLUSTER" ] || { echo "No tf-cluster at $TFCLUSTER" >&2; exit 2; }
+if [ "check" = "$MODE" ] && [ ! -f "$DIR/golden/timings.tsv" ]; then
+  echo "No golden results in $DIR; run $0 record $DIR first" >&2
+  exit 2
+fi
+
+mkdir -p "$DIR/golden" "$DIR/current"
+OUT=$DIR/current
+[ "record" = "$MODE" ] && OUT=$DIR/golden
+printf "#case\twall_seconds\tpeak_rss_kib\n" > "$OUT/timings.tsv"
+
+dataSets > "$DIR/datasets.txt"
+
+failures=0
+printf "%-44s %10s %10s %8s %10s  %s\n" case golden wall ratio "rss KiB" \
+                                                                  clusters
+while IFS=: read -r name expression tfs; do
+  for ((p = 0; p < ${#PARAMETERS[@]}; p++)); do
+    parameters=${PARAMETERS[$p]}
+    caseName=$name$(echo " $parameters" | tr -s ' -' '_')
+    raw=$DIR/raw.out
+
+    if ! result=$(runCase "$raw" "$expression" "$tfs" "$parameters"); then
+      printf "%-44s %s\n" "$caseName" "FAILED TO RUN"
+      failures=$((failures + 1))
+      continue
+    fi
+    canonicalClusters < "$raw" > "$OUT/$caseName.clusters"
+    read -r wall rss <<< "$result"
+    for variant in "${VARIANTS[@]}"; do
+      if ! sameOutput "$raw" "$expression" "$tfs" "$parameters" \
+                                                          "$variant"; then
+        printf "%-44s %s\n" "$caseName" "DIFFERS WITH $variant"
+        failures=$((failures + 1))
+      fi
+    done
+    printf "%s\t%s\t%s\n" "$caseName" "$wall" "$rss" >> "$OUT/timings.tsv"
+
+    if [ "record" = "$MODE" ]; then
+      printf "%-44s %10s %10.3f %8s %10d  %s\n" "$caseName" - "$wall" - \
+          "$rss" "$(wc -l < "$OUT/$caseName.clusters") recorded"
+      continue
+    fi
+
+    golden=$(awk -v c="$caseName" '$1 == c{print $2}' \
+                                                "$DIR/golden/timings.tsv")
+    status=match
+    if [ -z "$golden" ]; then
+      status="no golden"
+    elif ! cmp -s "$DIR/golden/$caseName.clusters" \
+                                            "$OUT/$caseName.clusters"; then
+      status=MISMATCH
+      failures=$((failures + 1))
+    fi
+
+    ratio=-
+    if [ -n "$golden" ]; then
+      ratio=$(awk -v a="$wall" -v b="$golden" 'BEGIN{printf "%.3f",
+                                                  0 < b ? a / b : 1}')
+      if awk -v a="$wall" -v b="$golden" -v t="$TOLERANCE" \
+             -v s="$SLACK" 'BEGIN{exit !(a > b * (1 + t) && a > b + s)}'
+      then
+        status="$status, SLOWER"
+        failures=$((failures + 1))
+      fi
+    fi
+
+    printf "%-44s %10.3f %10.3f %8s %10d  %s\n" "$caseName" \
+                          "${golden:-0}" "$wall" "$ratio" "$rss" "$status"
+  done
+done < "$DIR/datasets.txt"
+
+rm -f "$DIR/raw.out" "$DIR/profile.json" "$DIR/datasets.txt"
+
+if [ "check" = "$MODE" ]; then
+  if [ 0 -ne $failures ]; then
+    echo "$failures case(s) changed clusters or were slower" >&2
+    exit 1
+  fi
+  echo "All cases match and none are slower" >&2
+elif [ 0 -ne $failures ]; then
+  echo "$failures case(s) differ between variants" >&2
+  exit 1
+fi
+exit 0
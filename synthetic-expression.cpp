@@ -0,0 +1,292 @@
+/*******************************************************************//**
+         FILE:  synthetic-expression.cpp
+
+  DESCRIPTION:  Writes a synthetic expression file and TF list with
+                planted co-expression modules, and the TF clusters those
+                modules should be recovered as
+
+         BUGS:  ---
+        NOTES:  Each module follows its own random signal over the
+                samples; a member gene is that signal scaled by a
+                loading near 1 plus Gaussian noise, and every other gene
+                is noise alone, both offset by a per gene mean.  The
+                ground truth lists each module's TFs in the format
+                tf-cluster prints clusters in.  Output for a given seed
+                is the same on every run.
+       AUTHOR:  Josh Marshall <jrmarsha@mtu.edu>
+      COMPANY:  Michigan technological University
+      VERSION:  See git log
+      CREATED:  See git log
+     REVISION:  See git log
+     LISCENSE:  GPLv3
+***********************************************************************/
+
+////////////////////////////////////////////////////////////////////////
+//INCLUDES//////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+#include <algorithm>
+#include <argp.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "auxillaryUtilities.hpp"
+
+////////////////////////////////////////////////////////////////////////
+//NAMESPACE USING///////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+using std::cerr;
+using std::endl;
+using std::string;
+using std::vector;
+
+////////////////////////////////////////////////////////////////////////
+//PRIVATE STRUCTS///////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************//**
+ *  Shape of the data set to write.
+ **********************************************************************/
+struct generatorSettings{
+  size_t genes;
+  size_t samples;
+  size_t tfs;
+  size_t modules;
+  size_t moduleSize;
+  size_t moduleTFs;
+  f64 noise;
+  u64 seed;
+  cs8 *prefix;
+};
+
+////////////////////////////////////////////////////////////////////////
+//PRIVATE FUNCTION DECLARATIONS/////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************//**
+ *  Open prefix + suffix for writing with a large buffer, exiting with
+ * EIO if it cannot be.
+ **********************************************************************/
+FILE *openOutput(const string &prefix, const char *suffix);
+
+
+/*******************************************************************//**
+ *  Flush and close out, exiting with EIO if anything was not written.
+ **********************************************************************/
+void closeOutput(FILE *out);
+
+
+/*******************************************************************//**
+ *  Argp option parser.
+ **********************************************************************/
+static error_t parse_opt(int key, char *arg, struct argp_state *state);
+
+////////////////////////////////////////////////////////////////////////
+//PRIVATE VARIABLES/////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+cs8 *doc = "synthetic-expression writes PREFIX-expression.txt, "
+"PREFIX-tfs.txt and PREFIX-truth.txt: an expression file with planted "
+"co-expression modules, a TF list, and the TF clusters the modules "
+"should be found as, in tf-cluster's output format.";
+
+
+/*Keys for options which only have a long form.*/
+enum longOnlyOptions{
+  OPT_MODULE_TFS = 256,
+  OPT_SEED
+};
+
+
+static struct argp_option options[] = {
+  {"output", 'o', "PREFIX", 0, "Prefix of the three files written.  Required.", 0},
+  {"genes", 'g', "INT", 0, "Genes in the expression file.  Defaults to 10000.", 0},
+  {"samples", 's', "INT", 0, "Samples per gene.  Defaults to 100.", 0},
+  {"tfs", 't', "INT", 0, "Genes listed as TFs.  Defaults to 500.", 0},
+  {"modules", 'm', "INT", 0, "Planted co-expression modules.  Defaults to 20.", 0},
+  {"module-size", 'z', "INT", 0, "Genes in each module, TFs included.  Defaults to 50.", 0},
+  {"module-tfs", OPT_MODULE_TFS, "INT", 0, "TFs in each module; the rest of the TFs are background genes.  Defaults to 10.", 0},
+  {"noise", 'n', "FLOAT", 0, "Standard deviation of the noise added to module genes, against a module signal of 1.  Defaults to 1.", 0},
+  {"seed", OPT_SEED, "INT", 0, "Random seed.  Defaults to 1.", 0},
+  { 0 , 0, 0, 0, 0, 0}
+};
+
+
+static struct argp interpreter = {options, parse_opt, 0, doc, 0, 0, 0};
+
+////////////////////////////////////////////////////////////////////////
+//FUNCTION DEFINITIONS//////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+FILE *openOutput(const string &prefix, const char *suffix){
+  const string path = prefix + suffix;
+  FILE *tr = fopen(path.c_str(), "w");
+
+  if(NULL == tr){
+    cerr << "Could not write \"" << path << "\"" << endl;
+    exit(EIO);
+  }
+  setvbuf(tr, NULL, _IOFBF, 1 << 20);
+
+  return tr;
+}
+
+
+void closeOutput(FILE *out){
+  if(ferror(out) || fclose(out)){
+    cerr << "Could not finish writing output" << endl;
+    exit(EIO);
+  }
+}
+
+
+static error_t parse_opt(int key, char *arg, struct argp_state *state){
+  struct generatorSettings *args =
+                              (struct generatorSettings*) state->input;
+  char *end;
+  unsigned long long test;
+
+  switch(key){
+    case 'o':
+      args->prefix = arg;
+      break;
+    case 'g':
+    case 's':
+    case 't':
+    case 'm':
+    case 'z':
+    case OPT_MODULE_TFS:
+    case OPT_SEED:
+      test = strtoull(arg, &end, 10);
+      if(end == arg || *end || (OPT_SEED != key && 0 == test)){
+        cerr << "Counts must be positive integers." << endl;
+        exit(EINVAL);
+      }
+      if('g' == key) args->genes = test;
+      if('s' == key) args->samples = test;
+      if('t' == key) args->tfs = test;
+      if('m' == key) args->modules = test;
+      if('z' == key) args->moduleSize = test;
+      if(OPT_MODULE_TFS == key) args->moduleTFs = test;
+      if(OPT_SEED == key) args->seed = test;
+      break;
+    case 'n':
+      args->noise = strtod(arg, &end);
+      if(end == arg || *end || 0 > args->noise){
+        cerr << "noise must be a non-negative number." << endl;
+        exit(EINVAL);
+      }
+      break;
+    default:
+      return ARGP_ERR_UNKNOWN;
+  }
+
+  return 0;
+}
+
+
+int main(int argc, char **argv){
+  struct generatorSettings settings = {10000, 100, 500, 20, 50, 10, 1.0,
+                                                                  1, 0};
+  FILE *out;
+
+  argp_parse(&interpreter, argc, argv, 0, 0, &settings);
+
+  csize_t numPlanted = settings.modules * settings.moduleSize;
+  if(NULL == settings.prefix){
+    cerr << "An output prefix must be given with -o." << endl;
+    return EINVAL;
+  }
+  if(2 > settings.samples || numPlanted > settings.genes ||
+     settings.tfs > settings.genes ||
+     settings.moduleTFs > settings.moduleSize ||
+     settings.modules * settings.moduleTFs > settings.tfs ||
+     settings.tfs - settings.modules * settings.moduleTFs >
+                                          settings.genes - numPlanted){
+    cerr << "Modules must fit in the genes, their TFs in the TFs, the "
+         << "other TFs in the other genes, and there must be at least 2 "
+         << "samples." << endl;
+    return EINVAL;
+  }
+
+  std::mt19937_64 rng(settings.seed);
+  std::normal_distribution<f64> gaussian(0.0, 1.0);
+  std::uniform_real_distribution<f64> baseline(4.0, 12.0);
+  std::uniform_real_distribution<f64> loading(0.8, 1.2);
+
+  //Genes are assigned to modules in a random order, so that neither
+  //modules nor TFs are contiguous in the file
+  vector<size_t> order(settings.genes);
+  for(size_t i = 0; i < settings.genes; i++)
+    order[i] = i;
+  std::shuffle(order.begin(), order.end(), rng);
+
+  //module[gene] is the gene's module, or SIZE_MAX in the background
+  vector<size_t> module(settings.genes, SIZE_MAX);
+  vector<bool> isTF(settings.genes, false);
+  for(size_t m = 0; m < settings.modules; m++)
+    for(size_t i = 0; i < settings.moduleSize; i++){
+      csize_t gene = order[m * settings.moduleSize + i];
+      module[gene] = m;
+      if(i < settings.moduleTFs) isTF[gene] = true;
+    }
+  for(size_t i = 0; i < settings.tfs - settings.modules *
+                                                settings.moduleTFs; i++)
+    isTF[order[numPlanted + i]] = true;
+
+  vector<f64> signals(settings.modules * settings.samples);
+  for(size_t i = 0; i < signals.size(); i++)
+    signals[i] = gaussian(rng);
+
+  const string prefix = settings.prefix;
+
+  out = openOutput(prefix, "-expression.txt");
+  for(size_t g = 0; g < settings.genes; g++){
+    cf64 mean = baseline(rng);
+    fprintf(out, "G%zu", g);
+    if(SIZE_MAX == module[g]){
+      for(size_t s = 0; s < settings.samples; s++)
+        fprintf(out, " %.4f", mean + gaussian(rng));
+    }else{
+      cf64 *signal = &signals[module[g] * settings.samples];
+      cf64 scale = loading(rng);
+      for(size_t s = 0; s < settings.samples; s++)
+        fprintf(out, " %.4f", mean + scale * signal[s] +
+                                          settings.noise * gaussian(rng));
+    }
+    fprintf(out, "\n");
+  }
+  closeOutput(out);
+
+  out = openOutput(prefix, "-tfs.txt");
+  for(size_t g = 0; g < settings.genes; g++)
+    if(isTF[g]) fprintf(out, "G%zu\n", g);
+  closeOutput(out);
+
+  out = openOutput(prefix, "-truth.txt");
+  for(size_t m = 0; m < settings.modules; m++){
+    vector<size_t> members(order.begin() + m * settings.moduleSize,
+          order.begin() + m * settings.moduleSize + settings.moduleTFs);
+    std::sort(members.begin(), members.end());
+    fprintf(out, "cluster: %zu\n", m + 1);
+    for(size_t i = 0; i < members.size(); i++)
+      fprintf(out, "G%zu\n", members[i]);
+  }
+  closeOutput(out);
+
+  cerr << "Wrote " << settings.genes << " genes by " << settings.samples
+       << " samples, " << settings.tfs << " TFs and " << settings.modules
+       << " modules to " << prefix << "-*.txt" << endl;
+
+  return 0;
+}
+
+////////////////////////////////////////////////////////////////////////
+//END///////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,229 @@
+/*******************************************************************//**
+         FILE:  trace.cpp
+
+  DESCRIPTION:  Scoped spans of work written out as a Chrome trace event
+                timeline with --trace
+
+         BUGS:  ---
+        NOTES:  Each thread writes only to its own ring buffer, so
+                recording a span takes no lock.  The registry lock is
+                only taken when a thread first records a span or exits.
+       AUTHOR:  Josh Marshall <jrmarsha@mtu.edu>
+      COMPANY:  Michigan technological University
+      VERSION:  See git log
+      CREATED:  See git log
+     REVISION:  See git log
+     LISCENSE:  GPLv3
+***********************************************************************/
+
+////////////////////////////////////////////////////////////////////////
+//INCLUDES//////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <vector>
+
+#include "trace.hpp"
+
+////////////////////////////////////////////////////////////////////////
+//NAMESPACE USING///////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+using std::vector;
+
+////////////////////////////////////////////////////////////////////////
+//PRIVATE CONSTANTS/////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*Spans kept per thread; older ones are overwritten.  A power of 2.*/
+static const size_t TRACE_RING_EVENTS = 1 << 15;
+
+////////////////////////////////////////////////////////////////////////
+//PRIVATE STRUCTS///////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+struct traceEvent{
+  const char *name;
+  unsigned long long start;
+  unsigned long long duration;
+};
+
+
+/*******************************************************************//**
+ *  One thread's spans.  count only grows; the newest span is at
+ * events[(count - 1) % TRACE_RING_EVENTS].
+ **********************************************************************/
+struct traceBuffer{
+  size_t lane;
+  size_t count;
+  struct traceEvent *events;
+};
+
+
+/*******************************************************************//**
+ *  Owns the calling thread's buffer and hands it back to the free list
+ * when the thread exits.
+ **********************************************************************/
+struct traceThreadHandle{
+  struct traceBuffer *buffer;
+  ~traceThreadHandle();
+};
+
+////////////////////////////////////////////////////////////////////////
+//PRIVATE FUNCTION DECLARATIONS/////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************//**
+ *  Nanoseconds since an arbitrary fixed point.
+ **********************************************************************/
+unsigned long long traceNow();
+
+
+/*******************************************************************//**
+ *  The calling thread's buffer, taking one from the free list or
+ * making a new one the first time.  NULL if it could not be allocated.
+ **********************************************************************/
+struct traceBuffer *threadBuffer();
+
+////////////////////////////////////////////////////////////////////////
+//PRIVATE VARIABLES/////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+static bool tracing = false;
+static unsigned long long traceStart = 0;
+
+static pthread_mutex_t registryLock = PTHREAD_MUTEX_INITIALIZER;
+static vector<struct traceBuffer*> allBuffers;
+static vector<struct traceBuffer*> freeBuffers;
+
+static thread_local struct traceThreadHandle localHandle = {NULL};
+
+////////////////////////////////////////////////////////////////////////
+//FUNCTION DEFINITIONS//////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+unsigned long long traceNow(){
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (unsigned long long) now.tv_sec * 1000000000ULL +
+                                      (unsigned long long) now.tv_nsec;
+}
+
+
+traceThreadHandle::~traceThreadHandle(){
+  if(NULL == buffer) return;
+
+  pthread_mutex_lock(&registryLock);
+  freeBuffers.push_back(buffer);
+  pthread_mutex_unlock(&registryLock);
+  buffer = NULL;
+}
+
+
+struct traceBuffer *threadBuffer(){
+  struct traceBuffer *tr = localHandle.buffer;
+  void *tmpPtr;
+
+  if(NULL != tr) return tr;
+
+  pthread_mutex_lock(&registryLock);
+  if(!freeBuffers.empty()){
+    tr = freeBuffers.back();
+    freeBuffers.pop_back();
+  }else{
+    tmpPtr = malloc(sizeof(*tr));
+    tr = (struct traceBuffer*) tmpPtr;
+    tmpPtr = malloc(sizeof(*tr->events) * TRACE_RING_EVENTS);
+    if(NULL == tr || NULL == tmpPtr){
+      free(tr);
+      free(tmpPtr);
+      pthread_mutex_unlock(&registryLock);
+      return NULL;
+    }
+    tr->events = (struct traceEvent*) tmpPtr;
+    tr->lane = allBuffers.size();
+    tr->count = 0;
+    allBuffers.push_back(tr);
+  }
+  pthread_mutex_unlock(&registryLock);
+
+  localHandle.buffer = tr;
+  return tr;
+}
+
+
+traceScope::traceScope(const char *spanName){
+  name = spanName;
+  start = tracing ? traceNow() : 0;
+}
+
+
+traceScope::~traceScope(){
+  if(!tracing || 0 == start) return;
+
+  struct traceBuffer *buffer = threadBuffer();
+  if(NULL == buffer) return;
+
+  struct traceEvent &slot =
+              buffer->events[buffer->count & (TRACE_RING_EVENTS - 1)];
+  slot.name = name;
+  slot.start = start;
+  slot.duration = traceNow() - start;
+  buffer->count++;
+}
+
+
+void traceEnable(){
+  //The enabling thread takes lane 0, so it is the one labelled main
+  threadBuffer();
+  traceStart = traceNow();
+  tracing = true;
+}
+
+
+bool traceWrite(const char *path){
+  FILE *out;
+  bool first = true;
+
+  out = fopen(path, "w");
+  if(NULL == out) return false;
+
+  tracing = false;
+
+  pthread_mutex_lock(&registryLock);
+  fprintf(out, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+  for(size_t b = 0; b < allBuffers.size(); b++){
+    const struct traceBuffer *buffer = allBuffers[b];
+    const size_t kept = buffer->count < TRACE_RING_EVENTS ?
+                                      buffer->count : TRACE_RING_EVENTS;
+
+    fprintf(out, "%s{\"name\": \"thread_name\", \"ph\": \"M\", "
+                 "\"pid\": 1, \"tid\": %zu, \"args\": {\"name\": "
+                 "\"%s %zu\"}}", first ? "" : ",\n", buffer->lane,
+                    0 == buffer->lane ? "main" : "worker", buffer->lane);
+    first = false;
+
+    for(size_t i = buffer->count - kept; i < buffer->count; i++){
+      const struct traceEvent &event =
+                              buffer->events[i & (TRACE_RING_EVENTS - 1)];
+      if(event.start < traceStart) continue;
+      fprintf(out, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, "
+                   "\"tid\": %zu, \"ts\": %.3f, \"dur\": %.3f}",
+                   event.name, buffer->lane,
+                   (double) (event.start - traceStart) / 1e3,
+                   (double) event.duration / 1e3);
+    }
+  }
+  fprintf(out, "\n]}\n");
+  pthread_mutex_unlock(&registryLock);
+
+  return 0 == fclose(out);
+}
+
+////////////////////////////////////////////////////////////////////////
+//END///////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
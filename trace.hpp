@@ -0,0 +1,100 @@
+/*******************************************************************//**
+         FILE:  trace.hpp
+
+  DESCRIPTION:  Scoped spans of work written out as a Chrome trace event
+                timeline with --trace
+
+         BUGS:  ---
+        NOTES:  Spans only exist in builds made with TRACE=1, which
+                defines TFCLUSTER_TRACE; otherwise TRACE_SCOPE() and
+                TRACE_MUTEX_LOCK() compile down to nothing and a plain
+                lock.
+       AUTHOR:  Josh Marshall <jrmarsha@mtu.edu>
+      COMPANY:  Michigan technological University
+      VERSION:  See git log
+      CREATED:  See git log
+     REVISION:  See git log
+     LISCENSE:  GPLv3
+***********************************************************************/
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+////////////////////////////////////////////////////////////////////////
+//INCLUDES//////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+#include <pthread.h>
+
+////////////////////////////////////////////////////////////////////////
+//MACROS////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#ifdef TFCLUSTER_TRACE
+
+/*Record a span named name from here to the end of the enclosing scope.*/
+#define TRACE_SCOPE(name) \
+          traceScope TRACE_CONCAT(traceScopeAt, __LINE__)(name)
+
+/*Lock mutex, recording a span only if the lock had to be waited for.*/
+#define TRACE_MUTEX_LOCK(mutex, name) \
+          do{ \
+            if(pthread_mutex_trylock(mutex)){ \
+              TRACE_SCOPE(name); \
+              pthread_mutex_lock(mutex); \
+            } \
+          }while(0)
+
+#else
+
+#define TRACE_SCOPE(name) do{}while(0)
+#define TRACE_MUTEX_LOCK(mutex, name) pthread_mutex_lock(mutex)
+
+#endif
+
+////////////////////////////////////////////////////////////////////////
+//CLASS DEFINITION//////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************//**
+ *  Records the span of its own lifetime into the calling thread's ring
+ * buffer.  Use through TRACE_SCOPE().
+ **********************************************************************/
+class traceScope{
+  private:
+  const char *name;
+  unsigned long long start;
+
+  public:
+  traceScope(const char *spanName);
+  ~traceScope();
+};
+
+////////////////////////////////////////////////////////////////////////
+//PUBLIC FUNCTION DECLARATIONS//////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************//**
+ *  Start recording spans.  Spans before this are dropped.
+ **********************************************************************/
+void traceEnable();
+
+
+/*******************************************************************//**
+ *  Write every span still held in a ring buffer to path in the Chrome
+ * trace event format, readable by chrome://tracing and Perfetto.  Each
+ * ring buffer is one thread of the timeline; buffers are handed from
+ * exiting worker threads to new ones, so a timeline thread is a worker
+ * slot rather than one pthread.
+ *
+ * @return false if path could not be written.
+ **********************************************************************/
+bool traceWrite(const char *path);
+
+////////////////////////////////////////////////////////////////////////
+//END///////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+#endif
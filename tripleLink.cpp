@@ -17,160 +17,332 @@
 //INCLUDES//////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
 
+#include <atomic>
+#include <csignal>
 #include <queue>
+#include <set>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "auxillaryUtilities.hpp"
 #include "edge.t.hpp"
 #include "vertex.t.hpp"
 #include "graph.t.hpp"
+#include "trace.hpp"
 
 ////////////////////////////////////////////////////////////////////////
 //NAMESPACE USING///////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
 
-using std::queue;
+using std::atomic;
+using std::pair;
+using std::priority_queue;
+using std::set;
+using std::thread;
+using std::unordered_map;
+using std::unordered_set;
 using std::vector;
 
+////////////////////////////////////////////////////////////////////////
+//PRIVATE CONSTANTS/////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*Marks a vertex gets as it is reached over edges of each strength.*/
+static cu8 THREE_SIGMA_LINK = 1;
+static cu8 TWO_SIGMA_LINK = 2;
+static cu8 ONE_SIGMA_LINK = 4;
+
+/*Marks a vertex needs to join the cluster in each phase.*/
+static cu8 SINGLE_LINKED = THREE_SIGMA_LINK;
+static cu8 DOUBLE_LINKED = THREE_SIGMA_LINK | TWO_SIGMA_LINK;
+static cu8 TRIPLE_LINKED = THREE_SIGMA_LINK | TWO_SIGMA_LINK |
+                                                          ONE_SIGMA_LINK;
+
+////////////////////////////////////////////////////////////////////////
+//PRIVATE STRUCTS///////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+/*******************************************************************//**
+ *  Triple-link marks of every vertex, held in arrays by name index
+ * rather than in the scattered vertexes.  A vertex's marks only count
+ * if its stamp is the current epoch, so moving to a new epoch clears
+ * every mark at once.  Also the work queues of name indexes an
+ * expansion reuses.
+ **********************************************************************/
+struct linkState{
+  u8 *marks;
+  u32 *stamps;
+  u32 epoch;
+  size_t size;
+
+  vector<size_t> toProcessPrimer;
+  vector<size_t> toProcessMain;
+};
+
+
+/*******************************************************************//**
+ *  The order a single thread decomposing the whole graph takes things
+ * in, kept up to date as the graph changes so that it need not be
+ * searched for them after every cluster.  Seeds are taken strongest
+ * first, and among equals the one with the highest index, as
+ * strongestEdge() takes them.  strongest holds the weight and index of
+ * every edge, the next seed on top, along with entries left behind by
+ * removals, whose index now holds an edge of another weight or none;
+ * these are dropped as they surface.  dirty holds the index of each
+ * vertex which has lost an edge since it was last found strong enough
+ * to keep, which are the only ones removeWeakVerticies() could remove.
+ **********************************************************************/
+struct linkOrder{
+  graph<geneData, u8> *geneNetwork;
+  priority_queue<pair<u8, size_t> > strongest;
+  set<size_t> dirty;
+};
+
+
+/*******************************************************************//**
+ *  Triple-link's view of a graph it changes as it goes, keeping order
+ * up to date with each change unless order is NULL.
+ **********************************************************************/
+struct directView{
+  graph<geneData, u8> *geneNetwork;
+  struct linkState *state;
+  struct linkOrder *order;
+
+  size_t numEdges(vertex<geneData, u8> *target){
+    return target->getNumEdges();
+  }
+
+  edge<geneData, u8>* edgeAt(vertex<geneData, u8> *target, size_t i){
+    return target->getEdges()[i];
+  }
+
+  u8& marks(vertex<geneData, u8> *target);
+
+  void removeEdge(edge<geneData, u8> *toRemove);
+  void removeVertex(vertex<geneData, u8> *toRemove);
+
+  vertex<geneData, u8>* find(csize_t nameIndex){
+    return geneNetwork->getVertexForValue(geneData(nameIndex));
+  }
+};
+
+
+/*******************************************************************//**
+ *  Triple-link's view of a graph shared with other threads, which it
+ * must leave unchanged.  Reads fall through to the graph until a
+ * vertex's edges change, when they are copied here and changed in the
+ * same way the graph would change them; marks are kept in a linkState
+ * of its own.  Each
+ * change is logged in changes, an edge or a vertex, so that it can be
+ * replayed on the graph later, and each vertex whose edges or presence
+ * were looked at is noted in read, so that the expansion can be
+ * checked against changes made to the graph since.
+ **********************************************************************/
+struct speculativeView{
+  graph<geneData, u8> *geneNetwork;
+  unordered_map<vertex<geneData, u8>*, vector<edge<geneData, u8>*> >
+                                                                  edges;
+  struct linkState *state;
+  unordered_set<vertex<geneData, u8>*> removed;
+  unordered_set<vertex<geneData, u8>*> read;
+  vector<pair<edge<geneData, u8>*, vertex<geneData, u8>*> > changes;
+  vector<size_t> members;
+
+  size_t numEdges(vertex<geneData, u8> *target);
+  edge<geneData, u8>* edgeAt(vertex<geneData, u8> *target, size_t i);
+  u8& marks(vertex<geneData, u8> *target);
+  void removeEdge(edge<geneData, u8> *toRemove);
+  void removeVertex(vertex<geneData, u8> *toRemove);
+  vertex<geneData, u8>* find(csize_t nameIndex);
+
+  /*target's edges, copied here to be changed.*/
+  vector<edge<geneData, u8>*>& ownEdges(vertex<geneData, u8> *target);
+
+  /*Take toRemove out of its vertexes' copied edges without logging it.*/
+  void dropEdge(edge<geneData, u8> *toRemove);
+
+  /*Forget everything, ready for another expansion.*/
+  void clear();
+};
+
+
+/*******************************************************************//**
+ *  Seeds being expanded at once, each into its own view of the graph.
+ **********************************************************************/
+struct speculateHelperStruct{
+  edge<geneData, u8> **seeds;
+  struct speculativeView *views;
+  size_t numSeeds;
+  atomic<size_t> nextSeed;
+  u8 threeSigma, twoSigma;
+};
+
+
+struct unionFindHelperStruct{
+  graph<geneData, u8> *geneNetwork;
+  atomic<size_t> *parents;
+};
+
 ////////////////////////////////////////////////////////////////////////
 //PRIVATE FUNCTION DECLARATIONS/////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
 
 /*******************************************************************//**
- *  Expand a cluster using the triple-link heuristic, and return a
- * queue of name indexes found, while removing those vertexes the
- * indexes came from from the graph.
+ *  Expand a cluster using the triple-link heuristic, and add the name
+ * indexes found to clusters as a new cluster, while removing those
+ * vertexes the indexes came from from the graph.
  *
  * @param[in,out] geneNetwork Graph of interconnected genes
+ * @param[in,out] state Marks and work queues to use.
+ * @param[in,out] order Order of geneNetwork to take the seed from and
+ *                      keep up to date, or NULL to search for it.
  * @param[in] threeSigma High connection value for edges.
  * @param[in] twoSigma Medium connection value for edges.
+ * @param[in,out] clusters Clusters found so far.
  **********************************************************************/
-queue<size_t> tripleLinkIteration(graph<geneData, u8> *geneNetwork,
-                                        cu8 threeSigma, cu8 twoSigma);
+void tripleLinkIteration(graph<geneData, u8> *geneNetwork,
+          struct linkState &state, struct linkOrder *order,
+          cu8 threeSigma, cu8 twoSigma, struct clusterList &clusters);
 
 
 /*******************************************************************//**
- *  Mark vertex as reached as appropriate and return true if edge can be
- * safely removed.  Requires only a single connection to be considered
- * reached.
- *
- * @param[in] edgeWeight The weight of the edge connecting the outgoing
- *                       vertex.
- * @param[in,out] toMark The outgoing vertex to mark.
- * @param[in] high High value edge weight cutoff.
- * @param[in] med medium value edge weight cutoff.
- * @param[out] toProcess Processing queue should toMark becomes well
- *                       connected.
+ *  Index of the edge triple-link grows the next cluster from: the last
+ * of the strongest edges in geneNetwork, which must have one.
+ **********************************************************************/
+size_t strongestEdge(graph<geneData, u8> *geneNetwork);
+
+
+/*******************************************************************//**
+ *  Fill order with every edge of geneNetwork, which must have no weak
+ * vertexes left.
+ **********************************************************************/
+void linkOrderOpen(struct linkOrder &order,
+                                      graph<geneData, u8> *geneNetwork);
+
+
+/*******************************************************************//**
+ *  True if entry of order.strongest no longer describes an edge.
+ **********************************************************************/
+inline bool staleEntry(struct linkOrder &order,
+                                        const pair<u8, size_t> &entry);
+
+
+/*******************************************************************//**
+ *  The edge strongestEdge() would pick, found through order.  The graph
+ * must have an edge.
  **********************************************************************/
-bool markConnectedVertexSingle(cu8 edgeWeight,
-                  vertex<geneData, u8> *toMark, cu8 high, cu8 med,
-                                            queue<geneData> &toProcess);
+edge<geneData, u8>* nextSeed(struct linkOrder &order);
 
 
 /*******************************************************************//**
- *  Mark vertex as reached as appropriate and return true if edge can be
- * safely removed.  Requires two stronger connection to be considered
- * reached.
+ *  Remove toRemove from order's graph, noting the edge moved into its
+ * place and the vertexes it leaves weaker.
+ **********************************************************************/
+void orderedRemoveEdge(struct linkOrder &order,
+                                          edge<geneData, u8> *toRemove);
+
+
+/*******************************************************************//**
+ *  Remove toRemove from order's graph, last edge first as
+ * graph::removeVertex() does, noting the vertex moved into its place.
+ **********************************************************************/
+void orderedRemoveVertex(struct linkOrder &order,
+                                        vertex<geneData, u8> *toRemove);
+
+
+/*******************************************************************//**
+ *  Grow a cluster from initialEdge with the triple-link heuristic,
+ * removing each vertex it takes and each edge it uses up through
+ * geneNetwork, a directView or a speculativeView.
  *
- * @param[in] edgeWeight The weight of the edge connecting the outgoing
- *                       vertex.
- * @param[in,out] toMark The outgoing vertex to mark.
- * @param[in] high High value edge weight cutoff.
- * @param[in] med medium value edge weight cutoff.
- * @param[out] toProcess Processing queue should toMark becomes well
- *                       connected.
+ * @param[in,out] geneNetwork View of the graph to grow through.
+ * @param[in] initialEdge Seed edge.
+ * @param[in] threeSigma High connection value for edges.
+ * @param[in] twoSigma Medium connection value for edges.
+ * @param[out] toReturn Name indexes of the cluster's members are added.
  **********************************************************************/
-bool markConnectedVertexDouble(cu8 edgeWeight,
-                  vertex<geneData, u8> *toMark, cu8 high, cu8 med,
-                                            queue<geneData> &toProcess);
+template <typename V> void expandSeed(V &geneNetwork,
+                  edge<geneData, u8> *initialEdge, cu8 threeSigma,
+                                cu8 twoSigma, vector<size_t> &toReturn);
 
 
 /*******************************************************************//**
- *  Mark vertex as reached as appropriate and return true if edge can be
- * safely removed.  Requires all three connections to be considered
- * reached.
+ *  Mark a vertex as reached over an edge of edgeWeight, and return
+ * true if the edge can be safely removed.  The vertex is reached once
+ * it has every mark in linked, and its name index is then queued.
  *
  * @param[in] edgeWeight The weight of the edge connecting the outgoing
  *                       vertex.
- * @param[in,out] toMark The outgoing vertex to mark.
+ * @param[in,out] toMark Marks of the outgoing vertex.
+ * @param[in] nameIndex Name index of the outgoing vertex.
+ * @param[in] linked SINGLE_LINKED, DOUBLE_LINKED or TRIPLE_LINKED.
  * @param[in] high High value edge weight cutoff.
  * @param[in] med medium value edge weight cutoff.
  * @param[out] toProcess Processing queue should toMark becomes well
  *                       connected.
  **********************************************************************/
-bool markConnectedVertexTriple(cu8 edgeWeight,
-                  vertex<geneData, u8> *toMark, cu8 high, cu8 med,
-                                            queue<geneData> &toProcess);
+bool markConnectedVertex(cu8 edgeWeight, u8 &toMark, csize_t nameIndex,
+        cu8 linked, cu8 high, cu8 med, vector<size_t> &toProcess);
 
 
 /*******************************************************************//**
  *  Appropriately mark all vertexes connected to markFrom, and add ones
  * who are well connected to the current process queue.  Also remove
- * traversed edges on markFrom, as they are only needed once.  Has a
- * requirement of 1 edge of maximum strength for inclusion into the
- * current cluster.
+ * traversed edges on markFrom, as they are only needed once.  linked
+ * is the requirement for inclusion into the current cluster: 1 edge of
+ * maximum strength, the top 2 strong edges, or all 3.
  *
  * @param[in,out] markFrom Vertex to mark all connecting vertexes from.
+ * @param[in] linked SINGLE_LINKED, DOUBLE_LINKED or TRIPLE_LINKED.
  * @param[in] high High value edge weight cutoff.
  * @param[in] med Medium value edge weight cutoff.
- * @param[in,out] geneNetwork Network of connected genes which markFrom
- *                            needs to operate through and be
- *                            subsequently removed.
+ * @param[in,out] geneNetwork View of the network of connected genes
+ *                            which markFrom needs to operate through
+ *                            and be subsequently removed.
  * @param[in,out] toProcess Record of vertexes which need to be
  *                          processed in this iteration of triple-link.
  **********************************************************************/
-void markConnectedVertexesSingle(vertex<geneData, u8> *markFrom,
-              cu8 high, cu8 med, graph<geneData, u8> *geneNetwork,
-                                          queue<geneData> &toProcessTo);
+template <typename V> void markConnectedVertexes(
+        vertex<geneData, u8> *markFrom, cu8 linked, cu8 high, cu8 med,
+                            V &geneNetwork, vector<size_t> &toProcess);
 
 
 /*******************************************************************//**
- *  Appropriately mark all vertexes connected to markFrom, and add ones
- * who are well connected to the current process queue.  Also remove
- * traversed edges on markFrom, as they are only needed once.  Has a
- * requirement of top 2 strong edges for inclusion into the current 
- * cluster.
+ *  Allocate marks for name indexes below size, all clear.
  *
- * @param[in,out] markFrom Vertex to mark all connecting vertexes from.
- * @param[in] high High value edge weight cutoff.
- * @param[in] med Medium value edge weight cutoff.
- * @param[in,out] geneNetwork Network of connected genes which markFrom
- *                            needs to operate through and be
- *                            subsequently removed.
- * @param[in,out] toProcess Record of vertexes which need to be
- *                          processed in this iteration of triple-link.
+ * @return false if they could not be allocated.
  **********************************************************************/
-void markConnectedVertexesDouble(vertex<geneData, u8> *markFrom,
-              cu8 high, cu8 med, graph<geneData, u8> *geneNetwork,
-                                          queue<geneData> &toProcessTo);
+bool linkStateOpen(struct linkState &state, csize_t size);
 
 
 /*******************************************************************//**
- *  Appropriately mark all vertexes connected to markFrom, and add ones
- * who are well connected to the current process queue.  Also remove
- * traversed edges on markFrom, as they are only needed once.  Has a
- * requirement of all 3 edges for inclusion into the current cluster.
- *
- * @param[in,out] markFrom Vertex to mark all connecting vertexes from.
- * @param[in] high High value edge weight cutoff.
- * @param[in] med Medium value edge weight cutoff.
- * @param[in,out] geneNetwork Network of connected genes which markFrom
- *                            needs to operate through and be
- *                            subsequently removed.
- * @param[in,out] toProcess Record of vertexes which need to be
- *                          processed in this iteration of triple-link.
+ *  Free the marks of state.
  **********************************************************************/
-void markConnectedVertexesTriple(vertex<geneData, u8> *markFrom,
-              cu8 high, cu8 med, graph<geneData, u8> *geneNetwork,
-                                          queue<geneData> &toProcessTo);
+void linkStateClose(struct linkState &state);
 
 
 /*******************************************************************//**
- *  Reset connection markers on verticex.
- *
- * @param[out] toReset Remove connection marks from passed vertex.
+ *  Marks of the vertex with name index index, clearing them first if
+ * they were set before the last linkStateReset().
  **********************************************************************/
-inline void untouchVertex(vertex<geneData, u8> *toReset);
+inline u8& linkStateMarks(struct linkState &state, csize_t index);
+
+
+/*******************************************************************//**
+ *  Clear every mark by starting a new epoch.
+ **********************************************************************/
+inline void linkStateReset(struct linkState &state);
+
+
+/*******************************************************************//**
+ *  True if target can no longer be included in any future cluster:
+ * it needs an edge of at least high and another of at least med.
+ **********************************************************************/
+bool weakVertex(const vertex<geneData, u8> *target, cu8 high, cu8 med);
 
 
 /*******************************************************************//**
@@ -184,75 +356,133 @@ inline void untouchVertex(vertex<geneData, u8> *toReset);
 void removeWeakVerticies(graph<geneData, u8> *geneNetwork, cu8 high,
                                                               cu8 med);
 
-////////////////////////////////////////////////////////////////////////
-//FUNCTION DEFINITIONS//////////////////////////////////////////////////
-////////////////////////////////////////////////////////////////////////
 
-bool markConnectedVertexSingle(cu8 edgeWeight,
-                  vertex<geneData, u8> *toMark, cu8 high, cu8 med,
-                                            queue<geneData> &toProcess){
-  geneData *value = &toMark->value;
+/*******************************************************************//**
+ *  removeWeakVerticies() on order's graph, removing the same vertexes
+ * in the same order, but only looking at those in order.dirty.
+ *
+ * @param[in,out] order Order of the graph to prune.
+ * @param[in] high High value edge weight cutoff.
+ * @param[in] med medium value edge weight cutoff.
+ * @param[out] changed If not NULL, each vertex removed and each of its
+ *                     neighbours is added.
+ **********************************************************************/
+void removeWeakVerticies(struct linkOrder &order, cu8 high, cu8 med,
+                  unordered_set<vertex<geneData, u8>*> *changed = NULL);
 
-  if(value->threeSigmaLink)
-    return true;
 
-  if(!value->threeSigmaLink && edgeWeight >= high){
-                                        value->threeSigmaLink = true; }
-  else if(!value->twoSigmaLink && edgeWeight >= med){
-                                        value->twoSigmaLink   = true; }
-  else if(!value->oneSigmaLink){
-                                        value->oneSigmaLink   = true; }
+/*******************************************************************//**
+ *  Add toRemove and each vertex it shares an edge with to changed.
+ **********************************************************************/
+void noteRemoval(vertex<geneData, u8> *toRemove,
+                          unordered_set<vertex<geneData, u8>*> &changed);
 
-  if(value->threeSigmaLink){
-    toProcess.push(toMark->value.nameIndex);
-    return true;
-  }else{
-    return false;
-  }
-}
+
+/*******************************************************************//**
+ *  clusterSink adding each cluster to the clusterList in clusters.
+ **********************************************************************/
+void appendCluster(const size_t *members, size_t numMembers,
+                                                        void *clusters);
 
 
-bool markConnectedVertexDouble(cu8 edgeWeight,
-                  vertex<geneData, u8> *toMark, cu8 high, cu8 med,
-                                            queue<geneData> &toProcess){
-  geneData *value = &toMark->value;
+/*******************************************************************//**
+ *  Root of x's set in a lock free union-find forest, halving the path
+ * on the way.
+ **********************************************************************/
+size_t findRoot(atomic<size_t> *parents, size_t x);
 
-  if(value->threeSigmaLink & value->twoSigmaLink)
-    return true;
 
-  if(!value->threeSigmaLink && edgeWeight >= high){
-                                        value->threeSigmaLink = true; }
-  else if(!value->twoSigmaLink && edgeWeight >= med){
-                                        value->twoSigmaLink   = true; }
-  else if(!value->oneSigmaLink){
-                                        value->oneSigmaLink   = true; }
+/*******************************************************************//**
+ *  Join the sets of a and b.  The larger root always points to the
+ * smaller, so every set's root ends up being its lowest member.
+ **********************************************************************/
+void uniteSets(atomic<size_t> *parents, size_t a, size_t b);
 
-  if(value->threeSigmaLink & value->twoSigmaLink){
-    toProcess.push(toMark->value.nameIndex);
-    return true;
-  }else{
-    return false;
-  }
-}
+
+/*******************************************************************//**
+ *  Join the sets of the two vertexes of each of a slice of the edges.
+ **********************************************************************/
+void *unionFindHelper(void *arg);
 
 
-bool markConnectedVertexTriple(cu8 edgeWeight,
-                  vertex<geneData, u8> *toMark, cu8 high, cu8 med,
-                                            queue<geneData> &toProcess){
-  geneData *value = &toMark->value;
+/*******************************************************************//**
+ *  Find the connected components of geneNetwork in parallel.
+ * Components are numbered in order of their first vertex.
+ *
+ * @param[in] geneNetwork Graph to split.
+ * @param[out] componentOfVertex Component of each vertex, by index.
+ *
+ * @return Number of components.
+ **********************************************************************/
+size_t labelComponents(graph<geneData, u8> *geneNetwork,
+                                            size_t *componentOfVertex);
 
-  if(value->threeSigmaLink & value->twoSigmaLink & value->oneSigmaLink)
+
+/*******************************************************************//**
+ *  Pick up to maxSeeds edges to expand at once: the edge triple-link
+ * would take next, then the strongest of the rest which share no
+ * vertex with any edge already picked, and unless componentOf is NULL,
+ * no component either.
+ *
+ * @param[in,out] order Order of the graph to pick from.
+ * @param[in] componentOf Component of each vertex, by name index, or
+ *                        NULL to allow several seeds in one.
+ * @param[out] seeds Seeds picked, in the order they would be taken.
+ * @param[in] maxSeeds Most seeds to pick.
+ *
+ * @return Number of seeds picked; at least one if there are edges.
+ **********************************************************************/
+size_t chooseSeeds(struct linkOrder &order, const size_t *componentOf,
+                          edge<geneData, u8> **seeds, csize_t maxSeeds);
+
+
+/*******************************************************************//**
+ *  Expand each seed a thread takes into its own speculativeView.
+ **********************************************************************/
+void *speculateHelper(void *arg);
+
+
+/*******************************************************************//**
+ *  Run triple-link to completion on order's graph, expanding several
+ * seeds at a time on every thread and keeping each expansion only if a
+ * single thread would have made the same one.  Seed i is kept if seeds
+ * 0 to i - 1 were, it is still the edge triple-link would take next,
+ * and nothing its expansion looked at has been changed since; its
+ * logged changes are then replayed on the graph and its cluster handed
+ * to sink.  Output is identical to decomposing the graph one seed at a
+ * time.
+ *
+ * @param[in,out] order Order of the graph to decompose.
+ * @param[in] settings Run configuration holding the link thresholds.
+ * @param[in] numLabels One more than the largest name index.
+ * @param[in] componentOf As for chooseSeeds().
+ * @param[in] maxSeeds Most seeds to expand at once.
+ * @param[in] sink Called with each cluster, in the order found.
+ * @param[in] context Passed to sink.
+ **********************************************************************/
+void linkSpeculatively(struct linkOrder &order,
+        const struct config &settings, csize_t numLabels,
+        const size_t *componentOf, csize_t maxSeeds, clusterSink sink,
+                                                          void *context);
+
+////////////////////////////////////////////////////////////////////////
+//FUNCTION DEFINITIONS//////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////
+
+bool markConnectedVertex(cu8 edgeWeight, u8 &toMark, csize_t nameIndex,
+        cu8 linked, cu8 high, cu8 med, vector<size_t> &toProcess){
+  if(linked == (toMark & linked))
     return true;
 
-  if(!value->threeSigmaLink && edgeWeight >= high){
-                                        value->threeSigmaLink = true; }
-  else if(!value->twoSigmaLink && edgeWeight >= med){
-                                        value->twoSigmaLink   = true; }
-  else if(!value->oneSigmaLink){
-                                        value->oneSigmaLink   = true; }
+  if(!(toMark & THREE_SIGMA_LINK) && edgeWeight >= high)
+    toMark |= THREE_SIGMA_LINK;
+  else if(!(toMark & TWO_SIGMA_LINK) && edgeWeight >= med)
+    toMark |= TWO_SIGMA_LINK;
+  else
+    toMark |= ONE_SIGMA_LINK;
 
-  if(value->threeSigmaLink & value->twoSigmaLink & value->oneSigmaLink){
-    toProcess.push(toMark->value.nameIndex);
+  if(linked == (toMark & linked)){
+    toProcess.push_back(nameIndex);
     return true;
   }else{
     return false;
@@ -260,51 +490,82 @@ bool markConnectedVertexTriple(cu8 edgeWeight,
 }
 
 
-//TODO merge these so that they take a function pointer --> collapse
-//into a single function.
-void markConnectedVertexesSingle(vertex<geneData, u8> *markFrom,
-              cu8 high, cu8 med, graph<geneData, u8> *geneNetwork,
-                                          queue<geneData> &toProcessTo){
-  for(size_t i = 0; i < markFrom->getNumEdges(); i++)
-    if(markConnectedVertexSingle(markFrom->getEdges()[i]->weight,
-            markFrom->getEdges()[i]->other(markFrom), high, med,
-                                                          toProcessTo)){
-      geneNetwork->removeEdge(markFrom->getEdges()[i]);
+template <typename V> void markConnectedVertexes(
+        vertex<geneData, u8> *markFrom, cu8 linked, cu8 high, cu8 med,
+                            V &geneNetwork, vector<size_t> &toProcess){
+  for(size_t i = 0; i < geneNetwork.numEdges(markFrom); i++){
+    edge<geneData, u8> *target = geneNetwork.edgeAt(markFrom, i);
+    vertex<geneData, u8> *other = target->other(markFrom);
+    if(markConnectedVertex(target->weight, geneNetwork.marks(other),
+              other->value.nameIndex, linked, high, med, toProcess)){
+      geneNetwork.removeEdge(target);
       i = 0;
     }
+  }
 }
 
 
-void markConnectedVertexesDouble(vertex<geneData, u8> *markFrom,
-              cu8 high, cu8 med, graph<geneData, u8> *geneNetwork,
-                                          queue<geneData> &toProcessTo){
-  for(size_t i = 0; i < markFrom->getNumEdges(); i++)
-    if(markConnectedVertexDouble(markFrom->getEdges()[i]->weight,
-            markFrom->getEdges()[i]->other(markFrom), high, med,
-                                                          toProcessTo)){
-      geneNetwork->removeEdge(markFrom->getEdges()[i]);
-      i = 0;
-    }
+bool linkStateOpen(struct linkState &state, csize_t size){
+  state.marks = (u8*) calloc(size + 1, sizeof(*state.marks));
+  state.stamps = (u32*) calloc(size + 1, sizeof(*state.stamps));
+  state.epoch = 0;
+  state.size = size;
+  if(NULL == state.marks || NULL == state.stamps){
+    linkStateClose(state);
+    return false;
+  }
+  allocationRecord(ALLOC_GRAPH, (size + 1) * (sizeof(*state.marks)
+                                                + sizeof(*state.stamps)));
+
+  return true;
 }
 
 
-void markConnectedVertexesTriple(vertex<geneData, u8> *markFrom,
-              cu8 high, cu8 med, graph<geneData, u8> *geneNetwork,
-                                          queue<geneData> &toProcessTo){
-  for(size_t i = 0; i < markFrom->getNumEdges(); i++)
-    if(markConnectedVertexTriple(markFrom->getEdges()[i]->weight,
-            markFrom->getEdges()[i]->other(markFrom), high, med,
-                                                          toProcessTo)){
-      geneNetwork->removeEdge(markFrom->getEdges()[i]);
-      i = 0;
-    }
+void linkStateClose(struct linkState &state){
+  if(NULL != state.marks && NULL != state.stamps)
+    allocationRelease(ALLOC_GRAPH, (state.size + 1) *
+                        (sizeof(*state.marks) + sizeof(*state.stamps)));
+  free(state.marks);
+  free(state.stamps);
+  state.marks = NULL;
+  state.stamps = NULL;
 }
 
 
-inline void untouchVertex(vertex<geneData, u8> *toReset){
-  toReset->value.threeSigmaLink = false;
-  toReset->value.twoSigmaLink = false;
-  toReset->value.oneSigmaLink = false;
+inline u8& linkStateMarks(struct linkState &state, csize_t index){
+  if(state.epoch != state.stamps[index]){
+    state.stamps[index] = state.epoch;
+    state.marks[index] = 0;
+  }
+
+  return state.marks[index];
+}
+
+
+inline void linkStateReset(struct linkState &state){
+  //Once every 2^32 clusters the stamps have to really be cleared
+  if(0 == ++state.epoch){
+    memset(state.marks, 0, (state.size + 1) * sizeof(*state.marks));
+    memset(state.stamps, 0, (state.size + 1) * sizeof(*state.stamps));
+  }
+}
+
+
+bool weakVertex(const vertex<geneData, u8> *target, cu8 high, cu8 med){
+  if(2 > target->getNumEdges())
+    return true;
+
+  bool highFound, medFound;
+  highFound = medFound = false;
+  for(size_t j = 0; j < target->getNumEdges()
+                                    && (!highFound || !medFound); j++){
+    if(target->getEdges()[j]->weight >= high && !highFound)
+      highFound = true;
+    else if(target->getEdges()[j]->weight >= med)
+      medFound = true;
+  }
+
+  return !highFound || !medFound;
 }
 
 
@@ -319,122 +580,629 @@ void removeWeakVerticies(graph<geneData, u8> *geneNetwork, cu8 high,
     for(size_t i = 0; i < geneNetwork->getNumVertexes(); i++){
       const vertex<geneData, u8> *target =
                                           geneNetwork->getVertexes()[i];
-      if(2 > target->getNumEdges()){
+      if(weakVertex(target, high, med)){
         geneNetwork->removeVertex(target);
         disconnectedVerticiesFound = true;
-        continue;
       }
+    }
+  }while(disconnectedVerticiesFound);
+}
 
-      bool highFound, medFound;
-      highFound = medFound = false;
-      for(size_t j = 0; j < target->getNumEdges()
-                                    && (!highFound || !medFound); j++){
-        if(target->getEdges()[j]->weight >= high && !highFound)
-          highFound = true;
-        else if(target->getEdges()[j]->weight >= med)
-          medFound = true;
-      }
-      if(!highFound || !medFound){
-        geneNetwork->removeVertex(target);
+
+void removeWeakVerticies(struct linkOrder &order, cu8 high, cu8 med,
+                      unordered_set<vertex<geneData, u8>*> *changed){
+  graph<geneData, u8> *geneNetwork = order.geneNetwork;
+  bool disconnectedVerticiesFound;
+
+  //The passes of the whole graph version, skipping every vertex which
+  //is not dirty, as it has lost no edge since it was last kept.  A
+  //vertex moved into a removed one's place is passed over until the
+  //next pass, as it would be there.
+  do{
+    disconnectedVerticiesFound = false;
+    for(auto next = order.dirty.begin(); order.dirty.end() != next;){
+      csize_t i = *next;
+      vertex<geneData, u8> *target = geneNetwork->getVertexes()[i];
+
+      order.dirty.erase(next);
+      if(weakVertex(target, high, med)){
+        if(NULL != changed) noteRemoval(target, *changed);
+        orderedRemoveVertex(order, target);
         disconnectedVerticiesFound = true;
       }
+      next = order.dirty.upper_bound(i);
     }
   }while(disconnectedVerticiesFound);
 }
 
 
-queue<size_t> tripleLinkIteration(graph<geneData, u8> *geneNetwork,
-                                        cu8 threeSigma, cu8 twoSigma){
-  queue<size_t> toReturn;
-  edge<geneData, u8> *initialEdge;
-  vertex<geneData, u8> *firstVertex, *secondVertex;
-  vertex<geneData, u8> *connectedVertex;
-  queue<geneData> toProcessPrimer, toProcessMain;
-  size_t targetEdgeIndex = 0;
-
-  double maxFoundValue = geneNetwork->getEdges()[0]->weight;
+size_t strongestEdge(graph<geneData, u8> *geneNetwork){
+  size_t tr = 0;
+  u8 maxFoundValue = geneNetwork->getEdges()[0]->weight;
 
-  //Find strongest edge, use this to grow the tree
   for(size_t i = 1; i < geneNetwork->getNumEdges(); i++){
     u8 weight = geneNetwork->getEdges()[i]->weight;
     if(weight >= maxFoundValue){
       maxFoundValue = weight;
-      targetEdgeIndex = i;
+      tr = i;
     }
   }
 
-  //Reset all verticies to untouched
-  for(size_t i = 0; i < geneNetwork->getNumVertexes(); i++)
-    untouchVertex(geneNetwork->getVertexes()[i]);
+  return tr;
+}
+
+
+void linkOrderOpen(struct linkOrder &order,
+                                    graph<geneData, u8> *geneNetwork){
+  vector<pair<u8, size_t> > entries(geneNetwork->getNumEdges());
+
+  for(size_t i = 0; i < geneNetwork->getNumEdges(); i++)
+    entries[i] = pair<u8, size_t>(geneNetwork->getEdges()[i]->weight, i);
+
+  order.geneNetwork = geneNetwork;
+  order.strongest = priority_queue<pair<u8, size_t> >(
+                  std::less<pair<u8, size_t> >(), std::move(entries));
+  order.dirty.clear();
+}
+
+
+inline bool staleEntry(struct linkOrder &order,
+                                        const pair<u8, size_t> &entry){
+  return entry.second >= order.geneNetwork->getNumEdges()
+      || entry.first != order.geneNetwork->getEdges()[entry.second]->weight;
+}
+
+
+edge<geneData, u8>* nextSeed(struct linkOrder &order){
+  while(staleEntry(order, order.strongest.top()))
+    order.strongest.pop();
+
+  return order.geneNetwork->getEdges()[order.strongest.top().second];
+}
+
+
+void orderedRemoveEdge(struct linkOrder &order,
+                                        edge<geneData, u8> *toRemove){
+  graph<geneData, u8> *geneNetwork = order.geneNetwork;
+  csize_t edgeIndex = toRemove->edgeID;
+
+  order.dirty.insert(toRemove->left->vertexIndex);
+  order.dirty.insert(toRemove->right->vertexIndex);
+  geneNetwork->removeEdge(toRemove);
+
+  //The last edge now sits where toRemove was; its old entry goes stale
+  if(edgeIndex < geneNetwork->getNumEdges())
+    order.strongest.push(pair<u8, size_t>(
+                geneNetwork->getEdges()[edgeIndex]->weight, edgeIndex));
+}
+
+
+void orderedRemoveVertex(struct linkOrder &order,
+                                      vertex<geneData, u8> *toRemove){
+  graph<geneData, u8> *geneNetwork = order.geneNetwork;
+  csize_t nodeIndex = toRemove->vertexIndex;
+  csize_t lastIndex = geneNetwork->getNumVertexes() - 1;
+
+  while(toRemove->getNumEdges())
+    orderedRemoveEdge(order,
+                      toRemove->getEdges()[toRemove->getNumEdges() - 1]);
+
+  //The last vertex now sits where toRemove was, still dirty if it was
+  order.dirty.erase(nodeIndex);
+  bool lastDirty = order.dirty.erase(lastIndex);
+  geneNetwork->removeVertex(toRemove);
+  if(lastDirty) order.dirty.insert(nodeIndex);
+}
+
+
+template <typename V> void expandSeed(V &geneNetwork,
+                  edge<geneData, u8> *initialEdge, cu8 threeSigma,
+                                cu8 twoSigma, vector<size_t> &toReturn){
+  vertex<geneData, u8> *firstVertex, *secondVertex;
+  vertex<geneData, u8> *connectedVertex;
+  vector<size_t> &toProcessPrimer = geneNetwork.state->toProcessPrimer;
+  vector<size_t> &toProcessMain = geneNetwork.state->toProcessMain;
+
+  toProcessPrimer.clear();
+  toProcessMain.clear();
 
   //Add the highest weighted edge's verticies to processing queue
-  initialEdge = geneNetwork->getEdges()[targetEdgeIndex];
   firstVertex = initialEdge->left;
   secondVertex = initialEdge->right;
-  geneNetwork->removeEdge(initialEdge);
+  geneNetwork.removeEdge(initialEdge);
 
 
   //Primer connections (single link phase) for triple link
-  markConnectedVertexesSingle(firstVertex, threeSigma, twoSigma,
+  markConnectedVertexes(firstVertex, SINGLE_LINKED, threeSigma, twoSigma,
                                           geneNetwork, toProcessPrimer);
-  toReturn.push(firstVertex->value.nameIndex);
-  geneNetwork->removeVertex(firstVertex);
+  toReturn.push_back(firstVertex->value.nameIndex);
+  geneNetwork.removeVertex(firstVertex);
 
-  markConnectedVertexesSingle(secondVertex, threeSigma, twoSigma,
-                                          geneNetwork, toProcessPrimer);
-  toReturn.push(secondVertex->value.nameIndex);
-  geneNetwork->removeVertex(secondVertex);
+  markConnectedVertexes(secondVertex, SINGLE_LINKED, threeSigma,
+                                twoSigma, geneNetwork, toProcessPrimer);
+  toReturn.push_back(secondVertex->value.nameIndex);
+  geneNetwork.removeVertex(secondVertex);
   
   //Double Link phase
   
-  while(!toProcessPrimer.empty()){
-    connectedVertex = geneNetwork->getVertexForValue(
-                                              toProcessPrimer.front());
-    toProcessPrimer.pop();
-    
+  for(size_t next = 0; next < toProcessPrimer.size(); next++){
+    connectedVertex = geneNetwork.find(toProcessPrimer[next]);
+
     if(NULL == connectedVertex) continue;
     
-    toReturn.push(connectedVertex->value.nameIndex);
-    markConnectedVertexesDouble(connectedVertex, threeSigma, twoSigma, 
-                                            geneNetwork, toProcessMain);
-    geneNetwork->removeVertex(connectedVertex);
+    toReturn.push_back(connectedVertex->value.nameIndex);
+    markConnectedVertexes(connectedVertex, DOUBLE_LINKED, threeSigma,
+                                  twoSigma, geneNetwork, toProcessMain);
+    geneNetwork.removeVertex(connectedVertex);
   }
 
-  //Main triple link phase tree expantion loop
-  while(!toProcessMain.empty()){
-    connectedVertex = geneNetwork->getVertexForValue(
-                                                toProcessMain.front());
-    toProcessMain.pop();
-    
+  //Main triple link phase tree expantion loop; the queue grows as it
+  //is walked
+  for(size_t next = 0; next < toProcessMain.size(); next++){
+    connectedVertex = geneNetwork.find(toProcessMain[next]);
+
     if(NULL == connectedVertex) continue;
 
-    toReturn.push(connectedVertex->value.nameIndex);
-    markConnectedVertexesTriple(connectedVertex, threeSigma, twoSigma,
-                                            geneNetwork, toProcessMain);
-    geneNetwork->removeVertex(connectedVertex);
+    toReturn.push_back(connectedVertex->value.nameIndex);
+    markConnectedVertexes(connectedVertex, TRIPLE_LINKED, threeSigma,
+                                  twoSigma, geneNetwork, toProcessMain);
+    geneNetwork.removeVertex(connectedVertex);
   }
+}
 
-  return toReturn;
+
+void tripleLinkIteration(graph<geneData, u8> *geneNetwork,
+          struct linkState &state, struct linkOrder *order,
+          cu8 threeSigma, cu8 twoSigma, struct clusterList &clusters){
+  TRACE_SCOPE("tripleLinkIteration");
+  struct directView view = {geneNetwork, &state, order};
+  edge<geneData, u8> *initialEdge;
+
+  //Find strongest edge, use this to grow the tree
+  if(NULL != order)
+    initialEdge = nextSeed(*order);
+  else
+    initialEdge = geneNetwork->getEdges()[strongestEdge(geneNetwork)];
+
+  //Reset all verticies to untouched
+  linkStateReset(state);
+
+  expandSeed(view, initialEdge, threeSigma, twoSigma, clusters.members);
+  clusters.endCluster();
 }
 
 
-queue< queue<size_t> > tripleLink(graph<geneData, u8> *geneNetwork,
-                                        const struct config &settings){
-  queue< queue<size_t> > toReturn;
+void directView::removeEdge(edge<geneData, u8> *toRemove){
+  if(NULL != order) orderedRemoveEdge(*order, toRemove);
+  else geneNetwork->removeEdge(toRemove);
+}
+
+
+void directView::removeVertex(vertex<geneData, u8> *toRemove){
+  if(NULL != order) orderedRemoveVertex(*order, toRemove);
+  else geneNetwork->removeVertex(toRemove);
+}
+
+
+size_t speculativeView::numEdges(vertex<geneData, u8> *target){
+  auto copied = edges.find(target);
+
+  read.insert(target);
+  if(edges.end() == copied) return target->getNumEdges();
+  return copied->second.size();
+}
+
+
+edge<geneData, u8>* speculativeView::edgeAt(
+                              vertex<geneData, u8> *target, size_t i){
+  auto copied = edges.find(target);
+
+  if(edges.end() == copied) return target->getEdges()[i];
+  return copied->second[i];
+}
+
+
+u8& directView::marks(vertex<geneData, u8> *target){
+  return linkStateMarks(*state, target->value.nameIndex);
+}
+
+
+u8& speculativeView::marks(vertex<geneData, u8> *target){
+  return linkStateMarks(*state, target->value.nameIndex);
+}
+
+
+vector<edge<geneData, u8>*>& speculativeView::ownEdges(
+                                          vertex<geneData, u8> *target){
+  auto copied = edges.find(target);
+
+  if(edges.end() == copied){
+    edge<geneData, u8> **original = target->getEdges();
+    read.insert(target);
+    copied = edges.emplace(target, vector<edge<geneData, u8>*>(original,
+                                original + target->getNumEdges())).first;
+  }
+
+  return copied->second;
+}
+
+
+void speculativeView::dropEdge(edge<geneData, u8> *toRemove){
+  vertex<geneData, u8> *sides[2] = {toRemove->left, toRemove->right};
+
+  //The same swap with the last edge vertex::removeEdge() makes
+  for(size_t i = 0; i < 2; i++){
+    vector<edge<geneData, u8>*> &sideEdges = ownEdges(sides[i]);
+    size_t j = 0;
+    while(toRemove != sideEdges[j]) j++;
+    sideEdges[j] = sideEdges.back();
+    sideEdges.pop_back();
+  }
+}
+
+
+void speculativeView::removeEdge(edge<geneData, u8> *toRemove){
+  dropEdge(toRemove);
+  changes.push_back(pair<edge<geneData, u8>*, vertex<geneData, u8>*>(
+                                                        toRemove, NULL));
+}
+
+
+void speculativeView::removeVertex(vertex<geneData, u8> *toRemove){
+  vector<edge<geneData, u8>*> &ownedEdges = ownEdges(toRemove);
+
+  //Last edge first, as graph::removeVertex() does, which replays these
+  while(!ownedEdges.empty())
+    dropEdge(ownedEdges.back());
+  removed.insert(toRemove);
+
+  changes.push_back(pair<edge<geneData, u8>*, vertex<geneData, u8>*>(
+                                                        NULL, toRemove));
+}
+
+
+vertex<geneData, u8>* speculativeView::find(csize_t nameIndex){
+  vertex<geneData, u8> *tr =
+                      geneNetwork->getVertexForValue(geneData(nameIndex));
+
+  if(NULL == tr) return NULL;
+  read.insert(tr);
+
+  return removed.count(tr) ? NULL : tr;
+}
+
+
+void speculativeView::clear(){
+  edges.clear();
+  linkStateReset(*state);
+  removed.clear();
+  read.clear();
+  changes.clear();
+  members.clear();
+}
+
+
+void noteRemoval(vertex<geneData, u8> *toRemove,
+                        unordered_set<vertex<geneData, u8>*> &changed){
+  changed.insert(toRemove);
+  for(size_t i = 0; i < toRemove->getNumEdges(); i++)
+    changed.insert(toRemove->getEdges()[i]->other(toRemove));
+}
+
+
+void appendCluster(const size_t *members, size_t numMembers,
+                                                        void *clusters){
+  struct clusterList *target = (struct clusterList*) clusters;
+
+  target->members.insert(target->members.end(), members,
+                                                  members + numMembers);
+  target->endCluster();
+}
+
+
+size_t findRoot(atomic<size_t> *parents, size_t x){
+  while(true){
+    size_t parent = parents[x].load();
+    if(parent == x) return x;
+
+    csize_t grandparent = parents[parent].load();
+    if(parent != grandparent)
+      parents[x].compare_exchange_weak(parent, grandparent);
+    x = grandparent;
+  }
+}
+
+
+void uniteSets(atomic<size_t> *parents, size_t a, size_t b){
+  while(true){
+    a = findRoot(parents, a);
+    b = findRoot(parents, b);
+    if(a == b) return;
+    if(a < b) std::swap(a, b);
+
+    size_t expected = a;
+    if(parents[a].compare_exchange_strong(expected, b)) return;
+  }
+}
+
+
+void *unionFindHelper(void *arg){
+  TRACE_SCOPE("unionFindHelper");
+  struct multithreadLoad *argPrime = (struct multithreadLoad*) arg;
+  csize_t numerator = argPrime->numerator;
+  csize_t denominator = argPrime->denominator;
+
+  struct unionFindHelperStruct *args =
+                  (struct unionFindHelperStruct*) argPrime->specifics;
+  edge<geneData, u8> **edges = args->geneNetwork->getEdges();
+  csize_t numEdges = args->geneNetwork->getNumEdges();
+
+  for(size_t i = (numerator * numEdges) / denominator;
+                    i < ((numerator + 1) * numEdges) / denominator; i++)
+    uniteSets(args->parents, edges[i]->left->vertexIndex,
+                                          edges[i]->right->vertexIndex);
+
+  return NULL;
+}
+
+
+size_t labelComponents(graph<geneData, u8> *geneNetwork,
+                                            size_t *componentOfVertex){
+  TRACE_SCOPE("labelComponents");
+  csize_t numVertexes = geneNetwork->getNumVertexes();
+  atomic<size_t> *parents = new atomic<size_t>[numVertexes];
+  struct unionFindHelperStruct instructions = {geneNetwork, parents};
+  size_t tr = 0;
+
+  for(size_t i = 0; i < numVertexes; i++)
+    parents[i] = i;
+
+  autoThreadLauncher(unionFindHelper, (void*) &instructions);
+
+  //A root is its set's lowest vertex, so it is labelled before the rest
+  for(size_t i = 0; i < numVertexes; i++){
+    csize_t root = findRoot(parents, i);
+    componentOfVertex[i] = (root == i) ? tr++ : componentOfVertex[root];
+  }
+
+  delete[] parents;
+  return tr;
+}
+
+
+size_t chooseSeeds(struct linkOrder &order, const size_t *componentOf,
+                          edge<geneData, u8> **seeds, csize_t maxSeeds){
+  edge<geneData, u8> **edges = order.geneNetwork->getEdges();
+  unordered_set<vertex<geneData, u8>*> used;
+  unordered_set<size_t> usedComponents;
+  vector<pair<u8, size_t> > looked;
+  size_t tr = 0;
+
+  //Strongest first, and among equals the highest index first, which is
+  //the order nextSeed() would take them in
+  while(!order.strongest.empty() && looked.size() < 4 * maxSeeds
+                                                    && tr < maxSeeds){
+    const pair<u8, size_t> entry = order.strongest.top();
+    order.strongest.pop();
+    if(staleEntry(order, entry)) continue;
+    looked.push_back(entry);
+
+    edge<geneData, u8> *candidate = edges[entry.second];
+    if(used.count(candidate->left) || used.count(candidate->right))
+      continue;
+    if(NULL != componentOf && !usedComponents.insert(
+                componentOf[candidate->left->value.nameIndex]).second)
+      continue;
+    used.insert(candidate->left);
+    used.insert(candidate->right);
+    seeds[tr++] = candidate;
+  }
+
+  for(size_t i = 0; i < looked.size(); i++)
+    order.strongest.push(looked[i]);
+
+  return tr;
+}
+
+
+void *speculateHelper(void *arg){
+  TRACE_SCOPE("speculateHelper");
+  struct multithreadLoad *argPrime = (struct multithreadLoad*) arg;
+  struct speculateHelperStruct *args =
+                  (struct speculateHelperStruct*) argPrime->specifics;
+
+  for(size_t next = args->nextSeed++; next < args->numSeeds;
+                                                next = args->nextSeed++){
+    struct speculativeView &view = args->views[next];
+    view.clear();
+    expandSeed(view, args->seeds[next], args->threeSigma, args->twoSigma,
+                                                            view.members);
+  }
+
+  return NULL;
+}
+
+
+void linkSpeculatively(struct linkOrder &order,
+        const struct config &settings, csize_t numLabels,
+        const size_t *componentOf, csize_t maxSeeds, clusterSink sink,
+                                                          void *context){
+  TRACE_SCOPE("linkSpeculatively");
+  graph<geneData, u8> *geneNetwork = order.geneNetwork;
+  struct speculateHelperStruct instructions;
+  unordered_set<vertex<geneData, u8>*> changed;
+
+  vector<edge<geneData, u8>*> seeds(maxSeeds);
+  struct speculativeView *views = new struct speculativeView[maxSeeds];
+  struct linkState *states = new struct linkState[maxSeeds];
+  for(size_t i = 0; i < maxSeeds; i++){
+    if(!linkStateOpen(states[i], numLabels)){
+      fprintf(stderr, "ERROR: Could not allocate triple-link marks\n");
+      fflush(stderr);
+      raise(SIGABRT);
+    }
+    views[i].geneNetwork = geneNetwork;
+    views[i].state = &states[i];
+  }
+
+  instructions.seeds = seeds.data();
+  instructions.views = views;
+  instructions.threeSigma = settings.threeSigmaAdj;
+  instructions.twoSigma = settings.twoSigmaAdj;
+
+  while(geneNetwork->getNumEdges() > 0){
+    instructions.numSeeds = chooseSeeds(order, componentOf, seeds.data(),
+                                                              maxSeeds);
+    instructions.nextSeed = 0;
+    autoThreadLauncher(speculateHelper, (void*) &instructions);
+
+    changed.clear();
+    for(size_t i = 0; i < instructions.numSeeds; i++){
+      struct speculativeView &view = views[i];
+
+      //Seed 0 is always the one triple-link takes next; any later seed
+      //must still be, and must not have seen anything changed since
+      if(0 < i){
+        if(0 == geneNetwork->getNumEdges()) break;
+        if(seeds[i] != nextSeed(order)) break;
+        bool stale = false;
+        for(auto read = view.read.begin(); read != view.read.end()
+                                                    && !stale; ++read)
+          stale = changed.count(*read);
+        if(stale) break;
+      }
+
+      for(size_t j = 0; j < view.changes.size(); j++){
+        if(NULL != view.changes[j].first){
+          changed.insert(view.changes[j].first->left);
+          changed.insert(view.changes[j].first->right);
+          orderedRemoveEdge(order, view.changes[j].first);
+        }else{
+          noteRemoval(view.changes[j].second, changed);
+          orderedRemoveVertex(order, view.changes[j].second);
+        }
+      }
+      removeWeakVerticies(order, settings.threeSigmaAdj,
+                                        settings.twoSigmaAdj, &changed);
+
+      sink(view.members.data(), view.members.size(), context);
+    }
+  }
+
+  for(size_t i = 0; i < maxSeeds; i++)
+    linkStateClose(states[i]);
+  delete[] states;
+  delete[] views;
+}
+
+
+void tripleLink(graph<geneData, u8> *geneNetwork,
+        const struct config &settings, clusterSink sink, void *context){
+  TRACE_SCOPE("tripleLink");
+  struct clusterList current;
+  struct linkState state;
+  struct linkOrder order;
+  csize_t numCPUs = thread::hardware_concurrency();
+  size_t *componentOfVertex, *componentOf = NULL;
+  void *tmpPtr;
 
   removeWeakVerticies(geneNetwork, settings.threeSigmaAdj, 
                                                   settings.twoSigmaAdj);
 
+  //Marks are held by name index, so must reach the largest left
+  size_t numLabels = 0;
+  for(size_t i = 0; i < geneNetwork->getNumVertexes(); i++)
+    if(geneNetwork->getVertexes()[i]->value.nameIndex >= numLabels)
+      numLabels = geneNetwork->getVertexes()[i]->value.nameIndex + 1;
+
+  //Seeds of different components never meet, so with --speculate 1
+  //each core takes one from a different component, or with more the
+  //number asked for from anywhere.  Otherwise one at a time.
+  size_t maxSeeds = 1;
+  if(1 == settings.speculativeSeeds) maxSeeds = numCPUs;
+  if(1 < settings.speculativeSeeds) maxSeeds = settings.speculativeSeeds;
+  if(settings.serialLink) maxSeeds = 1;
+
+  if(!settings.serialLink) linkOrderOpen(order, geneNetwork);
+
+  if(1 < maxSeeds){
+    if(1 == settings.speculativeSeeds){
+      tmpPtr = malloc(sizeof(*componentOfVertex) *
+                                      (geneNetwork->getNumVertexes() + 1));
+      componentOfVertex = (size_t*) tmpPtr;
+      tmpPtr = malloc(sizeof(*componentOf) * (numLabels + 1));
+      componentOf = (size_t*) tmpPtr;
+      if(NULL == componentOfVertex || NULL == componentOf){
+        fprintf(stderr, "ERROR: Could not allocate component labels\n");
+        fflush(stderr);
+        raise(SIGABRT);
+      }
+
+      //Vertexes move as others are removed, but their names do not
+      labelComponents(geneNetwork, componentOfVertex);
+      for(size_t i = 0; i < geneNetwork->getNumVertexes(); i++)
+        componentOf[geneNetwork->getVertexes()[i]->value.nameIndex] =
+                                                  componentOfVertex[i];
+      free(componentOfVertex);
+    }
+
+    linkSpeculatively(order, settings, numLabels, componentOf, maxSeeds,
+                                                          sink, context);
+    free(componentOf);
+    return;
+  }
+
+  if(!linkStateOpen(state, numLabels)){
+    fprintf(stderr, "ERROR: Could not allocate triple-link marks\n");
+    fflush(stderr);
+    raise(SIGABRT);
+  }
+
   while(geneNetwork->getNumEdges() > 0){
-    toReturn.push(tripleLinkIteration(geneNetwork, 
-                        settings.threeSigmaAdj, settings.twoSigmaAdj));
-    removeWeakVerticies(geneNetwork, settings.threeSigmaAdj, 
+    if(settings.serialLink){
+      tripleLinkIteration(geneNetwork, state, NULL,
+              settings.threeSigmaAdj, settings.twoSigmaAdj, current);
+      removeWeakVerticies(geneNetwork, settings.threeSigmaAdj,
+                                                  settings.twoSigmaAdj);
+    }else{
+      tripleLinkIteration(geneNetwork, state, &order,
+              settings.threeSigmaAdj, settings.twoSigmaAdj, current);
+      removeWeakVerticies(order, settings.threeSigmaAdj,
                                                   settings.twoSigmaAdj);
+    }
+    sink(current.cluster(0), current.clusterSize(0), context);
+    current.clear();
   }
 
+  linkStateClose(state);
+}
+
+
+struct clusterList tripleLink(graph<geneData, u8> *geneNetwork,
+                                        const struct config &settings){
+  struct clusterList toReturn;
+
+  tripleLink(geneNetwork, settings, appendCluster, &toReturn);
+
   return toReturn;
 }
 
+
+void tripleLink(const graph<geneData, u8> *geneNetwork,
+        const struct config &settings, clusterSink sink, void *context){
+  graph<geneData, u8> scratch(*geneNetwork);
+
+  tripleLink(&scratch, settings, sink, context);
+}
+
+
+struct clusterList tripleLink(const graph<geneData, u8> *geneNetwork,
+                                        const struct config &settings){
+  graph<geneData, u8> scratch(*geneNetwork);
+
+  return tripleLink(&scratch, settings);
+}
+
 ////////////////////////////////////////////////////////////////////////
 //END///////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
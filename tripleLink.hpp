@@ -21,6 +21,7 @@
 
 #include <vector>
 
+#include "clusters.hpp"
 #include "geneData.hpp"
 #include "graph.hpp"
 
@@ -32,8 +33,17 @@
  *  Clustering algorithm described in "TF-Cluster: A pipeline for
  * identifying functionally coordinated transcription factors via
  * network decomposition of the shared coexpression connectivity matrix
- * (SCCM)".  Returns a queue of queues, with each subqueue holding label
- * indexes that represent a particular cluster.
+ * (SCCM)".  Returns the clusters found, each holding the label indexes
+ * of its members in the order they were reached.
+ *
+ *  Seeds are expanded one at a time unless settings.speculativeSeeds
+ * is set.  Expansion never crosses between connected components, so
+ * with 1 seeds from different components are expanded on every core at
+ * once, keeping only those a single thread would have grown, in its
+ * order.  Above 1 several seeds may come from one component, which
+ * spreads a graph that is mostly one component over every core too.
+ * Clusters are exactly those of a single thread working through the
+ * whole graph, for any number of threads.
  *
  * @param[in,out] geneNetwork Graph of genes which are parsed with the
  *                            triple-link algorithm.  The graph is
@@ -42,9 +52,42 @@
  *                       triple-link.
  * @param[in] twoSigma Medium value used for edges in triple-link.
  **********************************************************************/
-queue< queue<size_t> > tripleLink(graph<geneData, unsigned char> *geneNetwork,
+struct clusterList tripleLink(graph<geneData, unsigned char> *geneNetwork,
                     const struct config &settings);
 
+
+/*******************************************************************//**
+ *  tripleLink(), handing each cluster to sink as soon as it is
+ * complete rather than returning them all at the end, so that the
+ * strongest clusters, which are found first, can be used while the
+ * rest of the graph is still being decomposed.
+ *
+ * @param[in,out] geneNetwork Graph of genes, which is consumed.
+ * @param[in] settings Run configuration holding the link thresholds.
+ * @param[in] sink Called with each cluster, in the order found.
+ * @param[in] context Passed to sink.
+ **********************************************************************/
+void tripleLink(graph<geneData, unsigned char> *geneNetwork,
+        const struct config &settings, clusterSink sink, void *context);
+
+
+/*******************************************************************//**
+ *  tripleLink() on a copy of geneNetwork, which is left as it was, so
+ * that one graph can be clustered several times, for instance with
+ * different thresholds, without being rebuilt from the SCCM.  Gives
+ * the same clusters tripleLink() would on geneNetwork itself.
+ **********************************************************************/
+struct clusterList tripleLink(
+                      const graph<geneData, unsigned char> *geneNetwork,
+                      const struct config &settings);
+
+
+/*******************************************************************//**
+ *  As above, handing each cluster to sink as it is found.
+ **********************************************************************/
+void tripleLink(const graph<geneData, unsigned char> *geneNetwork,
+        const struct config &settings, clusterSink sink, void *context);
+
 ////////////////////////////////////////////////////////////////////////
 //END///////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////
@@ -8,6 +8,7 @@
 #include <iostream>
 #include <tgmath.h>
 
+#include "allocation.hpp"
 #include "upper-diagonal-square-matrix.hpp"
 
 
@@ -51,6 +52,7 @@ template<typename T> size_t UpperDiagonalSquareMatrix<T>::
 template<typename T> UpperDiagonalSquareMatrix<T>
                       ::UpperDiagonalSquareMatrix(){
   oneDMatrix = NULL;
+  n = 0;
 }
 
 
@@ -65,12 +67,15 @@ template<typename T> UpperDiagonalSquareMatrix<T>
   size_t allocSize = sizeof(T) * numberOfElements();
   tmpPtr = malloc(allocSize);
   oneDMatrix = (T*) tmpPtr;
+  if(NULL != oneDMatrix) allocationRecord(ALLOC_SCCM, allocSize);
   
 }
 
 
 template <typename T> UpperDiagonalSquareMatrix<T>
                                         ::~UpperDiagonalSquareMatrix(){
+  if(NULL != oneDMatrix)
+    allocationRelease(ALLOC_SCCM, sizeof(T) * numberOfElements());
   free(oneDMatrix);
 }
 
@@ -4,7 +4,9 @@
   DESCRIPTION:  Public interface for a somewhats STL quality graph
 
          BUGS:  ---
-        NOTES:  ---
+        NOTES:  neighbours[i] is the vertex at the other end of edges[i],
+                so areConnected() scans a flat array of pointers rather
+                than following every edge.
        AUTHOR:  Josh Marshall <jrmarsha@mtu.edu>
       COMPANY:  Michigan technological University
       VERSION:  See git log
@@ -40,8 +42,8 @@ template <typename T, typename U> class edge;
 template <typename T, typename U> class vertex{
   private:
   edge<T, U> **edges;
+  vertex<T, U> **neighbours;
   size_t numEdges, edgesSize;
-  unordered_map<vertex<T, U>*, edge<T, U>*> connected;
 
   public:
   size_t vertexIndex;
@@ -118,6 +120,18 @@ template <typename T, typename U> class vertex{
   void shrinkToFit();
 
 
+/*******************************************************************//**
+ *  List this vertex's edges in the order other lists its own, where
+ * other is the vertex this one was copied from.
+ *
+ * @param[in] other Vertex with the same number of edges.
+ * @param[in] edgeOfID This vertex's copy of each of other's edges, at
+ *                     the edgeID of the edge copied.
+ **********************************************************************/
+  void copyEdgeOrder(const vertex<T, U> &other,
+                                            edge<T, U> *const *edgeOfID);
+
+
 /*******************************************************************//**
  *  Tell if contents of vertexes are the same, but not nessicarily the
  * same vertex from a single graph.
@@ -126,7 +140,8 @@ template <typename T, typename U> class vertex{
   
   
 /*******************************************************************//**
- * Tell if there is an edge connecting this vertex to another vertex
+ * Tell if there is an edge connecting this vertex to another vertex.
+ * Scans the neighbours of whichever of the two has fewer edges.
  **********************************************************************/
   bool areConnected(vertex<T, U> *other) const;
 
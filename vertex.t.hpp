@@ -22,6 +22,7 @@
 #include <csignal>
 #include <cstring>
 
+#include "allocation.hpp"
 #include "vertex.hpp"
 #include "edge.hpp"
 
@@ -33,6 +34,7 @@ template <typename T, typename U> vertex<T, U>::vertex(size_t index,
                               T data):  vertexIndex(index), value(data){
   numEdges = edgesSize = 0;
   edges = (edge<T, U>**) NULL;
+  neighbours = (vertex<T, U>**) NULL;
 }
 
 
@@ -44,6 +46,10 @@ template <typename T, typename U> inline size_t
 
 template <typename T, typename U> vertex<T, U>::~vertex(){
   if(0 != numEdges) raise(SIGABRT);
+  allocationRelease(ALLOC_GRAPH,
+                    edgesSize * (sizeof(*edges) + sizeof(*neighbours)));
+  free(edges);
+  free(neighbours);
 }
 
 
@@ -51,9 +57,7 @@ template <typename T, typename U> size_t vertex<T, U>::addEdge(
                                                 edge<T, U> *toRegister){
   ensureEdgeCapacity(numEdges+1);
   edges[numEdges] = toRegister;
-  pair<vertex<T, U>*, edge<T, U>* > toInsert;
-  toInsert = pair<vertex<T, U>*, edge<T, U>* >(toRegister->other(this), toRegister);
-  connected.insert(toInsert);
+  neighbours[numEdges] = toRegister->other(this);
   numEdges++;
 
   return numEdges-1;
@@ -64,6 +68,7 @@ template <typename T, typename U> void vertex<T, U>::removeEdge(
                                                   edge<T, U> *toRemove){
   void *memCheck;
   edge<T, U> *tmp;
+  vertex<T, U> *tmpNeighbour;
   size_t targetEdgeIndex = 0;
 
 
@@ -85,6 +90,9 @@ template <typename T, typename U> void vertex<T, U>::removeEdge(
   tmp = edges[numEdges];
   edges[numEdges] = edges[targetEdgeIndex];
   edges[targetEdgeIndex] = tmp;
+  tmpNeighbour = neighbours[numEdges];
+  neighbours[numEdges] = neighbours[targetEdgeIndex];
+  neighbours[targetEdgeIndex] = tmpNeighbour;
 
   //update the swapped edge's location in this structure so it still
   //knows where it is in this vertex/node
@@ -98,13 +106,17 @@ template <typename T, typename U> void vertex<T, U>::removeEdge(
   if(0 < numEdges){
     memCheck = realloc(edges, numEdges * sizeof(*edges));
     edges = (edge<T, U>**) memCheck;
+    memCheck = realloc(neighbours, numEdges * sizeof(*neighbours));
+    neighbours = (vertex<T, U>**) memCheck;
   }else{
     free(edges);
+    free(neighbours);
     edges = NULL;
+    neighbours = NULL;
   }
+  allocationRelease(ALLOC_GRAPH, (sizeof(*edges) + sizeof(*neighbours)) *
+                                                  (edgesSize-numEdges));
   edgesSize = numEdges;
-  
-  connected.erase(toRemove->other(this));
 }
 
 
@@ -134,6 +146,12 @@ template <typename T, typename U> void vertex<T, U>::hintNumEdges(
   tmpPtr = realloc(edges, sizeof(*edges) * suggestSize);
   if(NULL == tmpPtr) raise(SIGABRT);
   edges = (edge<T, U>**) tmpPtr;
+  tmpPtr = realloc(neighbours, sizeof(*neighbours) * suggestSize);
+  if(NULL == tmpPtr) raise(SIGABRT);
+  neighbours = (vertex<T, U>**) tmpPtr;
+  allocationResize(ALLOC_GRAPH,
+                    (sizeof(*edges) + sizeof(*neighbours)) * edgesSize,
+                    (sizeof(*edges) + sizeof(*neighbours)) * suggestSize);
 
   edgesSize = suggestSize;
 }
@@ -144,6 +162,17 @@ template <typename T, typename U> void vertex<T, U>::shrinkToFit(){
 }
 
 
+template <typename T, typename U> void vertex<T, U>::copyEdgeOrder(
+              const vertex<T, U> &other, edge<T, U> *const *edgeOfID){
+  if(other.numEdges != numEdges) raise(SIGABRT);
+
+  for(size_t i = 0; i < numEdges; i++){
+    edges[i] = edgeOfID[other.edges[i]->edgeID];
+    neighbours[i] = edges[i]->other(this);
+  }
+}
+
+
 template <typename T, typename U> void vertex<T, U>::ensureEdgeCapacity(
                                                     const size_t size){
   while(size > edgesSize)
@@ -153,7 +182,20 @@ template <typename T, typename U> void vertex<T, U>::ensureEdgeCapacity(
 
 template <typename T, typename U> bool vertex<T, U>::areConnected(
                                             vertex<T, U> *other) const{
-  return connected.count(other);
+  const vertex<T, U> *const *toScan = neighbours;
+  const vertex<T, U> *toFind = other;
+  size_t numToScan = numEdges;
+
+  if(other->numEdges < numEdges){
+    toScan = other->neighbours;
+    toFind = this;
+    numToScan = other->numEdges;
+  }
+
+  for(size_t i = 0; i < numToScan; i++)
+    if(toFind == toScan[i]) return true;
+
+  return false;
 }
 
 